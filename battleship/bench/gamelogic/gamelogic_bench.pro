@@ -0,0 +1,42 @@
+QT += core network widgets
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# Настройки для временных файлов
+MOC_DIR = build/moc
+OBJECTS_DIR = build/obj
+
+TEMPLATE = app
+
+INCLUDEPATH += ../../server ../../common ../../client
+include(../../common/gamecore.pri)
+
+SOURCES += \
+    main.cpp \
+    ../../server/gameserver.cpp \
+    ../../server/gamejournal.cpp \
+    ../../server/gamereplay.cpp \
+    ../../server/batchedudpio.cpp \
+    ../../server/logger.cpp \
+    ../../server/matchmakinghub.cpp \
+    ../../server/matchmakingqueue.cpp \
+    ../../server/servermetrics.cpp \
+    ../../client/GameBoard.cpp \
+    ../../common/protocol.cpp \
+    ../../common/reliablechannel.cpp
+
+HEADERS += \
+    ../../server/gameserver.h \
+    ../../server/gamejournal.h \
+    ../../server/gamereplay.h \
+    ../../server/batchedudpio.h \
+    ../../server/logger.h \
+    ../../server/matchmakinghub.h \
+    ../../server/matchmakingqueue.h \
+    ../../server/servermetrics.h \
+    ../../client/GameBoard.h \
+    ../../common/protocol.h \
+    ../../common/reliablechannel.h
+
+TARGET = gamelogic_bench
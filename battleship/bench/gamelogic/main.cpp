@@ -0,0 +1,373 @@
+// Игровая логика сервера и клиента на общем наборе досок.
+//
+// Сервер (GameServer):
+//   validateBoard       - проверка расстановки из сообщения board
+//   FleetIndex::build   - индекс кораблей, строится в начале партии
+//   checkShipSunk       - потоплен ли корабль после попадания (по индексу)
+//   checkGameOver       - остались ли непотопленные корабли (по индексу)
+//   processShotResult   - полный разбор выстрела: ход, таймеры, кодирование
+//                         ответов (сокет не открыт, датаграммы не уходят)
+// Клиент (GameBoard):
+//   isValidShipPlacement, placeRandomShips, isShipSunk, findShipCells
+// Ядро на классическом поле (classic10):
+//   randomFleet, isValidFleet, FleetIndex::build
+//
+// Наборы досок строятся детерминированно из фиксированного зерна:
+//   random      - случайные правильные расстановки
+//   adversarial - пустые, сплошные, шахматные, с лишней или недостающей
+//                 палубой, с длинными линиями и диагональными касаниями
+//   midgame     - правильные расстановки после случайного числа выстрелов
+//
+// Вывод - одна строка на замер: сторона, функция, набор, число досок,
+// наносекунды на операцию и контрольная сумма результатов. Сумма зависит
+// только от досок, так что ее изменение после правки означает изменение
+// поведения, а не только скорости.
+// Запуск: gamelogic_bench [число досок], по умолчанию 1000.
+
+#include <QApplication>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+#include "bitboard.h"
+#include "batchedudpio.h"
+#include "gameserver.h"
+#include "GameBoard.h"
+
+namespace {
+
+// Время в наносекундах на операцию, лучшее из REPEATS прогонов
+constexpr int REPEATS = 5;
+constexpr quint32 SEED = 20240501;
+
+using Clock = std::chrono::steady_clock;
+
+struct Corpus {
+    const char *name;
+    std::vector<BitBoard> boards;
+};
+
+void report(const char *side, const char *function, const char *corpus, size_t items,
+            double nsPerOp, long long checksum) {
+    std::printf("%-6s %-20s %-12s %6zu %10.1f ns/op  check %lld\n",
+                side, function, corpus, items, nsPerOp, checksum);
+}
+
+// Прогоняет body над всеми элементами REPEATS раз. body возвращает вклад
+// в контрольную сумму, сумма берется с первого прогона.
+template <typename T>
+void measure(const char *side, const char *function, const char *corpus,
+             const std::vector<T> &items, const std::function<long long(const T &)> &body) {
+    double best = 1e300;
+    long long checksum = 0;
+    for (int r = 0; r < REPEATS; ++r) {
+        long long sum = 0;
+        const auto t0 = Clock::now();
+        for (const T &item : items) sum += body(item);
+        const auto t1 = Clock::now();
+        best = std::min(best, std::chrono::duration<double, std::nano>(t1 - t0).count() / double(items.size()));
+        if (r == 0) checksum = sum;
+    }
+    report(side, function, corpus, items.size(), best, checksum);
+}
+
+Corpus randomCorpus(size_t count) {
+    std::mt19937 rng(SEED);
+    Corpus corpus{"random", {}};
+    for (size_t i = 0; i < count; ++i) corpus.boards.push_back(BitBoard::randomFleet(rng));
+    return corpus;
+}
+
+Corpus adversarialCorpus(size_t count) {
+    std::mt19937 rng(SEED + 1);
+    Corpus corpus{"adversarial", {}};
+    for (size_t i = 0; i < count; ++i) {
+        BitBoard board;
+        switch (i % 8) {
+        case 0:
+            break;
+        case 1:
+            for (int c = 0; c < BitBoard::CELL_COUNT; ++c) board.setShip(c % 10, c / 10);
+            break;
+        case 2:
+            // Шахматка: пятьдесят одиночных палуб, все касаются углами
+            for (int c = 0; c < BitBoard::CELL_COUNT; ++c) {
+                if ((c % 10 + c / 10 + int(i / 8)) % 2 == 0) board.setShip(c % 10, c / 10);
+            }
+            break;
+        case 3: {
+            // Правильный флот и одна лишняя палуба
+            board = BitBoard::randomFleet(rng);
+            const int c = int(rng() % BitBoard::CELL_COUNT);
+            board.setShip(c % 10, c / 10);
+            break;
+        }
+        case 4: {
+            // Правильный флот без одной палубы
+            const BitBoard fleet = BitBoard::randomFleet(rng);
+            int skip = int(rng() % 20);
+            for (int c = 0; c < BitBoard::CELL_COUNT; ++c) {
+                if (fleet.hasShip(c % 10, c / 10) && skip-- != 0) board.setShip(c % 10, c / 10);
+            }
+            break;
+        }
+        case 5:
+            // Двадцать случайных клеток
+            for (int n = 0; n < 20; ++n) {
+                const int c = int(rng() % BitBoard::CELL_COUNT);
+                board.setShip(c % 10, c / 10);
+            }
+            break;
+        case 6:
+            // Корабли длиной во всю строку
+            for (int y = int(i / 8) % 2; y < BitBoard::HEIGHT; y += 2) {
+                for (int x = 0; x < BitBoard::WIDTH; ++x) board.setShip(x, y);
+            }
+            break;
+        case 7: {
+            // Правильный флот, к которому углом приставлена палуба
+            board = BitBoard::randomFleet(rng);
+            for (int attempt = 0; attempt < 100; ++attempt) {
+                const int c = int(rng() % BitBoard::CELL_COUNT);
+                const int x = c % 10 + 1;
+                const int y = c / 10 + 1;
+                if (board.hasShip(c % 10, c / 10) && BitBoard::inBounds(x, y) && !board.hasShip(x, y)) {
+                    board.setShip(x, y);
+                    break;
+                }
+            }
+            break;
+        }
+        }
+        corpus.boards.push_back(board);
+    }
+    return corpus;
+}
+
+Corpus midgameCorpus(size_t count) {
+    std::mt19937 rng(SEED + 2);
+    Corpus corpus{"midgame", {}};
+    for (size_t i = 0; i < count; ++i) {
+        BitBoard board = BitBoard::randomFleet(rng);
+        std::vector<int> cells(BitBoard::CELL_COUNT);
+        for (int c = 0; c < BitBoard::CELL_COUNT; ++c) cells[size_t(c)] = c;
+        std::shuffle(cells.begin(), cells.end(), rng);
+        const int shots = 10 + int(rng() % 81);
+        for (int n = 0; n < shots; ++n) board.shoot(cells[size_t(n)] % 10, cells[size_t(n)] / 10);
+        corpus.boards.push_back(board);
+    }
+    return corpus;
+}
+
+// Клетки с попаданиями: аргументы для checkShipSunk и isShipSunk
+struct HitCell {
+    int board;
+    int x;
+    int y;
+};
+
+std::vector<HitCell> hitCells(const Corpus &corpus) {
+    std::vector<HitCell> cells;
+    for (size_t b = 0; b < corpus.boards.size(); ++b) {
+        for (int c = 0; c < BitBoard::CELL_COUNT; ++c) {
+            if (corpus.boards[b].isHit(c % 10, c / 10)) cells.push_back({int(b), c % 10, c / 10});
+        }
+    }
+    return cells;
+}
+
+QVector<QVector<int>> toGrid(const BitBoard &board) {
+    QVector<QVector<int>> grid(BitBoard::HEIGHT, QVector<int>(BitBoard::WIDTH));
+    for (int y = 0; y < BitBoard::HEIGHT; ++y) {
+        for (int x = 0; x < BitBoard::WIDTH; ++x) grid[y][x] = board.cell(x, y);
+    }
+    return grid;
+}
+
+std::vector<GameBoard *> toWidgets(const Corpus &corpus) {
+    std::vector<GameBoard *> widgets;
+    for (const BitBoard &board : corpus.boards) {
+        GameBoard *widget = new GameBoard(true);
+        widget->setBoard(toGrid(board));
+        widgets.push_back(widget);
+    }
+    return widgets;
+}
+
+// Ядро на поле и флоте варианта Rules: те же шаблоны, что у сервера с
+// классическим полем, так что строки classic10 показывают его скорость
+template <typename Rules>
+void runVariant(const char *name, size_t count) {
+    using Board = BasicBitBoard<Rules>;
+    std::mt19937 rng(SEED + 3);
+    const std::vector<int> runs(count, 0);
+    measure<int>("core", "randomFleet", name, runs,
+                 [&rng](const int &) { return (long long)Board::randomFleet(rng).ships().lowest(); });
+
+    std::vector<Board> boards;
+    for (size_t i = 0; i < count; ++i) {
+        Board board = Board::randomFleet(rng);
+        // Каждая четвертая доска - с лишней палубой вплотную к кораблю
+        if (i % 4 == 3) {
+            typename Rules::Mask ships = board.ships();
+            ships.set((surroundingCells(ships) & ~ships).lowest());
+            board.setShips(ships);
+        }
+        boards.push_back(board);
+    }
+    measure<Board>("core", "isValidFleet", name, boards,
+                   [](const Board &board) { return board.isValidFleet() ? 1 : 0; });
+    measure<Board>("core", "FleetIndex::build", name, boards, [](const Board &board) {
+        BasicFleetIndex<Rules> fleet;
+        return fleet.build(board.ships()) ? fleet.shipCount() : 0;
+    });
+}
+
+void quietHandler(QtMsgType type, const QMessageLogContext &, const QString &message) {
+    // Отладочный вывод GameBoard искажает замеры
+    if (type >= QtWarningMsg) std::fprintf(stderr, "%s\n", qPrintable(message));
+}
+
+} // namespace
+
+class GameLogicBench
+{
+public:
+    static void runServer(const Corpus &random, const Corpus &adversarial, const Corpus &midgame) {
+        GameServer server;
+        // Неоткрытый пакетный канал молча отбрасывает датаграммы: замер
+        // включает кодирование ответов, но не системные вызовы
+        server.m_io = new BatchedUdpIo(&server);
+
+        for (const Corpus *corpus : {&random, &adversarial}) {
+            measure<BitBoard>("server", "validateBoard", corpus->name, corpus->boards,
+                              [&server](const BitBoard &board) { return server.validateBoard(board) ? 1 : 0; });
+        }
+
+        measure<BitBoard>("server", "FleetIndex::build", random.name, random.boards, [](const BitBoard &board) {
+            FleetIndex fleet;
+            return fleet.build(board.ships()) ? fleet.shipCount() : 0;
+        });
+
+        std::vector<FleetIndex> fleets(midgame.boards.size());
+        for (size_t b = 0; b < fleets.size(); ++b) {
+            fleets[b].build(midgame.boards[b].ships(), midgame.boards[b].hits());
+        }
+        const std::vector<HitCell> hits = hitCells(midgame);
+        measure<HitCell>("server", "checkShipSunk", midgame.name, hits, [&](const HitCell &cell) {
+            return server.checkShipSunk(fleets[size_t(cell.board)], cell.x, cell.y) ? 1 : 0;
+        });
+        measure<FleetIndex>("server", "checkGameOver", midgame.name, fleets,
+                            [&server](const FleetIndex &fleet) { return server.checkGameOver(fleet) ? 1 : 0; });
+
+        runShots(server, random);
+    }
+
+    static void runClient(const Corpus &random, const Corpus &adversarial, const Corpus &midgame, size_t count) {
+        for (const Corpus *corpus : {&random, &adversarial}) {
+            const std::vector<GameBoard *> widgets = toWidgets(*corpus);
+            measure<GameBoard *>("client", "isValidShipPlacement", corpus->name, widgets,
+                                 [](GameBoard *const &board) { return board->isValidShipPlacement() ? 1 : 0; });
+            qDeleteAll(widgets);
+        }
+
+        // Результат зависит от глобального генератора Qt, поэтому сумма
+        // здесь - число правильных расстановок, а не их содержимое
+        GameBoard scratch(true);
+        const std::vector<int> attempts(count, 0);
+        measure<int>("client", "placeRandomShips", "-", attempts, [&scratch](const int &) {
+            scratch.placeRandomShips();
+            return scratch.isValidShipPlacement() ? 1 : 0;
+        });
+
+        const std::vector<GameBoard *> widgets = toWidgets(midgame);
+        const std::vector<HitCell> hits = hitCells(midgame);
+        measure<HitCell>("client", "isShipSunk", midgame.name, hits, [&widgets](const HitCell &cell) {
+            return widgets[size_t(cell.board)]->isShipSunk(QPoint(cell.x, cell.y)) ? 1 : 0;
+        });
+        measure<HitCell>("client", "findShipCells", midgame.name, hits, [&widgets](const HitCell &cell) {
+            return (long long)widgets[size_t(cell.board)]->findShipCells(QPoint(cell.x, cell.y)).size();
+        });
+        qDeleteAll(widgets);
+    }
+
+private:
+    // Полные партии: два клиента стреляют по случайному порядку клеток,
+    // пока processShotResult не закроет лобби. Время - на один выстрел.
+    static void runShots(GameServer &server, const Corpus &corpus) {
+        ClientInfo info;
+        info.isConnected = true;
+        info.token = "bench-1";
+        info.peer.port = 1;
+        const ClientHandle first = server.allocateClient(info);
+        info.token = "bench-2";
+        info.peer.port = 2;
+        const ClientHandle second = server.allocateClient(info);
+
+        std::mt19937 rng(SEED + 3);
+        std::vector<std::vector<int>> orders(corpus.boards.size());
+        for (auto &order : orders) {
+            for (int c = 0; c < BitBoard::CELL_COUNT; ++c) order.push_back(c);
+            std::shuffle(order.begin(), order.end(), rng);
+        }
+
+        const QString lobbyId = "BENCH0";
+        double best = 1e300;
+        long long checksum = 0;
+        for (int r = 0; r < REPEATS; ++r) {
+            long long shots = 0;
+            Clock::duration elapsed{};
+            for (size_t g = 0; g + 1 < corpus.boards.size(); g += 2) {
+                Lobby lobby;
+                lobby.id = lobbyId;
+                lobby.player1 = first;
+                lobby.player2 = second;
+                lobby.player1Board = corpus.boards[g];
+                lobby.player2Board = corpus.boards[g + 1];
+                lobby.player1Fleet.build(lobby.player1Board.ships());
+                lobby.player2Fleet.build(lobby.player2Board.ships());
+                lobby.player1Ready = lobby.player2Ready = true;
+                lobby.isActive = true;
+                lobby.player1Turn = true;
+                server.m_lobbies.insert(lobbyId, lobby);
+
+                // Каждый игрок идет по своему порядку клеток
+                size_t next[2] = {0, 0};
+                const std::vector<int> *order[2] = {&orders[g], &orders[g + 1]};
+                const auto t0 = Clock::now();
+                while (const Lobby *current = server.m_lobbies.find(lobbyId)) {
+                    const int p = current->player1Turn ? 0 : 1;
+                    const int cell = (*order[p])[next[p]++];
+                    server.processShotResult(lobbyId, p == 0 ? first : second, cell % 10, cell / 10);
+                    ++shots;
+                }
+                elapsed += Clock::now() - t0;
+            }
+            best = std::min(best, std::chrono::duration<double, std::nano>(elapsed).count() / double(shots));
+            if (r == 0) checksum = shots;
+        }
+        report("server", "processShotResult", corpus.name, corpus.boards.size() / 2, best, checksum);
+    }
+};
+
+int main(int argc, char *argv[]) {
+    // Окна не показываются, виджетам нужен только QApplication
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+    qInstallMessageHandler(quietHandler);
+    QApplication app(argc, argv);
+
+    size_t count = 1000;
+    if (argc > 1) count = std::strtoul(argv[1], nullptr, 10);
+
+    const Corpus random = randomCorpus(count);
+    const Corpus adversarial = adversarialCorpus(count);
+    const Corpus midgame = midgameCorpus(count);
+
+    GameLogicBench::runServer(random, adversarial, midgame);
+    GameLogicBench::runClient(random, adversarial, midgame, count);
+    runVariant<ClassicRules>("classic10", count);
+    return 0;
+}
@@ -0,0 +1,22 @@
+QT += core network
+QT -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# Настройки для временных файлов
+MOC_DIR = build/moc
+OBJECTS_DIR = build/obj
+
+TEMPLATE = app
+
+INCLUDEPATH += ../../server ../../common
+
+SOURCES += \
+    main.cpp
+
+HEADERS += \
+    ../../server/flathashmap.h \
+    ../../server/peeraddress.h
+
+TARGET = hashmap_bench
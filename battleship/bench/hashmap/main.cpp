@@ -0,0 +1,159 @@
+// Сравнение реестров сервера: QMap, QHash и FlatHashMap на ключах тех же
+// типов, что и в GameServer (строковые id лобби и сырые адреса клиентов).
+//
+// Для каждого размера измеряются:
+//   insert      - заполнение пустого контейнера
+//   lookup-hit  - поиск существующих ключей в случайном порядке
+//   lookup-miss - поиск отсутствующих ключей
+//   churn       - удаление старого ключа и вставка нового (смена сессий)
+//
+// Вывод - одна строка на замер, поля через пробел, без лишнего текста,
+// чтобы результаты разных сборок можно было сравнивать через diff.
+// Запуск: hashmap_bench [размер ...], по умолчанию 10000 100000 1000000.
+
+#include <QHash>
+#include <QMap>
+#include <QString>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "flathashmap.h"
+#include "peeraddress.h"
+
+namespace {
+
+// Время в наносекундах на операцию, лучшее из REPEATS прогонов
+constexpr int REPEATS = 3;
+volatile long long g_sink = 0;
+
+using Clock = std::chrono::steady_clock;
+
+double nsPerOp(Clock::time_point start, Clock::time_point end, size_t ops) {
+    return std::chrono::duration<double, std::nano>(end - start).count() / double(ops);
+}
+
+QString lobbyKey(quint32 n) {
+    // Как у generateLobbyId: шесть символов из A-Z0-9
+    static const char chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    char id[7];
+    for (int i = 0; i < 6; ++i) {
+        id[i] = chars[n % 36];
+        n /= 36;
+    }
+    id[6] = '\0';
+    return QString::fromLatin1(id);
+}
+
+PeerAddress peerKey(quint32 n) {
+    // Клиенты из IPv4-сети за NAT: адрес ::ffff:10.x.y.z и разные порты
+    PeerAddress peer;
+    peer.ip[10] = 0xff;
+    peer.ip[11] = 0xff;
+    peer.ip[12] = 10;
+    peer.ip[13] = quint8(n >> 16);
+    peer.ip[14] = quint8(n >> 8);
+    peer.ip[15] = quint8(n);
+    peer.port = quint16(20000 + (n * 7919u) % 40000);
+    return peer;
+}
+
+} // namespace
+
+// Для QMap адресу нужен порядок
+bool operator<(const PeerAddress &a, const PeerAddress &b) {
+    const int c = std::memcmp(a.ip, b.ip, sizeof(a.ip));
+    return c != 0 ? c < 0 : a.port < b.port;
+}
+
+namespace {
+
+template <typename K> int lookupValue(const QMap<K, int> &map, const K &key) {
+    auto it = map.constFind(key);
+    return it != map.constEnd() ? *it : -1;
+}
+template <typename K> int lookupValue(const QHash<K, int> &map, const K &key) {
+    auto it = map.constFind(key);
+    return it != map.constEnd() ? *it : -1;
+}
+template <typename K> int lookupValue(const FlatHashMap<K, int, QtKeyHash> &map, const K &key) {
+    const int *value = map.find(key);
+    return value ? *value : -1;
+}
+
+template <typename Map, typename K>
+void runSuite(const char *container, const char *keyType, const std::vector<K> &keys,
+              const std::vector<K> &extra, size_t size) {
+    std::mt19937 rng(42);
+    std::vector<size_t> order(size);
+    for (size_t i = 0; i < size; ++i) order[i] = i;
+    std::shuffle(order.begin(), order.end(), rng);
+
+    double best[4] = {1e300, 1e300, 1e300, 1e300};
+    for (int r = 0; r < REPEATS; ++r) {
+        Map map;
+        auto t0 = Clock::now();
+        for (size_t i = 0; i < size; ++i) map.insert(keys[i], int(i));
+        auto t1 = Clock::now();
+        best[0] = std::min(best[0], nsPerOp(t0, t1, size));
+
+        long long sum = 0;
+        t0 = Clock::now();
+        for (size_t i : order) sum += lookupValue(map, keys[i]);
+        t1 = Clock::now();
+        best[1] = std::min(best[1], nsPerOp(t0, t1, size));
+
+        t0 = Clock::now();
+        for (size_t i = 0; i < size; ++i) sum += lookupValue(map, extra[i]);
+        t1 = Clock::now();
+        best[2] = std::min(best[2], nsPerOp(t0, t1, size));
+
+        // Старейшие клиенты уходят, новые приходят: размер не меняется
+        t0 = Clock::now();
+        for (size_t i = 0; i < size; ++i) {
+            map.remove(keys[i]);
+            map.insert(extra[i], int(i));
+        }
+        t1 = Clock::now();
+        best[3] = std::min(best[3], nsPerOp(t0, t1, size));
+        g_sink += sum;
+    }
+
+    static const char *ops[4] = {"insert", "lookup-hit", "lookup-miss", "churn"};
+    for (int op = 0; op < 4; ++op) {
+        std::printf("%-12s %-6s %-12s %8zu %10.1f ns/op\n", container, keyType, ops[op], size, best[op]);
+    }
+}
+
+template <typename K, typename MakeKey>
+void runKeyType(const char *keyType, size_t size, MakeKey makeKey) {
+    // Ключи вне диапазона [0, size) служат промахами и новыми записями
+    std::vector<K> keys, extra;
+    keys.reserve(size);
+    extra.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        keys.push_back(makeKey(quint32(i)));
+        extra.push_back(makeKey(quint32(i + size)));
+    }
+    runSuite<QMap<K, int>>("QMap", keyType, keys, extra, size);
+    runSuite<QHash<K, int>>("QHash", keyType, keys, extra, size);
+    runSuite<FlatHashMap<K, int, QtKeyHash>>("FlatHashMap", keyType, keys, extra, size);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; ++i) sizes.push_back(std::strtoul(argv[i], nullptr, 10));
+    if (sizes.empty()) sizes = {10000, 100000, 1000000};
+
+    for (size_t size : sizes) {
+        runKeyType<QString>("lobby", size, lobbyKey);
+        runKeyType<PeerAddress>("peer", size, peerKey);
+    }
+    std::printf("# sink %lld\n", static_cast<long long>(g_sink));
+    return 0;
+}
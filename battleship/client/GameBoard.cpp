@@ -19,6 +19,7 @@ void GameBoard::reset()
         row.resize(GRID_SIZE);
         row.fill(CellState::EMPTY);
     }
+    m_fleetReady = false;
     update();
 }
 
@@ -41,11 +42,11 @@ bool GameBoard::placeShip(const QPoint& bow, ShipSize size, bool horizontal)
     int shipSize = static_cast<int>(size);
     if (horizontal) {
         for (int x = bow.x(); x < bow.x() + shipSize; ++x) {
-            m_board[bow.y()][x] = CellState::SHIP;
+            setCell(x, bow.y(), CellState::SHIP);
         }
     } else {
         for (int y = bow.y(); y < bow.y() + shipSize; ++y) {
-            m_board[y][bow.x()] = CellState::SHIP;
+            setCell(bow.x(), y, CellState::SHIP);
         }
     }
     update();
@@ -54,47 +55,17 @@ bool GameBoard::placeShip(const QPoint& bow, ShipSize size, bool horizontal)
 
 bool GameBoard::canPlaceShip(const QPoint& bow, ShipSize size, bool horizontal) const
 {
+    // Границы и касание других кораблей - по правилам общего ядра
+    BitBoard board;
+    board.setShips(maskOf({CellState::SHIP}));
     const int shipSize = static_cast<int>(size);
-    const int endX = horizontal ? bow.x() + shipSize - 1 : bow.x();
-    const int endY = horizontal ? bow.y() : bow.y() + shipSize - 1;
-
-    // Проверка границ
-    if (bow.x() < 0 || bow.y() < 0 || endX >= GRID_SIZE || endY >= GRID_SIZE) {
+    if (!board.canPlaceShip(bow.x(), bow.y(), shipSize, horizontal)) {
         return false;
     }
 
-    // Проверка области вокруг корабля
-    for (int y = qMax(0, bow.y()-1); y <= qMin(GRID_SIZE-1, endY+1); ++y) {
-        for (int x = qMax(0, bow.x()-1); x <= qMin(GRID_SIZE-1, endX+1); ++x) {
-            if (m_board[y][x] == CellState::SHIP) {
-                // Проверяем, не является ли это частью нашего корабля
-                bool isOurShip = horizontal
-                    ? (y == bow.y() && x >= bow.x() && x <= endX)
-                    : (x == bow.x() && y >= bow.y() && y <= endY);
-
-                if (!isOurShip) {
-                    return false;
-                }
-            }
-        }
-    }
-
     // Проверяем, что все клетки под кораблем пустые
-    if (horizontal) {
-        for (int x = bow.x(); x <= endX; ++x) {
-            if (m_board[bow.y()][x] != CellState::EMPTY) {
-                return false;
-            }
-        }
-    } else {
-        for (int y = bow.y(); y <= endY; ++y) {
-            if (m_board[y][bow.x()] != CellState::EMPTY) {
-                return false;
-            }
-        }
-    }
-
-    return true;
+    const CellMask ship = BitBoard::shipMask(bow.x(), bow.y(), shipSize, horizontal);
+    return (ship & ~maskOf({CellState::EMPTY})).none();
 }
 
 GameBoard::CellState GameBoard::checkShot(const QPoint& position) const
@@ -120,19 +91,20 @@ void GameBoard::markShot(const QPoint& position, CellState result)
     }
 
     if (result == CellState::HIT) {
-        m_board[position.y()][position.x()] = CellState::HIT;
+        setCell(position.x(), position.y(), CellState::HIT);
         // Проверяем, не потоплен ли корабль
         if (isShipSunk(position)) {
             markSunkShip(position);
         }
     } else if (result == CellState::MISS) {
-        m_board[position.y()][position.x()] = CellState::MISS;
+        setCell(position.x(), position.y(), CellState::MISS);
     }
     update();
 }
 
 bool GameBoard::allShipsSunk() const
 {
+    if (ensureFleet()) return m_fleet.shipsLeft() == 0;
     for (const auto &row : m_board) {
         for (auto cell : row) {
             if (cell == CellState::SHIP) return false;
@@ -141,106 +113,22 @@ bool GameBoard::allShipsSunk() const
     return true;
 }
 
-bool GameBoard::placeRandomShips(int maxTotalAttempts)
+void GameBoard::placeRandomShips()
 {
     reset();
-    const ShipSize shipSizes[] = {
-        ShipSize::BATTLESHIP,
-        ShipSize::CRUISER, ShipSize::CRUISER,
-        ShipSize::DESTROYER, ShipSize::DESTROYER, ShipSize::DESTROYER,
-        ShipSize::SUBMARINE, ShipSize::SUBMARINE, ShipSize::SUBMARINE, ShipSize::SUBMARINE
-    };
-
-    int attempts = 0;
-    for (ShipSize size : shipSizes) {
-        bool placed = false;
-        int shipAttempts = 0;
-
-        while (!placed && attempts++ < maxTotalAttempts && shipAttempts++ < 50) {
-            bool horizontal = QRandomGenerator::global()->bounded(2) == 0;
-            int x = QRandomGenerator::global()->bounded(GRID_SIZE - (horizontal ? static_cast<int>(size) : 0));
-            int y = QRandomGenerator::global()->bounded(GRID_SIZE - (horizontal ? 0 : static_cast<int>(size)));
-
-            placed = placeShip(QPoint(x, y), size, horizontal);
-        }
-
-        if (!placed) {
-            qWarning() << "Failed to place all ships";
-            return false;
-        }
+    const CellMask ships = BitBoard::randomFleet(*QRandomGenerator::global()).ships();
+    for (CellMask rest = ships; rest.any(); ) {
+        const int i = rest.lowest();
+        rest.reset(i);
+        m_board[i / GRID_SIZE][i % GRID_SIZE] = CellState::SHIP;
     }
-    return true;
 }
 
 bool GameBoard::isValidShipPlacement() const
 {
-    int battleships = 0;
-    int cruisers = 0;
-    int destroyers = 0;
-    int submarines = 0;
-
-    QVector<QVector<bool>> visited(GRID_SIZE, QVector<bool>(GRID_SIZE, false));
-
-    for (int y = 0; y < GRID_SIZE; ++y) {
-        for (int x = 0; x < GRID_SIZE; ++x) {
-            if (m_board[y][x] == CellState::SHIP && !visited[y][x]) {
-                // Нашли начало корабля
-                int size = 1;
-                bool isHorizontal = true;
-
-                // Определяем направление корабля
-                if (x < GRID_SIZE-1 && m_board[y][x+1] == CellState::SHIP) {
-                    // Горизонтальный корабль
-                    isHorizontal = true;
-                    while (x+size < GRID_SIZE && m_board[y][x+size] == CellState::SHIP) {
-                        visited[y][x+size] = true;
-                        size++;
-                    }
-                } else {
-                    // Вертикальный корабль
-                    isHorizontal = false;
-                    while (y+size < GRID_SIZE && m_board[y+size][x] == CellState::SHIP) {
-                        visited[y+size][x] = true;
-                        size++;
-                    }
-                }
-
-                // Проверяем окружение корабля
-                int startX = qMax(0, x - 1);
-                int endX = qMin(GRID_SIZE-1, isHorizontal ? x + size : x + 1);
-                int startY = qMax(0, y - 1);
-                int endY = qMin(GRID_SIZE-1, isHorizontal ? y + 1 : y + size);
-
-                for (int i = startX; i <= endX; ++i) {
-                    for (int j = startY; j <= endY; ++j) {
-                        // Пропускаем клетки самого корабля
-                        bool isShipCell = isHorizontal
-                            ? (j == y && i >= x && i < x + size)
-                            : (i == x && j >= y && j < y + size);
-
-                        if (!isShipCell && m_board[j][i] == CellState::SHIP) {
-                            return false; // Корабли слишком близко
-                        }
-                    }
-                }
-
-                // Учитываем корабль соответствующего типа
-                switch(size) {
-                case 4: battleships++; break;
-                case 3: cruisers++; break;
-                case 2: destroyers++; break;
-                case 1: submarines++; break;
-                default: return false; // Недопустимый размер
-                }
-
-                visited[y][x] = true;
-            }
-        }
-    }
-
-    // Проверяем количество кораблей каждого типа
-    return battleships == 1 && cruisers == 2 &&
-           destroyers == 3 && submarines == 4;
+    BitBoard board;
+    board.setShips(maskOf({CellState::SHIP}));
+    return board.isValidFleet();
 }
 
 void GameBoard::paintEvent(QPaintEvent *event)
@@ -317,130 +205,41 @@ bool GameBoard::isShipSunk(const QPoint& position) const
 {
     if (m_board[position.y()][position.x()] != CellState::HIT) return false;
 
-    // Находим все клетки корабля
-    QVector<QPoint> shipCells;
-    shipCells.append(position);
-
-    // Проверяем все 4 направления
-    const QVector<QPair<int, int>> directions = {
-        {-1, 0}, // влево
-        {1, 0},  // вправо
-        {0, -1}, // вверх
-        {0, 1}   // вниз
-    };
-
-    // Проверяем каждое направление
-    for (const auto& dir : directions) {
-        int x = position.x() + dir.first;
-        int y = position.y() + dir.second;
-        
-        // Идем в этом направлении, пока находим клетки корабля
-        while (x >= 0 && x < GRID_SIZE && y >= 0 && y < GRID_SIZE) {
-            if (m_board[y][x] == CellState::SHIP || m_board[y][x] == CellState::HIT) {
-                shipCells.append(QPoint(x, y));
-                x += dir.first;
-                y += dir.second;
-            } else {
-                break;
-            }
-        }
-    }
-
-    // Проверяем, все ли клетки корабля подбиты
-    for (const QPoint &p : shipCells) {
-        if (m_board[p.y()][p.x()] != CellState::HIT) {
-            return false;
-        }
+    if (ensureFleet()) {
+        const int ship = m_fleet.shipAt(BitBoard::index(position.x(), position.y()));
+        return ship != FleetIndex::NO_SHIP && m_fleet.isSunk(ship);
     }
 
-    return true;
+    // Расстановка не складывается в корабли: не осталось ли целых палуб
+    return (shipCells(position) & maskOf({CellState::SHIP})).none();
 }
 
-void GameBoard::markSunk(const QPoint& position)
+void GameBoard::markAroundSunkShip(const QVector<QPoint>& shipCells)
 {
-    // Находим все клетки корабля
-    QVector<QPoint> shipCells;
-    
-    // Определяем направление корабля
-    bool isHorizontal = false;
-    if (position.x() < GRID_SIZE-1 && (m_board[position.y()][position.x()+1] == CellState::SHIP || 
-                                      m_board[position.y()][position.x()+1] == CellState::HIT)) {
-        isHorizontal = true;
-    } else if (position.y() < GRID_SIZE-1 && (m_board[position.y()+1][position.x()] == CellState::SHIP || 
-                                            m_board[position.y()+1][position.x()] == CellState::HIT)) {
-        isHorizontal = false;
-    }
-
-    // Собираем все клетки корабля
-    if (isHorizontal) {
-        // Ищем влево
-        for (int x = position.x(); x >= 0; --x) {
-            if (m_board[position.y()][x] == CellState::SHIP || 
-                m_board[position.y()][x] == CellState::HIT) {
-                shipCells.append(QPoint(x, position.y()));
-            } else {
-                break;
-            }
-        }
-        // Ищем вправо
-        for (int x = position.x() + 1; x < GRID_SIZE; ++x) {
-            if (m_board[position.y()][x] == CellState::SHIP || 
-                m_board[position.y()][x] == CellState::HIT) {
-                shipCells.append(QPoint(x, position.y()));
-            } else {
-                break;
-            }
-        }
-    } else {
-        // Ищем вверх
-        for (int y = position.y(); y >= 0; --y) {
-            if (m_board[y][position.x()] == CellState::SHIP || 
-                m_board[y][position.x()] == CellState::HIT) {
-                shipCells.append(QPoint(position.x(), y));
-            } else {
-                break;
-            }
-        }
-        // Ищем вниз
-        for (int y = position.y() + 1; y < GRID_SIZE; ++y) {
-            if (m_board[y][position.x()] == CellState::SHIP || 
-                m_board[y][position.x()] == CellState::HIT) {
-                shipCells.append(QPoint(position.x(), y));
-            } else {
-                break;
-            }
+    qDebug() << "[DEBUG] markAroundSunkShip called. isPlayerBoard=" << m_isPlayerBoard;
+    CellMask ship;
+    for (const QPoint& p : shipCells) {
+        if (p.x() >= 0 && p.x() < GRID_SIZE && p.y() >= 0 && p.y() < GRID_SIZE) {
+            ship.set(BitBoard::index(p.x(), p.y()));
         }
     }
-
-    // Помечаем все клетки корабля как потопленные
-    for (const QPoint &p : shipCells) {
-        m_board[p.y()][p.x()] = CellState::SUNK;
-    }
-
-    // Помечаем клетки вокруг потопленного корабля
-    markAroundSunkShip(shipCells);
-
-    update();
+    markAround(surroundingCells(ship) & ~ship);
 }
 
-void GameBoard::markAroundSunkShip(const QVector<QPoint>& shipCells)
+void GameBoard::markAround(const CellMask &halo)
 {
-    qDebug() << "[DEBUG] markAroundSunkShip called. isPlayerBoard=" << m_isPlayerBoard;
-    for (const QPoint& p : shipCells) {
-        for (int dy = -1; dy <= 1; ++dy) {
-            for (int dx = -1; dx <= 1; ++dx) {
-                int nx = p.x() + dx;
-                int ny = p.y() + dy;
-                if (nx >= 0 && nx < GRID_SIZE && ny >= 0 && ny < GRID_SIZE) {
-                    if (m_board[ny][nx] == CellState::EMPTY) {
-                        qDebug() << "[DEBUG] markAroundSunkShip: MISS set at (" << nx << "," << ny << ")";
-                        m_board[ny][nx] = CellState::MISS;
-                    }
-                }
-            }
+    for (CellMask rest = halo; rest.any(); ) {
+        const int i = rest.lowest();
+        rest.reset(i);
+        const int nx = i % GRID_SIZE;
+        const int ny = i / GRID_SIZE;
+        if (m_board[ny][nx] == CellState::EMPTY) {
+            qDebug() << "[DEBUG] markAroundSunkShip: MISS set at (" << nx << "," << ny << ")";
+            m_board[ny][nx] = CellState::MISS;
         }
     }
 }
+
 void GameBoard::mousePressEvent(QMouseEvent *event)
 {
     if (event->button() == Qt::LeftButton) {
@@ -476,6 +275,7 @@ void GameBoard::setBoard(const QVector<QVector<int>>& board) {
             m_board[y][x] = static_cast<CellState>(board[y][x]);
         }
     }
+    m_fleetReady = false;
     update();
 }
 
@@ -494,22 +294,22 @@ bool GameBoard::makeShot(const QPoint& position) {
     // Если это поле компьютера, то мы не видим его корабли
     if (!m_isPlayerBoard) {
         if (m_board[position.y()][position.x()] == CellState::SHIP) {
-            m_board[position.y()][position.x()] = CellState::HIT;
+            setCell(position.x(), position.y(), CellState::HIT);
             update();
             return true;
         } else {
-            m_board[position.y()][position.x()] = CellState::MISS;
+            setCell(position.x(), position.y(), CellState::MISS);
             update();
             return false;
         }
     } else {
         // Для поля игрока
         if (m_board[position.y()][position.x()] == CellState::SHIP) {
-            m_board[position.y()][position.x()] = CellState::HIT;
+            setCell(position.x(), position.y(), CellState::HIT);
             update();
             return true;
         } else if (m_board[position.y()][position.x()] == CellState::EMPTY) {
-            m_board[position.y()][position.x()] = CellState::MISS;
+            setCell(position.x(), position.y(), CellState::MISS);
             update();
             return false;
         }
@@ -529,7 +329,7 @@ void GameBoard::setCellState(const QPoint& position, CellState state) {
     if (position.x() < 0 || position.x() >= GRID_SIZE ||
         position.y() < 0 || position.y() >= GRID_SIZE)
         return;
-    m_board[position.y()][position.x()] = state;
+    setCell(position.x(), position.y(), state);
     update();
 }
 
@@ -537,7 +337,7 @@ void GameBoard::markHit(const QPoint& position)
 {
     if (position.x() >= 0 && position.x() < GRID_SIZE && 
         position.y() >= 0 && position.y() < GRID_SIZE) {
-        m_board[position.y()][position.x()] = CellState::HIT;
+        setCell(position.x(), position.y(), CellState::HIT);
         update();
     }
 }
@@ -546,7 +346,7 @@ void GameBoard::markMiss(const QPoint& position)
 {
     if (position.x() >= 0 && position.x() < GRID_SIZE && 
         position.y() >= 0 && position.y() < GRID_SIZE) {
-        m_board[position.y()][position.x()] = CellState::MISS;
+        setCell(position.x(), position.y(), CellState::MISS);
         update();
     }
 }
@@ -605,41 +405,37 @@ GameBoard::ShipSize GameBoard::getShipType(const QPoint& pos) const
 void GameBoard::markSunkShip(const QPoint& position)
 {
     qDebug() << "[DEBUG] markSunkShip called at (" << position.x() << "," << position.y() << ") isPlayerBoard=" << m_isPlayerBoard;
-    QVector<QPoint> shipCells = findShipCells(position);
-    for (const QPoint& p : shipCells) {
-        m_board[p.y()][p.x()] = CellState::SUNK;
+    const CellMask ship = shipCells(position);
+    for (CellMask rest = ship; rest.any(); ) {
+        const int i = rest.lowest();
+        rest.reset(i);
+        setCell(i % GRID_SIZE, i / GRID_SIZE, CellState::SUNK);
     }
-    markAroundSunkShip(shipCells);
+    markAround(surroundingCells(ship) & ~ship);
     update();
 }
 
+CellMask GameBoard::shipCells(const QPoint& position) const
+{
+    const int cell = BitBoard::index(position.x(), position.y());
+    // Палубы корабля уже посчитаны в индексе
+    const int ship = ensureFleet() ? m_fleet.shipAt(cell) : FleetIndex::NO_SHIP;
+    if (ship != FleetIndex::NO_SHIP) return m_fleet.shipCells(ship);
+
+    CellMask from;
+    from.set(cell);
+    return connectedCells(maskOf({CellState::SHIP, CellState::HIT, CellState::SUNK}), from);
+}
 
 QVector<QPoint> GameBoard::findShipCells(const QPoint& position) const
 {
-    QVector<QPoint> shipCells;
-    shipCells.append(position);
-    
-    // Проверяем все 4 направления
-    const QVector<QPair<int, int>> directions = {
-        {-1, 0}, {1, 0}, {0, -1}, {0, 1}
-    };
-    
-    for (const auto& dir : directions) {
-        int x = position.x() + dir.first;
-        int y = position.y() + dir.second;
-        
-        while (x >= 0 && x < GRID_SIZE && y >= 0 && y < GRID_SIZE) {
-            if (m_board[y][x] == CellState::SHIP || m_board[y][x] == CellState::HIT) {
-                shipCells.append(QPoint(x, y));
-                x += dir.first;
-                y += dir.second;
-            } else {
-                break;
-            }
-        }
+    QVector<QPoint> cells;
+    for (CellMask rest = shipCells(position); rest.any(); ) {
+        const int i = rest.lowest();
+        rest.reset(i);
+        cells.append(QPoint(i % GRID_SIZE, i / GRID_SIZE));
     }
-    
-    return shipCells;
+    return cells;
 }
 
 QVector<QVector<int>> GameBoard::getInitialBoard() const {
@@ -654,3 +450,43 @@ QVector<QVector<int>> GameBoard::getInitialBoard() const {
     }
     return result;
 }
+
+void GameBoard::setCell(int x, int y, CellState state)
+{
+    CellState &cell = m_board[y][x];
+    if (m_fleetReady && cell != state) {
+        auto isDeck = [](CellState s) {
+            return s == CellState::SHIP || s == CellState::HIT || s == CellState::SUNK;
+        };
+        if (cell == CellState::SHIP && (state == CellState::HIT || state == CellState::SUNK)) {
+            m_fleet.hit(BitBoard::index(x, y));
+        } else if (state == CellState::SHIP || isDeck(cell) != isDeck(state)) {
+            // Палуба появилась, исчезла или снова стала целой
+            m_fleetReady = false;
+        }
+    }
+    cell = state;
+}
+
+bool GameBoard::ensureFleet() const
+{
+    if (!m_fleetReady) {
+        const CellMask hits = maskOf({CellState::HIT, CellState::SUNK});
+        m_fleetValid = m_fleet.build(maskOf({CellState::SHIP}) | hits, hits);
+        m_fleetReady = true;
+    }
+    return m_fleetValid;
+}
+
+CellMask GameBoard::maskOf(std::initializer_list<CellState> states) const
+{
+    CellMask mask;
+    for (int y = 0; y < GRID_SIZE; ++y) {
+        for (int x = 0; x < GRID_SIZE; ++x) {
+            for (CellState state : states) {
+                if (m_board[y][x] == state) mask.set(BitBoard::index(x, y));
+            }
+        }
+    }
+    return mask;
+}
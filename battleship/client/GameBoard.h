@@ -4,6 +4,8 @@
 #include <QWidget>
 #include <QVector>
 #include <QPoint>
+#include <initializer_list>
+#include "bitboard.h"
 
 class GameBoard : public QWidget
 {
@@ -16,6 +18,8 @@ public:
         CRUISER = 3,
         BATTLESHIP = 4
     };
+    static_assert(static_cast<int>(ShipSize::BATTLESHIP) == BitBoard::MAX_SHIP_SIZE,
+                  "ship types must cover the fleet");
 
     enum class CellState {
         EMPTY = 0,
@@ -25,7 +29,9 @@ public:
         SUNK = 4
     };
 
-    static const int GRID_SIZE = 10;
+    // Виджет рисует классическое квадратное поле
+    static const int GRID_SIZE = BitBoard::WIDTH;
+    static_assert(BitBoard::WIDTH == BitBoard::HEIGHT, "GameBoard draws a square grid");
     static const int CELL_SIZE = 30;
     static const int MARGIN = 20;
 
@@ -35,7 +41,7 @@ public:
     void setPlacementMode(bool enabled);
     bool placeShip(const QPoint& bow, ShipSize size, bool horizontal);
     bool canPlaceShip(const QPoint& bow, ShipSize size, bool horizontal) const;
-    bool placeRandomShips(int maxTotalAttempts = 1000);
+    void placeRandomShips();
     bool isValidShipPlacement() const;
     bool allShipsSunk() const;
     CellState checkShot(const QPoint& position) const;
@@ -46,12 +52,14 @@ public:
     QVector<QVector<int>> getBoard() const;
     void setBoard(const QVector<QVector<int>>& board);
     bool isShipSunk(const QPoint& position) const;
-    void markSunk(const QPoint& position);
     void markHit(const QPoint& position);
     void markMiss(const QPoint& position);
     void markAroundSunkShip(const QVector<QPoint>& shipCells);
     ShipSize getShipType(const QPoint& pos) const;
     void markSunkShip(const QPoint& position);
+    // Палубы корабля, проходящего через position: из индекса кораблей, а
+    // если расстановка в корабли не складывается - связная область палуб
+    CellMask shipCells(const QPoint& position) const;
     QVector<QPoint> findShipCells(const QPoint& position) const;
     QVector<QVector<int>> getInitialBoard() const;
 
@@ -68,8 +76,21 @@ private:
     QRect cellRect(int row, int col) const;
     void drawNumbers(QPainter &painter);
     void drawLetters(QPainter &painter);
+    // Запись одной клетки с поправкой индекса кораблей
+    void setCell(int x, int y, CellState state);
+    // Строит индекс, если расстановка менялась. false - палубы не
+    // складываются в корабли, проверки идут обходом поля
+    bool ensureFleet() const;
+    void markAround(const CellMask &halo);
+    // Клетки поля в одном из состояний states
+    CellMask maskOf(std::initializer_list<CellState> states) const;
 
     QVector<QVector<CellState>> m_board;
+    // Индекс кораблей для isShipSunk, allShipsSunk и shipCells. Попадания
+    // уменьшают его счетчики на месте, другие изменения палуб сбрасывают
+    mutable FleetIndex m_fleet;
+    mutable bool m_fleetReady = false;
+    mutable bool m_fleetValid = false;
     bool m_isPlayerBoard;
     bool m_placementMode;
     bool m_gameOver;
@@ -11,18 +11,31 @@
 #include <QGroupBox>
 #include <QRadioButton>
 #include <QVector>
+#include <QFutureWatcher>
+#include <memory>
 #include "GameBoard.h"
 #include "NetworkClient.h"
+#include "shotstrategy.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
 QT_END_NAMESPACE
 
+// Расставленные корабли по длине; сколько нужно - флот ядра BitBoard::Fleet
 struct ShipCount {
-    int battleships = 0;
-    int cruisers = 0;
-    int destroyers = 0;
-    int submarines = 0;
+    int placed[BitBoard::MAX_SHIP_SIZE + 1] = {0};
+
+    int count(GameBoard::ShipSize size) const { return placed[static_cast<int>(size)]; }
+    void add(GameBoard::ShipSize size) { ++placed[static_cast<int>(size)]; }
+    bool isFull(GameBoard::ShipSize size) const {
+        return count(size) >= BitBoard::Fleet::COUNT[static_cast<int>(size)];
+    }
+    bool isComplete() const {
+        for (int length = 1; length <= BitBoard::MAX_SHIP_SIZE; ++length) {
+            if (placed[length] != BitBoard::Fleet::COUNT[length]) return false;
+        }
+        return true;
+    }
 };
 
 class MainWindow : public QMainWindow
@@ -46,6 +59,7 @@ private slots:
     // Game slots
     void onOpponentBoardCellClicked(const QPoint& position);
     void onSendChatClicked();
+    void onAIMoveReady();
     
     // Network slots
     void onConnectClicked();
@@ -80,14 +94,13 @@ private:
     QString getShipTypeName(GameBoard::ShipSize type) const;
     bool checkOpponentBoardForWin();
     void opponentMove();
-    QPoint getNextAIMove();
+    std::shared_ptr<ShotStrategy> createAI() const;
     void updateShipSelectionUI();
-    void addAdjacentCells(const QPoint& pos);
-    bool checkShipSunk(const QPoint& position);
     
     // Helper methods
     int getCurrentShipCount() const;
     void selectNextAvailableShipType();
+    QRadioButton *shipRadio(GameBoard::ShipSize size) const;
 
     Ui::MainWindow *ui;
     
@@ -99,7 +112,6 @@ private:
     bool m_isHorizontal;
     bool m_isConnected;
     bool m_networkMode;
-    bool m_aiFoundShip;
     
     // Ship placement state
     GameBoard::ShipSize m_currentShipType;
@@ -111,9 +123,16 @@ private:
     NetworkClient* m_networkClient;
     
     // AI state
-    QVector<QPoint> m_aiPossibleMoves;
-    QVector<QPoint> m_activeHits;
-    QPoint m_lastAIMove;
+    // Бот офлайн-режима и то, что он знает о поле игрока. Ход считается в
+    // пуле потоков Qt, m_aiWatcher сообщает о готовом ходе
+    static const int AI_SAMPLES = 20000;
+    static const int AI_DEADLINE_MS = 300;
+    bool m_aiHard = false;            // montecarlo вместо density
+    std::shared_ptr<ShotStrategy> m_ai;
+    ShotHistory m_aiHistory;
+    QFutureWatcher<int> m_aiWatcher;
+    quint32 m_aiGeneration = 0;       // номер партии, растет в resetGame
+    quint32 m_aiMoveGeneration = 0;   // партия, для которой считается ход
     
     // UI components
     QStackedWidget* m_stackedWidget;
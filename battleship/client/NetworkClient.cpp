@@ -1,15 +1,19 @@
 #include "NetworkClient.h"
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QJsonArray>
 #include <QDebug>
 
 NetworkClient::NetworkClient(QObject *parent) : QObject(parent),
     m_socket(new QUdpSocket(this)),
-    m_isYourTurn(false)
+    m_isYourTurn(false),
+    m_wireFormat(Protocol::WireFormat::Json),
+    m_reliable(false),
+    m_retransmitTimer(new QTimer(this))
 {
     connect(m_socket, &QUdpSocket::readyRead, this, &NetworkClient::onReadyRead);
     connect(m_socket, &QUdpSocket::errorOccurred, this, &NetworkClient::onError);
+    
+    m_clock.start();
+    m_retransmitTimer->setSingleShot(true);
+    connect(m_retransmitTimer, &QTimer::timeout, this, &NetworkClient::onRetransmitTimeout);
 }
 
 NetworkClient::~NetworkClient()
@@ -24,6 +28,9 @@ void NetworkClient::connectToServer(const QString &address, quint16 port)
 {
     m_serverAddress = QHostAddress(address);
     m_serverPort = port;
+    // До подтверждения сервером общаемся в JSON
+    m_wireFormat = Protocol::WireFormat::Json;
+    resetChannel();
     
     if (m_socket->state() == QAbstractSocket::BoundState) {
         m_socket->close();
@@ -41,6 +48,7 @@ void NetworkClient::connectToServer(const QString &address, quint16 port)
 
 void NetworkClient::disconnect()
 {
+    resetChannel();
     m_socket->close();
     emit disconnected();
 }
@@ -48,104 +56,111 @@ void NetworkClient::disconnect()
 void NetworkClient::login(const QString &username)
 {
     m_username = username;
-    QJsonObject loginMsg;
-    loginMsg["type"] = "login";
-    loginMsg["username"] = username;
+    Protocol::Message loginMsg;
+    loginMsg.type = Protocol::MessageType::Login;
+    loginMsg.username = username;
+    // Предлагаем серверу двоичный протокол, старый сервер просто проигнорирует поле
+    loginMsg.protocolVersion = Protocol::VERSION;
+    // Просим повторять важные сообщения до подтверждения; вход
+    // начинает канал заново
+    loginMsg.reliable = true;
+    // События одного хода сервер может прислать одной пачкой
+    loginMsg.bundles = true;
+    resetChannel();
     qDebug() << "Sending login request for user:" << username;
-    sendJson(loginMsg);
+    sendMessage(loginMsg);
 }
 
 void NetworkClient::createGame()
 {
-    QJsonObject msg;
-    msg["type"] = "create_game";
+    Protocol::Message msg;
+    msg.type = Protocol::MessageType::CreateGame;
     qDebug() << "Sending create game request";
-    sendJson(msg);
+    sendMessage(msg);
 }
 
 void NetworkClient::joinGame()
 {
-    QJsonObject msg;
-    msg["type"] = "join_game";
+    Protocol::Message msg;
+    msg.type = Protocol::MessageType::JoinGame;
     qDebug() << "Sending join game request";
-    sendJson(msg);
+    sendMessage(msg);
 }
 
 void NetworkClient::sendReadyWithBoard(const QVector<QVector<int>> &board)
 {
     // Сначала отправляем доску
-    QJsonObject boardMsg;
-    boardMsg["type"] = "board";
+    Protocol::Message boardMsg;
+    boardMsg.type = Protocol::MessageType::Board;
+    boardMsg.boardStatus = Protocol::BoardStatus::Ok;
     
-    QJsonArray boardArray;
-    for (const auto &row : board) {
-        QJsonArray jsonRow;
-        for (int cell : row) {
-            jsonRow.append(cell);
+    for (int y = 0; y < board.size() && y < BitBoard::HEIGHT; ++y) {
+        for (int x = 0; x < board[y].size() && x < BitBoard::WIDTH; ++x) {
+            if (board[y][x] == BitBoard::SHIP) {
+                boardMsg.board.setShip(x, y);
+            }
         }
-        boardArray.append(jsonRow);
     }
-    boardMsg["board"] = boardArray;
     
     qDebug() << "Sending board";
-    sendJson(boardMsg);
+    sendMessage(boardMsg);
     
     // Затем отправляем сигнал готовности
-    QJsonObject readyMsg;
-    readyMsg["type"] = "ready";
+    Protocol::Message readyMsg;
+    readyMsg.type = Protocol::MessageType::Ready;
     
     qDebug() << "Sending ready message";
-    sendJson(readyMsg);
+    sendMessage(readyMsg);
 }
 
 void NetworkClient::sendShot(int x, int y)
 {
-    QJsonObject msg;
-    msg["type"] = "shot";
-    msg["x"] = x;
-    msg["y"] = y;
+    Protocol::Message msg;
+    msg.type = Protocol::MessageType::Shot;
+    msg.x = x;
+    msg.y = y;
     qDebug() << "Sending shot at (" << x << "," << y << ")";
-    sendJson(msg);
+    sendMessage(msg);
 }
 
 void NetworkClient::sendShotResult(int x, int y, bool hit)
 {
-    QJsonObject msg;
-    msg["type"] = "shot_result";
-    msg["x"] = x;
-    msg["y"] = y;
-    msg["hit"] = hit;
+    Protocol::Message msg;
+    msg.type = Protocol::MessageType::ShotResult;
+    msg.x = x;
+    msg.y = y;
+    msg.hit = hit;
     qDebug() << "Sending shot result at (" << x << "," << y << "):" << (hit ? "hit" : "miss");
-    sendJson(msg);
+    sendMessage(msg);
 }
 
 void NetworkClient::sendShipSunk(int x, int y)
 {
-    QJsonObject msg;
-    msg["type"] = "ship_sunk";
-    msg["x"] = x;
-    msg["y"] = y;
+    Protocol::Message msg;
+    msg.type = Protocol::MessageType::ShipSunk;
+    msg.x = x;
+    msg.y = y;
     qDebug() << "Sending ship sunk at (" << x << "," << y << ")";
-    sendJson(msg);
+    sendMessage(msg);
 }
 
 void NetworkClient::sendChatMessage(const QString &message)
 {
-    QJsonObject msg;
-    msg["type"] = "chat_message";
-    msg["message"] = message;
-    msg["sender"] = m_username;
+    Protocol::Message msg;
+    msg.type = Protocol::MessageType::ChatMessage;
+    msg.text = message;
+    msg.sender = m_username;
     qDebug() << "Sending chat message:" << message;
-    sendJson(msg);
+    sendMessage(msg);
 }
 
 void NetworkClient::gameOver(bool youWin)
 {
-    QJsonObject msg;
-    msg["type"] = "game_over";
-    msg["result"] = youWin ? "win" : "loss";
+    Protocol::Message msg;
+    msg.type = Protocol::MessageType::GameOver;
+    msg.win = youWin;
     qDebug() << "Sending game over message:" << (youWin ? "win" : "loss");
-    sendJson(msg);
+    sendMessage(msg);
 }
 
 bool NetworkClient::isYourTurn() const
@@ -163,11 +178,59 @@ void NetworkClient::onReadyRead()
 
         m_socket->readDatagram(datagram.data(), datagram.size(), &sender, &senderPort);
 
-        QJsonDocument doc = QJsonDocument::fromJson(datagram);
-        if (doc.isObject()) {
-            processMessage(doc.object());
+        if (ReliableChannel::isEnvelope(datagram)) {
+            if (!m_reliable) continue;
+            QByteArray payload;
+            if (m_channel.unwrap(datagram, &payload, m_clock.elapsed()) != ReliableChannel::Receive::Deliver) {
+                continue;
+            }
+            datagram = payload;
+        }
+
+        Protocol::Message msg;
+        if (Protocol::decode(datagram, msg)) {
+            processMessage(msg);
+        }
+    }
+
+    if (m_reliable) {
+        // Ответ на полученное уже увез подтверждение, иначе шлем его отдельно
+        if (m_channel.ackPending()) {
+            sendDatagram(m_channel.makeAck());
         }
+        armRetransmitTimer();
+    }
+}
+
+void NetworkClient::onRetransmitTimeout()
+{
+    int abandoned = 0;
+    const QVector<QByteArray> datagrams = m_channel.takeRetransmits(m_clock.elapsed(), &abandoned);
+    for (const QByteArray &datagram : datagrams) {
+        sendDatagram(datagram);
+    }
+    if (abandoned > 0) {
+        qDebug() << "Server did not acknowledge" << abandoned << "messages";
+        emit error("Сервер не отвечает");
     }
+    armRetransmitTimer();
+}
+
+void NetworkClient::resetChannel()
+{
+    m_reliable = false;
+    m_channel = ReliableChannel();
+    m_retransmitTimer->stop();
+}
+
+void NetworkClient::armRetransmitTimer()
+{
+    const qint64 deadline = m_channel.nextDeadline();
+    if (deadline < 0) {
+        m_retransmitTimer->stop();
+        return;
+    }
+    m_retransmitTimer->start(int(qMax<qint64>(0, deadline - m_clock.elapsed())));
 }
 
 void NetworkClient::onError(QAbstractSocket::SocketError socketError)
@@ -177,7 +240,7 @@ void NetworkClient::onError(QAbstractSocket::SocketError socketError)
     emit error(errorString);
 }
 
-void NetworkClient::sendJson(const QJsonObject &jsonObject)
+void NetworkClient::sendMessage(const Protocol::Message &msg)
 {
     if (m_socket->state() != QAbstractSocket::BoundState) {
         qDebug() << "Socket is not bound, cannot send data";
@@ -185,8 +248,19 @@ void NetworkClient::sendJson(const QJsonObject &jsonObject)
         return;
     }
 
-    QJsonDocument doc(jsonObject);
-    QByteArray data = doc.toJson();
+    QByteArray data = Protocol::encode(msg, m_wireFormat);
+    if (m_reliable) {
+        const bool reliable = Protocol::requiresDelivery(msg.type);
+        data = m_channel.wrap(data, reliable, m_clock.elapsed());
+        if (reliable) {
+            armRetransmitTimer();
+        }
+    }
+    sendDatagram(data);
+}
+
+void NetworkClient::sendDatagram(const QByteArray &data)
+{
     qint64 bytesWritten = m_socket->writeDatagram(data, m_serverAddress, m_serverPort);
     
     if (bytesWritten == -1) {
@@ -198,78 +272,92 @@ void NetworkClient::sendJson(const QJsonObject &jsonObject)
     }
 }
 
-void NetworkClient::processMessage(const QJsonObject &jsonObject)
+void NetworkClient::processMessage(const Protocol::Message &msg)
 {
-    QString type = jsonObject["type"].toString();
-    qDebug() << "Received message of type:" << type;
+    using Protocol::MessageType;
+    qDebug() << "Received message of type:" << Protocol::typeName(msg.type);
     
-    if (type == "login_response") {
-        bool success = jsonObject["success"].toBool();
-        qDebug() << "Login response:" << (success ? "success" : "failed");
-        emit loginResponse(success);
-    }
-    else if (type == "lobby_created") {
-        QString lobbyId = jsonObject["lobby_id"].toString();
-        qDebug() << "Lobby created with ID:" << lobbyId;
-        emit lobbyCreated(lobbyId);
-    }
-    else if (type == "game_found") {
-        QString opponent = jsonObject["opponent"].toString();
-        qDebug() << "Game found with opponent:" << opponent;
-        emit gameFound(opponent);
+    switch (msg.type) {
+    case MessageType::LoginResponse: {
+        qDebug() << "Login response:" << (msg.success ? "success" : "failed");
+        // Сервер подтвердил двоичный протокол - переключаемся на него
+        if (msg.success && msg.protocolVersion > 0 && msg.protocolVersion <= Protocol::VERSION) {
+            m_wireFormat = Protocol::WireFormat::Binary;
+            qDebug() << "Switched to binary protocol, version" << msg.protocolVersion;
+        }
+        // Сервер поддерживает подтверждения - дальше все идет в конвертах
+        if (msg.success && msg.reliable) {
+            m_reliable = true;
+            qDebug() << "Reliable delivery enabled";
+        }
+        emit loginResponse(msg.success);
+        break;
     }
-    else if (type == "waiting_for_opponent") {
+    case MessageType::LobbyCreated:
+        qDebug() << "Lobby created with ID:" << msg.lobbyId;
+        emit lobbyCreated(msg.lobbyId);
+        break;
+    case MessageType::GameFound:
+        qDebug() << "Game found with opponent:" << msg.opponent;
+        emit gameFound(msg.opponent);
+        break;
+    case MessageType::WaitingForOpponent:
         qDebug() << "Waiting for opponent to join";
         emit waitingForOpponent();
-    }
-    else if (type == "shot_result") {
-        int x = jsonObject["x"].toInt();
-        int y = jsonObject["y"].toInt();
-        bool hit = jsonObject["hit"].toBool();
-        qDebug() << "Shot result at (" << x << "," << y << "):" << (hit ? "hit" : "miss");
-        emit shotResult(x, y, hit);
-    }
-    else if (type == "game_over") {
-        bool youWin = jsonObject["result"].toString() == "win";
-        qDebug() << "Game over:" << (youWin ? "you won" : "you lost");
-        emit gameOverSignal(youWin);
-    }
-    else if (type == "chat_message") {
-        QString sender = jsonObject["sender"].toString();
-        QString message = jsonObject["message"].toString();
-        qDebug() << "Chat message received from" << sender << ":" << message;
-        qDebug() << "Full chat message:" << jsonObject;
-        emit chatMessageReceived(sender, message);
-    }
-    else if (type == "shot_received") {
-        int x = jsonObject["x"].toInt();
-        int y = jsonObject["y"].toInt();
-        qDebug() << "Received shot at (" << x << "," << y << ")";
-        emit shotReceived(x, y);
-    }
-    else if (type == "turn_change") {
-        m_isYourTurn = jsonObject["your_turn"].toBool();
+        break;
+    case MessageType::ShotResult:
+        qDebug() << "Shot result at (" << msg.x << "," << msg.y << "):" << (msg.hit ? "hit" : "miss");
+        emit shotResult(msg.x, msg.y, msg.hit);
+        break;
+    case MessageType::GameOver:
+        qDebug() << "Game over:" << (msg.win ? "you won" : "you lost");
+        emit gameOverSignal(msg.win);
+        break;
+    case MessageType::ChatMessage:
+        qDebug() << "Chat message received from" << msg.sender << ":" << msg.text;
+        emit chatMessageReceived(msg.sender, msg.text);
+        break;
+    case MessageType::ShotReceived:
+        qDebug() << "Received shot at (" << msg.x << "," << msg.y << ")";
+        emit shotReceived(msg.x, msg.y);
+        break;
+    case MessageType::TurnChange:
+        if (!m_channel.acceptState(Protocol::stateClass(msg.type))) {
+            qDebug() << "Stale turn_change ignored";
+            break;
+        }
+        m_isYourTurn = msg.yourTurn;
         qDebug() << "Turn changed:" << (m_isYourTurn ? "your turn" : "opponent's turn");
         emit turnChanged(m_isYourTurn);
-    }
-    else if (type == "game_start") {
+        break;
+    case MessageType::GameStart:
         qDebug() << "Game started!";
-        // При старте игры первый ход должен быть у создателя лобби
-        m_isYourTurn = jsonObject["your_turn"].toBool();
-        qDebug() << "Initial turn state:" << (m_isYourTurn ? "your turn" : "opponent's turn");
+        // При старте игры первый ход должен быть у создателя лобби. Если
+        // game_start опоздал после turn_change, ход уже известен из него
+        if (m_channel.acceptState(Protocol::stateClass(msg.type))) {
+            m_isYourTurn = msg.yourTurn;
+            qDebug() << "Initial turn state:" << (m_isYourTurn ? "your turn" : "opponent's turn");
+        }
         emit turnChanged(m_isYourTurn);
         emit gameStartConfirmed();
-    }
-    else if (type == "ping") {
-        return;
-    }
-    else if (type == "ship_sunk") {
-        int x = jsonObject["x"].toInt();
-        int y = jsonObject["y"].toInt();
-        qDebug() << "Ship sunk at (" << x << "," << y << ")";
-        emit shipSunk(x, y);
-    }
-    else {
-        qDebug() << "Unknown message type:" << type;
+        break;
+    case MessageType::Ping:
+        break;
+    case MessageType::Bundle:
+        // События одного хода в порядке, в котором их отправил сервер
+        for (const QByteArray &part : msg.parts) {
+            Protocol::Message inner;
+            if (Protocol::decode(part, inner) && inner.type != MessageType::Bundle) {
+                processMessage(inner);
+            }
+        }
+        break;
+    case MessageType::ShipSunk:
+        qDebug() << "Ship sunk at (" << msg.x << "," << msg.y << ")";
+        emit shipSunk(msg.x, msg.y);
+        break;
+    default:
+        qDebug() << "Unknown message type:" << Protocol::typeName(msg.type);
+        break;
     }
 }
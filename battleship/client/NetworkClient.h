@@ -4,6 +4,10 @@
 #include <QObject>
 #include <QUdpSocket>
 #include <QVector>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "protocol.h"
+#include "reliablechannel.h"
 
 class NetworkClient : public QObject
 {
@@ -45,16 +49,26 @@ signals:
 private slots:
     void onReadyRead();
     void onError(QAbstractSocket::SocketError socketError);
+    void onRetransmitTimeout();
 
 private:
-    void sendJson(const QJsonObject &jsonObject);
-    void processMessage(const QJsonObject &jsonObject);
+    void sendMessage(const Protocol::Message &msg);
+    void sendDatagram(const QByteArray &data);
+    void processMessage(const Protocol::Message &msg);
+    void resetChannel();
+    void armRetransmitTimer();
 
     QUdpSocket *m_socket;
     bool m_isYourTurn;
     QString m_username;
     QHostAddress m_serverAddress;
     quint16 m_serverPort;
+    Protocol::WireFormat m_wireFormat;
+    // Надежная доставка, включается после подтверждения сервером
+    ReliableChannel m_channel;
+    bool m_reliable;
+    QElapsedTimer m_clock;
+    QTimer *m_retransmitTimer;
 };
 
 #endif // NETWORKCLIENT_H
@@ -1,4 +1,4 @@
-QT       += core network gui
+QT       += core network gui concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -10,17 +10,28 @@ OBJECTS_DIR = build/obj
 RCC_DIR = build/rcc
 UI_DIR = build/ui
 
+INCLUDEPATH += ../common
+include(../common/gamecore.pri)
+
 # Клиентская часть
 SOURCES += \
     mainwindow.cpp \
     GameBoard.cpp \
     NetworkClient.cpp \
-    main.cpp
+    main.cpp \
+    ../common/protocol.cpp \
+    ../common/reliablechannel.cpp \
+    ../common/shotstrategy.cpp \
+    ../common/workstealingpool.cpp
 
 HEADERS += \
     MainWIndow.h \
     GameBoard.h \
-    NetworkClient.h
+    NetworkClient.h \
+    ../common/protocol.h \
+    ../common/reliablechannel.h \
+    ../common/shotstrategy.h \
+    ../common/workstealingpool.h
 
 # Имя исполняемого файла
 TARGET = seabattle_client
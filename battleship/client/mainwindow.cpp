@@ -18,13 +18,14 @@
 #include <QRadioButton>
 #include <QButtonGroup>
 #include <random>
+#include <QThread>
+#include <QtConcurrent>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent),
     m_gameActive(false),
     m_currentShipType(GameBoard::ShipSize::BATTLESHIP),
     m_isHorizontal(true),
-    m_aiFoundShip(false),
     m_isGameStarted(false),
     m_isConnected(false),
     m_networkMode(false),
@@ -46,9 +47,18 @@ MainWindow::MainWindow(QWidget *parent)
     }
     
     m_networkMode = (mode == "Играть по сети");
-    m_aiFoundShip = false;
-    m_lastAIMove = QPoint(-1, -1);
-    m_activeHits.clear();
+    if (!m_networkMode) {
+        // Обычный бот - плотность вероятности, сложный - Монте-Карло по
+        // расстановкам во всех ядрах, не дольше AI_DEADLINE_MS на ход
+        QStringList levels;
+        levels << "Обычный" << "Сложный";
+        const QString level = QInputDialog::getItem(this, "Сложность", "Выберите сложность компьютера:",
+                                                    levels, 0, false, &ok);
+        m_aiHard = ok && level == "Сложный";
+    }
+    m_ai = createAI();
+    m_aiHistory.clear();
+    connect(&m_aiWatcher, &QFutureWatcher<int>::finished, this, &MainWindow::onAIMoveReady);
 
     // Инициализируем NetworkClient только если выбран сетевой режим
     if (m_networkMode) {
@@ -85,6 +95,23 @@ MainWindow::~MainWindow()
     delete ui;
 }
 
+std::shared_ptr<ShotStrategy> MainWindow::createAI() const
+{
+    std::unique_ptr<ShotStrategy> ai;
+    if (m_aiHard) {
+        SamplingOptions options;
+        options.samples = AI_SAMPLES;
+        options.deadlineMs = AI_DEADLINE_MS;
+        options.threads = qMax(QThread::idealThreadCount(), 1);
+        ai = ShotStrategy::createMonteCarlo(options);
+    } else {
+        ai = ShotStrategy::create("density");
+    }
+    ai->seed(QRandomGenerator::global()->generate());
+    ai->newGame();
+    return std::shared_ptr<ShotStrategy>(std::move(ai));
+}
+
 void MainWindow::setupUI()
 {
     QWidget* centralWidget = new QWidget(this);
@@ -256,50 +283,17 @@ void MainWindow::onPlacementBoardCellClicked(const QPoint& position)
     if (!m_placementMode) return;
 
     // Проверяем, не превышено ли максимальное количество кораблей данного типа
-    bool canPlace = false;
-    switch (m_currentShipType) {
-        case GameBoard::ShipSize::BATTLESHIP:
-            if (m_placedShips.battleships < 1) canPlace = true;
-            break;
-        case GameBoard::ShipSize::CRUISER:
-            if (m_placedShips.cruisers < 2) canPlace = true;
-            break;
-        case GameBoard::ShipSize::DESTROYER:
-            if (m_placedShips.destroyers < 3) canPlace = true;
-            break;
-        case GameBoard::ShipSize::SUBMARINE:
-            if (m_placedShips.submarines < 4) canPlace = true;
-            break;
-    }
-    if (!canPlace) {
+    if (m_placedShips.isFull(m_currentShipType)) {
         updateStatusMessage("Достигнуто максимальное количество кораблей этого типа");
         return;
     }
 
     if (m_placementBoard->placeShip(position, m_currentShipType, m_isHorizontal)) {
         // Увеличиваем счетчик размещенных кораблей
-        switch (m_currentShipType) {
-            case GameBoard::ShipSize::BATTLESHIP:
-                m_placedShips.battleships++;
-                break;
-            case GameBoard::ShipSize::CRUISER:
-                m_placedShips.cruisers++;
-                break;
-            case GameBoard::ShipSize::DESTROYER:
-                m_placedShips.destroyers++;
-                break;
-            case GameBoard::ShipSize::SUBMARINE:
-                m_placedShips.submarines++;
-                break;
-        }
+        m_placedShips.add(m_currentShipType);
 
         // Проверяем, все ли корабли размещены
-        bool allShipsPlaced = m_placedShips.battleships == 1 &&
-                            m_placedShips.cruisers == 2 &&
-                            m_placedShips.destroyers == 3 &&
-                            m_placedShips.submarines == 4;
-
-        if (allShipsPlaced) {
+        if (m_placedShips.isComplete()) {
             m_readyButton->setEnabled(true);
             updateStatusMessage("Все корабли размещены. Нажмите 'Готово' для начала игры.");
         } else {
@@ -412,27 +406,7 @@ void MainWindow::onShipSunk(int x, int y)
         qDebug() << "[DEBUG] onShipSunk: not our turn, skip marking around sunk ship";
         return;
     }
-    QPoint position(x, y);
-    QVector<QPoint> shipCells;
-    shipCells.append(position);
-    const QVector<QPair<int, int>> directions = {
-        {-1, 0}, {1, 0}, {0, -1}, {0, 1}
-    };
-    for (const auto& dir : directions) {
-        int x = position.x() + dir.first;
-        int y = position.y() + dir.second;
-        while (x >= 0 && x < GameBoard::GRID_SIZE && y >= 0 && y < GameBoard::GRID_SIZE) {
-            auto state = m_opponentBoard->getCellState(QPoint(x, y));
-            if (state == GameBoard::CellState::SHIP || state == GameBoard::CellState::HIT || state == GameBoard::CellState::SUNK) {
-                shipCells.append(QPoint(x, y));
-                x += dir.first;
-                y += dir.second;
-            } else {
-                break;
-            }
-        }
-    }
-    m_opponentBoard->markAroundSunkShip(shipCells);
+    m_opponentBoard->markAroundSunkShip(m_opponentBoard->findShipCells(QPoint(x, y)));
     updateGameState();
 }
 
@@ -442,112 +416,54 @@ bool MainWindow::checkOpponentBoardForWin()
 }
 
 void MainWindow::opponentMove() {
+    if (m_isMyTurn || !m_isGameStarted || m_aiWatcher.isRunning()) return;
+    if (m_aiHistory.shots.count() == BitBoard::CELL_COUNT) return; // Нет доступных ходов
+
+    // Ход считается вне потока интерфейса по копии истории, стратегией
+    // в это время пользуется только он и держит ее до конца счета
+    const std::shared_ptr<ShotStrategy> ai = m_ai;
+    const ShotHistory history = m_aiHistory;
+    m_aiMoveGeneration = m_aiGeneration;
+    m_aiWatcher.setFuture(QtConcurrent::run([ai, history] { return ai->nextShot(history); }));
+}
+
+void MainWindow::onAIMoveReady() {
+    if (m_aiMoveGeneration != m_aiGeneration) {
+        // Ход сброшенной партии. Ход новой партии мог не начаться, пока
+        // этот считался
+        opponentMove();
+        return;
+    }
     if (m_isMyTurn || !m_isGameStarted) return;
 
-    QPoint move = getNextAIMove();
-    if (move == QPoint(-1, -1)) return;
-
+    const int cell = m_aiWatcher.result();
+    const QPoint move(cell % BitBoard::WIDTH, cell / BitBoard::WIDTH);
     bool hit = m_ownBoard->makeShot(move);
     m_ownBoard->setCellState(move, hit ? GameBoard::CellState::HIT : GameBoard::CellState::MISS);
 
     if (hit) {
-        // Добавляем эту клетку в активные попадания
-        m_activeHits.append(move);
-        
         if (m_ownBoard->isShipSunk(move)) {
+            m_aiHistory.record(cell, true, m_ownBoard->shipCells(move));
             m_ownBoard->markSunkShip(move);
-            
-            // Убираем все клетки потопленного корабля из активных попаданий
-            QVector<QPoint> shipCells;
-            shipCells.append(move);
-            const QVector<QPair<int, int>> directions = {
-                {-1, 0}, {1, 0}, {0, -1}, {0, 1}
-            };
-            for (const auto& dir : directions) {
-                int x = move.x() + dir.first;
-                int y = move.y() + dir.second;
-                while (x >= 0 && x < GameBoard::GRID_SIZE && y >= 0 && y < GameBoard::GRID_SIZE) {
-                    auto state = m_ownBoard->getCellState(QPoint(x, y));
-                    if (state == GameBoard::CellState::SHIP || state == GameBoard::CellState::HIT || state == GameBoard::CellState::SUNK) {
-                        shipCells.append(QPoint(x, y));
-                        x += dir.first;
-                        y += dir.second;
-                    } else {
-                        break;
-                    }
-                }
-            }
-            for (const QPoint& cell : shipCells) {
-                m_activeHits.removeAll(cell);
-            }
-            
+
             if (!m_networkMode && m_ownBoard->allShipsSunk()) {
                 QMessageBox::information(this, "Поражение", "Все ваши корабли потоплены! Вы проиграли.");
                 resetGame();
                 return;
             }
+        } else {
+            m_aiHistory.record(cell, true, CellMask());
         }
             // Продолжаем ход компьютера после попадания
             QTimer::singleShot(1000, this, &MainWindow::opponentMove);
     } else {
+        m_aiHistory.record(cell, false, CellMask());
         // После промаха ход переходит игроку
         m_isMyTurn = true;
         updateStatusMessage("Ваш ход! Выберите клетку.");
     }
 }
 
-QPoint MainWindow::getNextAIMove() {
-    // Собираем все клетки с попаданиями, которые ещё не привели к потоплению корабля
-    QVector<QPoint> activeHits;
-    for (int y = 0; y < GameBoard::GRID_SIZE; ++y) {
-        for (int x = 0; x < GameBoard::GRID_SIZE; ++x) {
-            QPoint pos(x, y);
-            if (m_ownBoard->getCellState(pos) == GameBoard::CellState::HIT && !m_ownBoard->isShipSunk(pos)) {
-                activeHits.append(pos);
-            }
-        }
-    }
-
-    // Если есть активные попадания, стреляем вокруг них
-    if (!activeHits.isEmpty()) {
-        QVector<QPoint> possibleTargets;
-        for (const QPoint& hit : activeHits) {
-            QVector<QPoint> directions = { {-1,0}, {1,0}, {0,-1}, {0,1} };
-            for (const QPoint& dir : directions) {
-                QPoint next = hit + dir;
-                if (next.x() >= 0 && next.x() < GameBoard::GRID_SIZE &&
-                    next.y() >= 0 && next.y() < GameBoard::GRID_SIZE) {
-                    auto state = m_ownBoard->getCellState(next);
-                    if (state == GameBoard::CellState::EMPTY || state == GameBoard::CellState::SHIP) {
-                        possibleTargets.append(next);
-                    }
-                }
-            }
-        }
-        if (!possibleTargets.isEmpty()) {
-            return possibleTargets[QRandomGenerator::global()->bounded(possibleTargets.size())];
-        }
-    }
-
-    // Если нет активных попаданий или подходящих целей, стреляем в случайную пустую клетку
-    QVector<QPoint> availableCells;
-    for (int y = 0; y < GameBoard::GRID_SIZE; ++y) {
-        for (int x = 0; x < GameBoard::GRID_SIZE; ++x) {
-            QPoint pos(x, y);
-            auto state = m_ownBoard->getCellState(pos);
-            if (state == GameBoard::CellState::EMPTY || state == GameBoard::CellState::SHIP) {
-                availableCells.append(pos);
-            }
-        }
-    }
-    
-    if (!availableCells.isEmpty()) {
-        return availableCells[QRandomGenerator::global()->bounded(availableCells.size())];
-    }
-    
-    return QPoint(-1, -1); // Нет доступных ходов
-}
-
 void MainWindow::onSendChatClicked() {
     QString message = m_chatInput->text().trimmed();
     if (!message.isEmpty()) {
@@ -578,9 +494,15 @@ void MainWindow::resetGame()
     m_gameActive = false;
     m_isMyTurn = false;
     m_placementMode = true;
-    m_aiFoundShip = false;
-    m_aiPossibleMoves.clear();
-    m_activeHits.clear();
+    ++m_aiGeneration;
+    m_aiHistory.clear();
+    // Считающийся ход прежней партии не ждем: он держит свою стратегию и
+    // отпустит ее сам, а новая партия получает свежую
+    if (m_aiWatcher.isRunning()) {
+        m_ai = createAI();
+    } else {
+        m_ai->newGame();
+    }
     m_placedShips = ShipCount();
     if (m_placementBoard) m_placementBoard->clear();
     if (m_ownBoard) m_ownBoard->clear();
@@ -723,57 +645,36 @@ void MainWindow::onTurnChanged(bool yourTurn)
     }
 }
 
-void MainWindow::addAdjacentCells(const QPoint& pos) {
-    const QList<QPair<int, int>> directions = {{-1,0}, {1,0}, {0,-1}, {0,1}};
-    for (const auto& dir : directions) {
-        QPoint p(pos.x() + dir.first, pos.y() + dir.second);
-        if (p.x() >= 0 && p.x() < GameBoard::GRID_SIZE && 
-            p.y() >= 0 && p.y() < GameBoard::GRID_SIZE && 
-            (m_ownBoard->getCellState(p) == GameBoard::CellState::EMPTY || 
-             m_ownBoard->getCellState(p) == GameBoard::CellState::SHIP)) {
-            if (!m_aiPossibleMoves.contains(p)) {
-                m_aiPossibleMoves.append(p);
-            }
-        }
-    }
-}
-
-bool MainWindow::checkShipSunk(const QPoint& position) {
-    return m_ownBoard->isShipSunk(position);
+int MainWindow::getCurrentShipCount() const {
+    return m_placedShips.count(m_currentShipType);
 }
 
-int MainWindow::getCurrentShipCount() const {
-    switch (m_currentShipType) {
-        case GameBoard::ShipSize::BATTLESHIP: return m_placedShips.battleships;
-        case GameBoard::ShipSize::CRUISER: return m_placedShips.cruisers;
-        case GameBoard::ShipSize::DESTROYER: return m_placedShips.destroyers;
-        case GameBoard::ShipSize::SUBMARINE: return m_placedShips.submarines;
-        default: return 0;
+void MainWindow::selectNextAvailableShipType() {
+    for (int length = BitBoard::MAX_SHIP_SIZE; length >= 1; --length) {
+        const GameBoard::ShipSize size = static_cast<GameBoard::ShipSize>(length);
+        if (!m_placedShips.isFull(size)) {
+            shipRadio(size)->setChecked(true);
+            m_currentShipType = size;
+            return;
+        }
     }
 }
 
-void MainWindow::selectNextAvailableShipType() {
-    if (m_placedShips.battleships < 1) {
-        m_battleshipRadio->setChecked(true);
-        m_currentShipType = GameBoard::ShipSize::BATTLESHIP;
-    } else if (m_placedShips.cruisers < 2) {
-        m_cruiserRadio->setChecked(true);
-        m_currentShipType = GameBoard::ShipSize::CRUISER;
-    } else if (m_placedShips.destroyers < 3) {
-        m_destroyerRadio->setChecked(true);
-        m_currentShipType = GameBoard::ShipSize::DESTROYER;
-    } else if (m_placedShips.submarines < 4) {
-        m_submarineRadio->setChecked(true);
-        m_currentShipType = GameBoard::ShipSize::SUBMARINE;
+QRadioButton *MainWindow::shipRadio(GameBoard::ShipSize size) const {
+    switch (size) {
+        case GameBoard::ShipSize::BATTLESHIP: return m_battleshipRadio;
+        case GameBoard::ShipSize::CRUISER: return m_cruiserRadio;
+        case GameBoard::ShipSize::DESTROYER: return m_destroyerRadio;
+        case GameBoard::ShipSize::SUBMARINE: return m_submarineRadio;
     }
+    return m_submarineRadio;
 }
 
 void MainWindow::onReadyClicked()
 {
     qDebug() << "[DEBUG] onReadyClicked";
     if (!m_placementMode) return;
-    if (m_placedShips.battleships != 1 || m_placedShips.cruisers != 2 ||
-        m_placedShips.destroyers != 3 || m_placedShips.submarines != 4) {
+    if (!m_placedShips.isComplete()) {
         QMessageBox::warning(this, "Ошибка", "Разместите все корабли перед началом игры!");
         return;
     }
@@ -783,14 +684,7 @@ void MainWindow::onReadyClicked()
         m_placementBoard->setEnabled(false);
         updateStatusMessage("Ожидание противника...");
     } else {
-        int attempts = 0;
-        while (!m_opponentBoard->placeRandomShips(100) && attempts++ < 100) {
-            m_opponentBoard->clear();
-        }
-        if (attempts >= 100) {
-            QMessageBox::critical(this, "Ошибка", "Не удалось разместить корабли противника");
-            return;
-        }
+        m_opponentBoard->placeRandomShips();
         m_placementMode = false;
         m_isGameStarted = true;
         m_gameActive = true;
@@ -803,49 +697,25 @@ void MainWindow::onReadyClicked()
 
 void MainWindow::updateShipSelectionUI()
 {
-    // Проверяем, достигнуто ли максимальное количество текущего типа кораблей
-    bool currentTypeMaxReached = false;
-    switch (m_currentShipType) {
-        case GameBoard::ShipSize::BATTLESHIP:
-            currentTypeMaxReached = (m_placedShips.battleships >= 1);
-            break;
-        case GameBoard::ShipSize::CRUISER:
-            currentTypeMaxReached = (m_placedShips.cruisers >= 2);
-            break;
-        case GameBoard::ShipSize::DESTROYER:
-            currentTypeMaxReached = (m_placedShips.destroyers >= 3);
-            break;
-        case GameBoard::ShipSize::SUBMARINE:
-            currentTypeMaxReached = (m_placedShips.submarines >= 4);
-            break;
-    }
-    
     // Если текущий тип достиг максимума, выбираем следующий доступный
-    if (currentTypeMaxReached) {
-        if (m_placedShips.battleships < 1) {
-            m_battleshipRadio->setChecked(true);
-        } else if (m_placedShips.cruisers < 2) {
-            m_cruiserRadio->setChecked(true);
-        } else if (m_placedShips.destroyers < 3) {
-            m_destroyerRadio->setChecked(true);
-        } else if (m_placedShips.submarines < 4) {
-            m_submarineRadio->setChecked(true);
+    if (m_placedShips.isFull(m_currentShipType)) {
+        for (int length = BitBoard::MAX_SHIP_SIZE; length >= 1; --length) {
+            const GameBoard::ShipSize size = static_cast<GameBoard::ShipSize>(length);
+            if (!m_placedShips.isFull(size)) {
+                shipRadio(size)->setChecked(true);
+                break;
+            }
         }
     }
     
     // Отключаем радиокнопки для типов кораблей, достигших максимума
-    m_battleshipRadio->setEnabled(m_placedShips.battleships < 1);
-    m_cruiserRadio->setEnabled(m_placedShips.cruisers < 2);
-    m_destroyerRadio->setEnabled(m_placedShips.destroyers < 3);
-    m_submarineRadio->setEnabled(m_placedShips.submarines < 4);
+    for (int length = 1; length <= BitBoard::MAX_SHIP_SIZE; ++length) {
+        const GameBoard::ShipSize size = static_cast<GameBoard::ShipSize>(length);
+        shipRadio(size)->setEnabled(!m_placedShips.isFull(size));
+    }
     
     // Активируем кнопку "Готово" только если все корабли размещены
-    m_readyButton->setEnabled(
-        m_placedShips.battleships == 1 && 
-        m_placedShips.cruisers == 2 &&
-        m_placedShips.destroyers == 3 &&
-        m_placedShips.submarines == 4
-    );
+    m_readyButton->setEnabled(m_placedShips.isComplete());
 }
 
 void MainWindow::onGameStartConfirmed()
@@ -0,0 +1,137 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include "fleetindex.h"
+
+// Поле игрока: палубы, попадания и промахи масками. Правила расстановки и
+// выстрела для клиента, сервера и ботов - здесь, без Qt и без выделений
+// памяти; подключается через gamecore.pri. Размер поля и флот задает вариант
+// Rules (boardrules.h), BitBoard - классическое поле 10x10.
+template <typename Rules>
+class BasicBitBoard {
+public:
+    using Mask = typename Rules::Mask;
+    using Fleet = typename Rules::Fleet;
+    using Index = BasicFleetIndex<Rules>;
+
+    static constexpr int WIDTH = Rules::WIDTH;
+    static constexpr int HEIGHT = Rules::HEIGHT;
+    static constexpr int CELL_COUNT = Rules::CELL_COUNT;
+    static constexpr int MAX_SHIP_SIZE = Fleet::MAX_LENGTH;
+
+    // Значения клеток в том же виде, что и в JSON-протоколе
+    enum Cell { EMPTY = 0, SHIP = 1, HIT = 2, MISS = 3 };
+
+    static constexpr int index(int x, int y) { return y * WIDTH + x; }
+    static constexpr bool inBounds(int x, int y) {
+        return x >= 0 && x < WIDTH && y >= 0 && y < HEIGHT;
+    }
+
+    void clear() { m_ships = m_hits = m_misses = Mask(); }
+    bool isEmpty() const { return m_ships.none(); }
+
+    void setShip(int x, int y) { m_ships.set(index(x, y)); }
+    void setShips(const Mask &ships) { m_ships = ships; }
+    // Поле посреди партии, например из журнала сервера
+    void restore(const Mask &ships, const Mask &hits, const Mask &misses) {
+        m_ships = ships;
+        m_hits = hits;
+        m_misses = misses;
+    }
+    bool hasShip(int x, int y) const { return m_ships.test(index(x, y)); }
+    bool isHit(int x, int y) const { return m_hits.test(index(x, y)); }
+
+    Cell cell(int x, int y) const {
+        const int i = index(x, y);
+        if (m_hits.test(i)) return HIT;
+        if (m_misses.test(i)) return MISS;
+        return m_ships.test(i) ? SHIP : EMPTY;
+    }
+
+    const Mask &ships() const { return m_ships; }
+    const Mask &hits() const { return m_hits; }
+    const Mask &misses() const { return m_misses; }
+
+    // Выстрел по клетке. Попаданием считается только первый выстрел по целой
+    // палубе, повторный выстрел по подбитой клетке засчитывается как промах.
+    bool shoot(int x, int y) {
+        const int i = index(x, y);
+        if (m_ships.test(i) && !m_hits.test(i)) {
+            m_hits.set(i);
+            return true;
+        }
+        m_misses.set(i);
+        return false;
+    }
+
+    bool allShipsSunk() const { return (m_ships & ~m_hits).none(); }
+
+    // Проверка расстановки: ровно флот варианта (для классики 1x4, 2x3, 3x2,
+    // 4x1), корабли прямые и не касаются друг друга даже углами
+    bool isValidFleet() const {
+        int counts[MAX_SHIP_SIZE + 1] = {0};
+        const bool straight = Index::forEachShip(m_ships, [&counts](int, int, int length) {
+            ++counts[length];
+            return true;
+        });
+        return straight && Index::isFullFleet(counts);
+    }
+
+    // Палубы прямого корабля с носом (верхней или левой палубой) в (x, y);
+    // пустая маска - корабль не помещается на поле
+    static Mask shipMask(int x, int y, int length, bool horizontal) {
+        Mask ship;
+        const int endX = horizontal ? x + length - 1 : x;
+        const int endY = horizontal ? y : y + length - 1;
+        if (length < 1 || !inBounds(x, y) || !inBounds(endX, endY)) return ship;
+        const int step = horizontal ? 1 : WIDTH;
+        for (int i = 0, c = index(x, y); i < length; ++i, c += step) ship.set(c);
+        return ship;
+    }
+
+    // Корабль помещается на поле и не касается уже стоящих даже углом
+    bool canPlaceShip(int x, int y, int length, bool horizontal) const {
+        if (length > MAX_SHIP_SIZE) return false;
+        const Mask ship = shipMask(x, y, length, horizontal);
+        if (ship.none()) return false;
+        const Mask &halo = SHIP_HALOS<Rules>.masks[index(x, y)][length - 1][horizontal ? 0 : 1];
+        return ((ship | halo) & m_ships).none();
+    }
+
+    // Случайная расстановка флота варианта. Rng - любой генератор с
+    // operator(), возвращающим беззнаковое целое (std::mt19937 и т.п.)
+    template <typename Rng>
+    static BasicBitBoard randomFleet(Rng &rng) {
+        for (;;) {
+            BasicBitBoard board;
+            Mask blocked;   // палубы и их соседи, включая диагональных
+            bool placed = true;
+            for (int size : Fleet::LENGTHS.values) {
+                placed = false;
+                for (int attempt = 0; attempt < 100 && !placed; ++attempt) {
+                    const bool horizontal = rng() & 1;
+                    const int x = int(rng() % unsigned(horizontal ? WIDTH - size + 1 : WIDTH));
+                    const int y = int(rng() % unsigned(horizontal ? HEIGHT : HEIGHT - size + 1));
+                    const Mask ship = shipMask(x, y, size, horizontal);
+                    if ((ship & blocked).any()) continue;
+
+                    placed = true;
+                    board.m_ships |= ship;
+                    blocked |= ship | SHIP_HALOS<Rules>.masks[index(x, y)][size - 1][horizontal ? 0 : 1];
+                }
+                if (!placed) break;
+            }
+            // Тупиковая расстановка встречается редко - начинаем заново
+            if (placed) return board;
+        }
+    }
+
+private:
+    Mask m_ships;
+    Mask m_hits;
+    Mask m_misses;
+};
+
+using BitBoard = BasicBitBoard<ClassicRules>;
+
+#endif // BITBOARD_H
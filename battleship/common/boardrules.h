@@ -0,0 +1,77 @@
+#ifndef BOARDRULES_H
+#define BOARDRULES_H
+
+#include "cellmask.h"
+
+// Состав флота: Counts - число кораблей длины 1, 2, 3 и так далее.
+// FleetSpec<4, 3, 2, 1> - классические 4 однопалубных, 3 двухпалубных,
+// 2 трехпалубных и 1 четырехпалубный.
+template <int... Counts>
+struct FleetSpec {
+    static constexpr int MAX_LENGTH = int(sizeof...(Counts));
+    static constexpr int SHIPS = (0 + ... + Counts);
+    // Число кораблей по длине, COUNT[0] не используется
+    static constexpr int COUNT[MAX_LENGTH + 1] = {0, Counts...};
+
+    // Длины всех кораблей от длинных к коротким - в этом порядке их
+    // удобнее всего расставлять
+    struct Lengths {
+        int values[SHIPS] = {};
+        constexpr Lengths() {
+            int n = 0;
+            for (int length = MAX_LENGTH; length >= 1; --length) {
+                for (int i = 0; i < COUNT[length]; ++i) values[n++] = length;
+            }
+        }
+    };
+    static constexpr Lengths LENGTHS{};
+};
+
+// Вариант игры: размер поля и флот. Все правила ядра (BasicBitBoard,
+// BasicFleetIndex) - шаблоны от варианта, так что размеры и число кораблей
+// известны при компиляции каждого из них.
+template <int W, int H, typename F>
+struct BoardRules {
+    static constexpr int WIDTH = W;
+    static constexpr int HEIGHT = H;
+    static constexpr int CELL_COUNT = W * H;
+    using Fleet = F;
+    using Mask = BasicCellMask<W, H>;
+
+    static_assert(F::MAX_LENGTH <= W && F::MAX_LENGTH <= H, "longest ship does not fit the board");
+};
+
+// Классика: 10x10, 1x4, 2x3, 3x2, 4x1
+using ClassicRules = BoardRules<10, 10, FleetSpec<4, 3, 2, 1>>;
+
+// Ореолы всех прямых кораблей поля по клетке носа (верхней или левой), длине
+// и направлению. Таблица считается при компиляции для каждого варианта,
+// ядро берет из нее ореол корабля вместо восьми сдвигов маски.
+template <typename Rules>
+struct ShipHalos {
+    static constexpr int MAX_LENGTH = Rules::Fleet::MAX_LENGTH;
+    using Mask = typename Rules::Mask;
+
+    Mask masks[Rules::CELL_COUNT][MAX_LENGTH][2];   // [нос][длина - 1][вертикальный]
+
+    constexpr ShipHalos() : masks() {
+        for (int cell = 0; cell < Rules::CELL_COUNT; ++cell) {
+            for (int length = 1; length <= MAX_LENGTH; ++length) {
+                for (int vertical = 0; vertical < 2; ++vertical) {
+                    if (vertical ? cell / Rules::WIDTH + length > Rules::HEIGHT
+                                 : cell % Rules::WIDTH + length > Rules::WIDTH) {
+                        continue;
+                    }
+                    Mask ship;
+                    for (int i = 0; i < length; ++i) ship.set(cell + i * (vertical ? Rules::WIDTH : 1));
+                    masks[cell][length - 1][vertical] = surroundingCells(ship) & ~ship;
+                }
+            }
+        }
+    }
+};
+
+template <typename Rules>
+inline constexpr ShipHalos<Rules> SHIP_HALOS{};
+
+#endif // BOARDRULES_H
@@ -0,0 +1,154 @@
+#ifndef CELLMASK_H
+#define CELLMASK_H
+
+#include <cstdint>
+
+// Битовая маска клеток поля W x H. Клетка (x, y) хранится в бите y * W + x:
+// биты 0..63 лежат в words[0], 64..127 - в words[1] и так далее, лишние
+// старшие биты последнего слова всегда нулевые. Число слов известно при
+// компиляции, поэтому циклы по словам разворачиваются, и поле 10x10 остается
+// парой 64-битных регистров.
+template <int W, int H>
+struct BasicCellMask {
+    static constexpr int WIDTH = W;
+    static constexpr int HEIGHT = H;
+    static constexpr int BITS = W * H;
+    static constexpr int WORDS = (BITS + 63) / 64;
+    // Значащие биты последнего слова
+    static constexpr uint64_t LAST_WORD_MASK = BITS % 64 ? (uint64_t(1) << (BITS % 64)) - 1 : ~uint64_t(0);
+
+    uint64_t words[WORDS] = {};
+
+    constexpr bool test(int i) const { return (words[i >> 6] >> (i & 63)) & 1u; }
+    constexpr void set(int i) { words[i >> 6] |= uint64_t(1) << (i & 63); }
+    constexpr void reset(int i) { words[i >> 6] &= ~(uint64_t(1) << (i & 63)); }
+    constexpr bool any() const {
+        uint64_t bits = 0;
+        for (int w = 0; w < WORDS; ++w) bits |= words[w];
+        return bits != 0;
+    }
+    constexpr bool none() const { return !any(); }
+    int count() const {
+        int n = 0;
+        for (int w = 0; w < WORDS; ++w) n += __builtin_popcountll(words[w]);
+        return n;
+    }
+    // Индекс младшего установленного бита, маска не должна быть пустой
+    int lowest() const {
+        int w = 0;
+        while (w < WORDS - 1 && !words[w]) ++w;
+        return w * 64 + __builtin_ctzll(words[w]);
+    }
+    // Индекс k-го по счету установленного бита, 0 <= k < count()
+    int nth(int k) const {
+        int w = 0;
+        for (int c; w < WORDS - 1 && k >= (c = __builtin_popcountll(words[w])); ++w) k -= c;
+        uint64_t bits = words[w];
+        int base = w * 64;
+        // Сначала целые байты, затем биты внутри байта
+        for (int c; k >= (c = __builtin_popcountll(bits & 0xFF)); k -= c) {
+            bits >>= 8;
+            base += 8;
+        }
+        while (k-- > 0) bits &= bits - 1;
+        return base + __builtin_ctzll(bits);
+    }
+
+    constexpr BasicCellMask operator&(const BasicCellMask &o) const {
+        BasicCellMask r;
+        for (int w = 0; w < WORDS; ++w) r.words[w] = words[w] & o.words[w];
+        return r;
+    }
+    constexpr BasicCellMask operator|(const BasicCellMask &o) const {
+        BasicCellMask r;
+        for (int w = 0; w < WORDS; ++w) r.words[w] = words[w] | o.words[w];
+        return r;
+    }
+    constexpr BasicCellMask operator^(const BasicCellMask &o) const {
+        BasicCellMask r;
+        for (int w = 0; w < WORDS; ++w) r.words[w] = words[w] ^ o.words[w];
+        return r;
+    }
+    constexpr BasicCellMask operator~() const {
+        BasicCellMask r;
+        for (int w = 0; w < WORDS; ++w) r.words[w] = ~words[w];
+        r.words[WORDS - 1] &= LAST_WORD_MASK;
+        return r;
+    }
+    constexpr BasicCellMask &operator&=(const BasicCellMask &o) { return *this = *this & o; }
+    constexpr BasicCellMask &operator|=(const BasicCellMask &o) { return *this = *this | o; }
+    constexpr bool operator==(const BasicCellMask &o) const {
+        uint64_t diff = 0;
+        for (int w = 0; w < WORDS; ++w) diff |= words[w] ^ o.words[w];
+        return diff == 0;
+    }
+    constexpr bool operator!=(const BasicCellMask &o) const { return !(*this == o); }
+
+    // Сдвиг в сторону старших клеток (вниз/вправо по полю), 0 < n < 64
+    constexpr BasicCellMask shl(int n) const {
+        BasicCellMask r;
+        for (int w = WORDS - 1; w > 0; --w) r.words[w] = (words[w] << n) | (words[w - 1] >> (64 - n));
+        r.words[0] = words[0] << n;
+        r.words[WORDS - 1] &= LAST_WORD_MASK;
+        return r;
+    }
+    // Сдвиг в сторону младших клеток (вверх/влево по полю), 0 < n < 64
+    constexpr BasicCellMask shr(int n) const {
+        BasicCellMask r;
+        for (int w = 0; w < WORDS - 1; ++w) r.words[w] = (words[w] >> n) | (words[w + 1] << (64 - n));
+        r.words[WORDS - 1] = words[WORDS - 1] >> n;
+        return r;
+    }
+
+    // Маска одного столбца поля
+    static constexpr BasicCellMask column(int x) {
+        BasicCellMask m;
+        for (int y = 0; y < H; ++y) m.set(y * W + x);
+        return m;
+    }
+};
+
+// Классическое поле 10x10
+using CellMask = BasicCellMask<10, 10>;
+
+// Клетки без первого и без последнего столбца: сдвиг на клетку влево или
+// вправо не должен переносить клетку на соседнюю строку. Считаются при
+// компиляции для каждого размера поля.
+template <int W, int H>
+inline constexpr BasicCellMask<W, H> NOT_FIRST_COLUMN = ~BasicCellMask<W, H>::column(0);
+template <int W, int H>
+inline constexpr BasicCellMask<W, H> NOT_LAST_COLUMN = ~BasicCellMask<W, H>::column(W - 1);
+
+// Клетки, соседние с клетками маски по стороне
+template <int W, int H>
+constexpr BasicCellMask<W, H> adjacentCells(const BasicCellMask<W, H> &m) {
+    return (m & NOT_LAST_COLUMN<W, H>).shl(1) | (m & NOT_FIRST_COLUMN<W, H>).shr(1) | m.shl(W) | m.shr(W);
+}
+
+// Клетки, соседние с клетками маски по диагонали
+template <int W, int H>
+constexpr BasicCellMask<W, H> diagonalCells(const BasicCellMask<W, H> &m) {
+    const BasicCellMask<W, H> notFirst = m & NOT_FIRST_COLUMN<W, H>;
+    const BasicCellMask<W, H> notLast = m & NOT_LAST_COLUMN<W, H>;
+    return notLast.shl(W + 1) | notFirst.shl(W - 1) | notFirst.shr(W + 1) | notLast.shr(W - 1);
+}
+
+// Все восемь соседей: ореол корабля, где не может стоять другой корабль
+template <int W, int H>
+constexpr BasicCellMask<W, H> surroundingCells(const BasicCellMask<W, H> &m) {
+    return adjacentCells(m) | diagonalCells(m);
+}
+
+// Клетки m, связанные по сторонам с клетками from. Для корабля - его палубы
+// за длину корабля шагов, без обхода по направлениям
+template <int W, int H>
+constexpr BasicCellMask<W, H> connectedCells(const BasicCellMask<W, H> &m, const BasicCellMask<W, H> &from) {
+    BasicCellMask<W, H> area = from & m;
+    for (;;) {
+        const BasicCellMask<W, H> grown = (area | adjacentCells(area)) & m;
+        if (grown == area) return area;
+        area = grown;
+    }
+}
+
+#endif // CELLMASK_H
@@ -0,0 +1,125 @@
+#ifndef FLEETINDEX_H
+#define FLEETINDEX_H
+
+#include "boardrules.h"
+
+// Индекс кораблей расстановки: номер корабля каждой клетки, палубы и ореол
+// каждого корабля, число его целых палуб и число непотопленных кораблей.
+// Строится один раз при проверке расстановки, после чего потопление и конец
+// партии - уменьшение счетчика и сравнение с нулем вместо обхода поля.
+template <typename Rules>
+class BasicFleetIndex {
+public:
+    using Mask = typename Rules::Mask;
+    using Fleet = typename Rules::Fleet;
+
+    static constexpr int MAX_SHIPS = Fleet::SHIPS;
+    static constexpr int MAX_SHIP_SIZE = Fleet::MAX_LENGTH;
+    static constexpr int NO_SHIP = -1;
+
+    BasicFleetIndex() { clear(); }
+
+    void clear() {
+        for (int i = 0; i < Rules::CELL_COUNT; ++i) m_shipOf[i] = NO_SHIP;
+        m_shipCount = 0;
+        m_shipsLeft = 0;
+    }
+
+    // Разбирает палубы на прямые корабли и отдает каждый в onShip(нос, шаг,
+    // длина), шаг 1 - горизонтальный корабль, WIDTH - вертикальный. onShip
+    // возвращает false, чтобы прервать разбор. false - палубы касаются друг
+    // друга или стоят не в линию, корабль длиннее MAX_SHIP_SIZE или разбор
+    // прерван
+    template <typename OnShip>
+    static bool forEachShip(const Mask &ships, OnShip &&onShip) {
+        constexpr int W = Rules::WIDTH;
+        // Соседство по диагонали: вниз-вправо (+W+1) и вниз-влево (+W-1). Без
+        // него каждая связная группа палуб - прямая линия, не касающаяся
+        // других ни стороной, ни углом
+        if (((ships & NOT_LAST_COLUMN<W, Rules::HEIGHT>).shl(W + 1) & ships).any()) return false;
+        if (((ships & NOT_FIRST_COLUMN<W, Rules::HEIGHT>).shl(W - 1) & ships).any()) return false;
+
+        Mask rest = ships;
+        while (rest.any()) {
+            const int start = rest.lowest();
+            const int step = (start % W < W - 1 && rest.test(start + 1)) ? 1 : W;
+            int length = 0;
+            for (int i = start; i < Rules::CELL_COUNT && rest.test(i); i += step) {
+                if (step == 1 && i != start && i % W == 0) break;
+                rest.reset(i);
+                ++length;
+            }
+            if (length > MAX_SHIP_SIZE || !onShip(start, step, length)) return false;
+        }
+        return true;
+    }
+
+    // Строит индекс, уже подбитые палубы (hits) учитываются. false - палубы
+    // не складываются в корабли (см. forEachShip) или кораблей больше MAX_SHIPS
+    bool build(const Mask &ships, const Mask &hits = Mask()) {
+        clear();
+        return forEachShip(ships, [this, &hits](int start, int step, int length) {
+            if (m_shipCount == MAX_SHIPS) return false;
+            const int id = m_shipCount++;
+            Mask ship;
+            int hitPoints = 0;
+            for (int n = 0, i = start; n < length; ++n, i += step) {
+                ship.set(i);
+                m_shipOf[i] = int8_t(id);
+                if (!hits.test(i)) ++hitPoints;
+            }
+            m_cells[id] = ship;
+            m_halos[id] = SHIP_HALOS<Rules>.masks[start][length - 1][step == 1 ? 0 : 1];
+            m_lengths[id] = uint8_t(length);
+            m_hitPoints[id] = uint8_t(hitPoints);
+            if (hitPoints != 0) ++m_shipsLeft;
+            return true;
+        });
+    }
+
+    // Набор кораблей совпадает с флотом варианта (Fleet::COUNT)
+    bool isFullFleet() const {
+        int counts[MAX_SHIP_SIZE + 1] = {0};
+        for (int id = 0; id < m_shipCount; ++id) ++counts[m_lengths[id]];
+        return isFullFleet(counts);
+    }
+
+    static bool isFullFleet(const int (&counts)[MAX_SHIP_SIZE + 1]) {
+        for (int length = 1; length <= MAX_SHIP_SIZE; ++length) {
+            if (counts[length] != Fleet::COUNT[length]) return false;
+        }
+        return true;
+    }
+
+    int shipCount() const { return m_shipCount; }
+    int shipsLeft() const { return m_shipsLeft; }
+    // Номер корабля в клетке или NO_SHIP
+    int shipAt(int cell) const { return m_shipOf[cell]; }
+    const Mask &shipCells(int ship) const { return m_cells[ship]; }
+    // Соседние с кораблем клетки, включая диагональные
+    const Mask &halo(int ship) const { return m_halos[ship]; }
+    int shipLength(int ship) const { return m_lengths[ship]; }
+    bool isSunk(int ship) const { return m_hitPoints[ship] == 0; }
+
+    // Попадание в целую палубу cell. true - корабль потоплен этим выстрелом
+    bool hit(int cell) {
+        const int ship = m_shipOf[cell];
+        if (ship == NO_SHIP || m_hitPoints[ship] == 0) return false;
+        if (--m_hitPoints[ship] != 0) return false;
+        --m_shipsLeft;
+        return true;
+    }
+
+private:
+    int8_t m_shipOf[Rules::CELL_COUNT];
+    uint8_t m_hitPoints[MAX_SHIPS];
+    uint8_t m_lengths[MAX_SHIPS];
+    Mask m_cells[MAX_SHIPS];
+    Mask m_halos[MAX_SHIPS];
+    int m_shipCount;
+    int m_shipsLeft;
+};
+
+using FleetIndex = BasicFleetIndex<ClassicRules>;
+
+#endif // FLEETINDEX_H
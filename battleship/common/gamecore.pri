@@ -0,0 +1,12 @@
+# Игровое ядро: поле, индекс кораблей и правила расстановки и выстрела.
+# Только заголовки, без Qt и без выделений памяти - одни и те же правила
+# у клиента, сервера, ботов и инструментов. Подключение:
+#     include(../common/gamecore.pri)
+
+INCLUDEPATH += $$PWD
+
+HEADERS += \
+    $$PWD/cellmask.h \
+    $$PWD/boardrules.h \
+    $$PWD/fleetindex.h \
+    $$PWD/bitboard.h
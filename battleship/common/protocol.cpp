@@ -0,0 +1,656 @@
+#include "protocol.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QtEndian>
+
+namespace Protocol {
+
+namespace {
+
+const struct {
+    MessageType type;
+    const char *name;
+} kTypeNames[] = {
+    {MessageType::Login, "login"},
+    {MessageType::LoginResponse, "login_response"},
+    {MessageType::Board, "board"},
+    {MessageType::Ready, "ready"},
+    {MessageType::Shot, "shot"},
+    {MessageType::ShotResult, "shot_result"},
+    {MessageType::ShotReceived, "shot_received"},
+    {MessageType::ShipSunk, "ship_sunk"},
+    {MessageType::TurnChange, "turn_change"},
+    {MessageType::GameStart, "game_start"},
+    {MessageType::GameOver, "game_over"},
+    {MessageType::ChatMessage, "chat_message"},
+    {MessageType::Ping, "ping"},
+    {MessageType::Pong, "pong"},
+    {MessageType::LobbyCreated, "lobby_created"},
+    {MessageType::LobbyTimeout, "lobby_timeout"},
+    {MessageType::Error, "error"},
+    {MessageType::Reconnect, "reconnect"},
+    {MessageType::ReconnectResponse, "reconnect_response"},
+    {MessageType::CreateGame, "create_game"},
+    {MessageType::JoinGame, "join_game"},
+    {MessageType::GameFound, "game_found"},
+    {MessageType::WaitingForOpponent, "waiting_for_opponent"},
+    {MessageType::Stats, "stats"},
+    {MessageType::Bundle, "bundle"},
+    {MessageType::Spectate, "spectate"},
+    {MessageType::SpectateState, "spectate_state"},
+    {MessageType::SpectateEvent, "spectate_event"}
+};
+
+constexpr int HEADER_SIZE = 3;
+
+class Writer {
+public:
+    explicit Writer(MessageType type, int payloadHint = 0) {
+        m_data.reserve(HEADER_SIZE + payloadHint);
+        u8(MAGIC);
+        u8(VERSION);
+        u8(static_cast<quint8>(type));
+    }
+
+    void u8(quint8 v) { m_data.append(static_cast<char>(v)); }
+    void u64(quint64 v) {
+        char buf[sizeof(v)];
+        qToLittleEndian(v, buf);
+        m_data.append(buf, sizeof(buf));
+    }
+    void str(const QString &s) {
+        const QByteArray utf8 = s.toUtf8();
+        const quint16 len = static_cast<quint16>(qMin(utf8.size(), 0xFFFF));
+        char buf[sizeof(len)];
+        qToLittleEndian(len, buf);
+        m_data.append(buf, sizeof(buf));
+        m_data.append(utf8.constData(), len);
+    }
+    // Поле целиком: корабли, попадания и промахи
+    void board(const BitBoard &b) {
+        for (const CellMask *mask : {&b.ships(), &b.hits(), &b.misses()}) {
+            for (quint64 word : mask->words) u64(word);
+        }
+    }
+    void bytes(const QByteArray &b) {
+        const quint16 len = static_cast<quint16>(qMin(b.size(), 0xFFFF));
+        char buf[sizeof(len)];
+        qToLittleEndian(len, buf);
+        m_data.append(buf, sizeof(buf));
+        m_data.append(b.constData(), len);
+    }
+
+    QByteArray take() { return m_data; }
+
+private:
+    QByteArray m_data;
+};
+
+class Reader {
+public:
+    explicit Reader(const QByteArray &data) : m_data(data.constData()), m_size(data.size()) {}
+
+    bool u8(quint8 &v) {
+        if (m_pos + 1 > m_size) return false;
+        v = static_cast<quint8>(m_data[m_pos++]);
+        return true;
+    }
+    bool flag(bool &v) {
+        quint8 b;
+        if (!u8(b)) return false;
+        v = b != 0;
+        return true;
+    }
+    bool coord(int &v) {
+        quint8 b;
+        if (!u8(b)) return false;
+        v = b;
+        return true;
+    }
+    bool u64(quint64 &v) {
+        if (m_pos + int(sizeof(v)) > m_size) return false;
+        v = qFromLittleEndian<quint64>(m_data + m_pos);
+        m_pos += sizeof(v);
+        return true;
+    }
+    // Необязательный флаг в конце сообщения, которого нет у старых версий
+    bool optionalFlag(bool &v) {
+        if (m_pos >= m_size) {
+            v = false;
+            return true;
+        }
+        return flag(v);
+    }
+    bool str(QString &s) {
+        if (m_pos + 2 > m_size) return false;
+        const quint16 len = qFromLittleEndian<quint16>(m_data + m_pos);
+        m_pos += 2;
+        if (m_pos + len > m_size) return false;
+        s = QString::fromUtf8(m_data + m_pos, len);
+        m_pos += len;
+        return true;
+    }
+    bool board(BitBoard &b) {
+        CellMask masks[3];
+        for (CellMask &mask : masks) {
+            for (uint64_t &word : mask.words) {
+                quint64 v;
+                if (!u64(v)) return false;
+                word = v;
+            }
+            if (mask.words[CellMask::WORDS - 1] & ~CellMask::LAST_WORD_MASK) return false;
+        }
+        b.restore(masks[0], masks[1], masks[2]);
+        return true;
+    }
+    bool bytes(QByteArray &b) {
+        if (m_pos + 2 > m_size) return false;
+        const quint16 len = qFromLittleEndian<quint16>(m_data + m_pos);
+        m_pos += 2;
+        if (m_pos + len > m_size) return false;
+        b = QByteArray(m_data + m_pos, len);
+        m_pos += len;
+        return true;
+    }
+
+private:
+    const char *m_data;
+    int m_size;
+    int m_pos = 0;
+};
+
+bool boardFromJson(const QJsonValue &value, BitBoard &board) {
+    board.clear();
+    const QJsonArray rows = value.toArray();
+    if (rows.size() != BitBoard::HEIGHT) return false;
+
+    for (int y = 0; y < BitBoard::HEIGHT; ++y) {
+        const QJsonArray row = rows[y].toArray();
+        if (row.size() != BitBoard::WIDTH) return false;
+
+        for (int x = 0; x < BitBoard::WIDTH; ++x) {
+            const int cell = row[x].toInt();
+            if (cell == BitBoard::SHIP) {
+                board.setShip(x, y);
+            } else if (cell != BitBoard::EMPTY) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Поле зрителя: клетки 0-3 (BitBoard::Cell)
+bool boardStateFromJson(const QJsonValue &value, BitBoard &board) {
+    CellMask ships, hits, misses;
+    const QJsonArray rows = value.toArray();
+    if (rows.size() != BitBoard::HEIGHT) return false;
+
+    for (int y = 0; y < BitBoard::HEIGHT; ++y) {
+        const QJsonArray row = rows[y].toArray();
+        if (row.size() != BitBoard::WIDTH) return false;
+
+        for (int x = 0; x < BitBoard::WIDTH; ++x) {
+            const int i = BitBoard::index(x, y);
+            switch (row[x].toInt()) {
+            case BitBoard::EMPTY: break;
+            case BitBoard::SHIP: ships.set(i); break;
+            case BitBoard::HIT: ships.set(i); hits.set(i); break;
+            case BitBoard::MISS: misses.set(i); break;
+            default: return false;
+            }
+        }
+    }
+    board.restore(ships, hits, misses);
+    return true;
+}
+
+QJsonArray boardStateToJson(const BitBoard &board) {
+    QJsonArray rows;
+    for (int y = 0; y < BitBoard::HEIGHT; ++y) {
+        QJsonArray row;
+        for (int x = 0; x < BitBoard::WIDTH; ++x) {
+            row.append(board.cell(x, y));
+        }
+        rows.append(row);
+    }
+    return rows;
+}
+
+QJsonArray boardToJson(const BitBoard &board) {
+    QJsonArray rows;
+    for (int y = 0; y < BitBoard::HEIGHT; ++y) {
+        QJsonArray row;
+        for (int x = 0; x < BitBoard::WIDTH; ++x) {
+            row.append(board.hasShip(x, y) ? BitBoard::SHIP : BitBoard::EMPTY);
+        }
+        rows.append(row);
+    }
+    return rows;
+}
+
+// Пачка в JSON собирается из уже закодированных частей как есть: каждая
+// часть - компактный JSON-объект, закодированный для того же получателя,
+// так что разбирать и кодировать ее заново незачем
+QByteArray jsonBundle(const QVector<QByteArray> &parts) {
+    int size = 32;
+    for (const QByteArray &part : parts) size += part.size() + 1;
+    QByteArray json;
+    json.reserve(size);
+    json += "{\"messages\":[";
+    for (int i = 0; i < parts.size(); ++i) {
+        if (i > 0) json += ',';
+        json += parts[i];
+    }
+    json += "],\"type\":\"";
+    json += typeName(MessageType::Bundle).toLatin1();
+    json += "\"}";
+    return json;
+}
+
+} // namespace
+
+QString typeName(MessageType type) {
+    for (const auto &entry : kTypeNames) {
+        if (entry.type == type) return QString::fromLatin1(entry.name);
+    }
+    return QString();
+}
+
+MessageType typeFromName(const QString &name) {
+    for (const auto &entry : kTypeNames) {
+        if (name == QLatin1String(entry.name)) return entry.type;
+    }
+    return MessageType::Unknown;
+}
+
+bool requiresDelivery(MessageType type) {
+    switch (type) {
+    case MessageType::Ping:
+    case MessageType::Pong:
+    case MessageType::ChatMessage:
+    case MessageType::Stats:
+    case MessageType::Login:
+    case MessageType::Unknown:
+        return false;
+    default:
+        return true;
+    }
+}
+
+int stateClass(MessageType type) {
+    switch (type) {
+    case MessageType::TurnChange:
+    case MessageType::GameStart:
+        return TurnState;
+    default:
+        return NoState;
+    }
+}
+
+bool decode(const QByteArray &data, Message &msg, WireFormat *format) {
+    if (!data.isEmpty() && static_cast<quint8>(data.at(0)) == MAGIC) {
+        if (format) *format = WireFormat::Binary;
+        return decodeBinary(data, msg);
+    }
+
+    if (format) *format = WireFormat::Json;
+    QJsonParseError error;
+    const QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+    if (error.error != QJsonParseError::NoError || !doc.isObject()) {
+        return false;
+    }
+    return fromJson(doc.object(), msg);
+}
+
+QByteArray encode(const Message &msg, WireFormat format) {
+    if (format == WireFormat::Binary) {
+        return encodeBinary(msg);
+    }
+    if (msg.type == MessageType::Bundle) {
+        return jsonBundle(msg.parts);
+    }
+    return QJsonDocument(toJson(msg)).toJson(QJsonDocument::Compact);
+}
+
+int bundleOverhead(WireFormat format) {
+    // [MAGIC][VERSION][тип][число частей] или обертка jsonBundle()
+    if (format == WireFormat::Binary) return 4;
+    return int(sizeof("{\"messages\":[],\"type\":\"\"}") - 1) + typeName(MessageType::Bundle).size();
+}
+
+int bundlePartOverhead(WireFormat format) {
+    // u16 длины части или запятая между частями
+    return format == WireFormat::Binary ? 2 : 1;
+}
+
+bool decodeBinary(const QByteArray &data, Message &msg) {
+    Reader in(data);
+    quint8 magic, version, type;
+    if (!in.u8(magic) || !in.u8(version) || !in.u8(type)) return false;
+    if (magic != MAGIC || version == 0 || version > VERSION) return false;
+
+    msg = Message();
+    msg.type = static_cast<MessageType>(type);
+
+    switch (msg.type) {
+    case MessageType::Login:
+        return in.u8(msg.protocolVersion) && in.str(msg.username)
+            && in.optionalFlag(msg.reliable) && in.optionalFlag(msg.bundles);
+    case MessageType::LoginResponse:
+        return in.flag(msg.success) && in.u8(msg.protocolVersion)
+            && in.optionalFlag(msg.reliable) && in.optionalFlag(msg.bundles);
+    case MessageType::Board: {
+        CellMask ships;
+        for (uint64_t &word : ships.words) {
+            quint64 v;
+            if (!in.u64(v)) return false;
+            word = v;
+        }
+        const quint64 extra = ships.words[CellMask::WORDS - 1] & ~CellMask::LAST_WORD_MASK;
+        msg.boardStatus = extra ? BoardStatus::Malformed : BoardStatus::Ok;
+        msg.board.setShips(ships);
+        return true;
+    }
+    case MessageType::Shot:
+    case MessageType::ShotReceived:
+    case MessageType::ShipSunk:
+        return in.coord(msg.x) && in.coord(msg.y);
+    case MessageType::ShotResult:
+        return in.coord(msg.x) && in.coord(msg.y) && in.flag(msg.hit);
+    case MessageType::TurnChange:
+        return in.flag(msg.yourTurn);
+    case MessageType::GameStart:
+        return in.flag(msg.yourTurn) && in.str(msg.opponent);
+    case MessageType::GameFound:
+        return in.str(msg.opponent);
+    case MessageType::GameOver:
+        return in.flag(msg.win);
+    case MessageType::ChatMessage:
+        return in.str(msg.sender) && in.str(msg.text);
+    case MessageType::LobbyCreated:
+        return in.str(msg.lobbyId);
+    case MessageType::Error:
+        return in.str(msg.text);
+    case MessageType::Reconnect:
+        return in.str(msg.oldClientId);
+    case MessageType::ReconnectResponse:
+        return in.flag(msg.success);
+    case MessageType::Stats:
+        return in.str(msg.format) && in.str(msg.text);
+    case MessageType::Spectate:
+        return in.str(msg.lobbyId);
+    case MessageType::SpectateState:
+        return in.str(msg.lobbyId) && in.str(msg.username) && in.str(msg.opponent)
+            && in.flag(msg.yourTurn) && in.flag(msg.finished) && in.flag(msg.success) && in.flag(msg.win)
+            && in.board(msg.board) && in.board(msg.otherBoard);
+    case MessageType::SpectateEvent:
+        return in.str(msg.lobbyId) && in.coord(msg.x) && in.coord(msg.y) && in.flag(msg.hit)
+            && in.flag(msg.sunk) && in.flag(msg.firstPlayer) && in.flag(msg.yourTurn);
+    case MessageType::Bundle: {
+        quint8 count;
+        if (!in.u8(count)) return false;
+        msg.parts.resize(count);
+        for (QByteArray &part : msg.parts) {
+            if (!in.bytes(part)) return false;
+        }
+        return true;
+    }
+    case MessageType::Ready:
+    case MessageType::Ping:
+    case MessageType::Pong:
+    case MessageType::LobbyTimeout:
+    case MessageType::CreateGame:
+    case MessageType::JoinGame:
+    case MessageType::WaitingForOpponent:
+        return true;
+    case MessageType::Unknown:
+        break;
+    }
+    return false;
+}
+
+QByteArray encodeBinary(const Message &msg) {
+    Writer out(msg.type, 16);
+
+    switch (msg.type) {
+    case MessageType::Login:
+        out.u8(msg.protocolVersion);
+        out.str(msg.username);
+        out.u8(msg.reliable);
+        out.u8(msg.bundles);
+        break;
+    case MessageType::LoginResponse:
+        out.u8(msg.success);
+        out.u8(msg.protocolVersion);
+        out.u8(msg.reliable);
+        out.u8(msg.bundles);
+        break;
+    case MessageType::Board:
+        for (quint64 word : msg.board.ships().words) out.u64(word);
+        break;
+    case MessageType::Shot:
+    case MessageType::ShotReceived:
+    case MessageType::ShipSunk:
+        out.u8(static_cast<quint8>(msg.x));
+        out.u8(static_cast<quint8>(msg.y));
+        break;
+    case MessageType::ShotResult:
+        out.u8(static_cast<quint8>(msg.x));
+        out.u8(static_cast<quint8>(msg.y));
+        out.u8(msg.hit);
+        break;
+    case MessageType::TurnChange:
+        out.u8(msg.yourTurn);
+        break;
+    case MessageType::GameStart:
+        out.u8(msg.yourTurn);
+        out.str(msg.opponent);
+        break;
+    case MessageType::GameFound:
+        out.str(msg.opponent);
+        break;
+    case MessageType::GameOver:
+        out.u8(msg.win);
+        break;
+    case MessageType::ChatMessage:
+        out.str(msg.sender);
+        out.str(msg.text);
+        break;
+    case MessageType::LobbyCreated:
+        out.str(msg.lobbyId);
+        break;
+    case MessageType::Error:
+        out.str(msg.text);
+        break;
+    case MessageType::Reconnect:
+        out.str(msg.oldClientId);
+        break;
+    case MessageType::ReconnectResponse:
+        out.u8(msg.success);
+        break;
+    case MessageType::Stats:
+        out.str(msg.format);
+        out.str(msg.text);
+        break;
+    case MessageType::Spectate:
+        out.str(msg.lobbyId);
+        break;
+    case MessageType::SpectateState:
+        out.str(msg.lobbyId);
+        out.str(msg.username);
+        out.str(msg.opponent);
+        out.u8(msg.yourTurn);
+        out.u8(msg.finished);
+        out.u8(msg.success);
+        out.u8(msg.win);
+        out.board(msg.board);
+        out.board(msg.otherBoard);
+        break;
+    case MessageType::SpectateEvent:
+        out.str(msg.lobbyId);
+        out.u8(static_cast<quint8>(msg.x));
+        out.u8(static_cast<quint8>(msg.y));
+        out.u8(msg.hit);
+        out.u8(msg.sunk);
+        out.u8(msg.firstPlayer);
+        out.u8(msg.yourTurn);
+        break;
+    case MessageType::Bundle:
+        out.u8(static_cast<quint8>(qMin(msg.parts.size(), 0xFF)));
+        for (int i = 0; i < msg.parts.size() && i < 0xFF; ++i) {
+            out.bytes(msg.parts[i]);
+        }
+        break;
+    default:
+        break;
+    }
+    return out.take();
+}
+
+bool fromJson(const QJsonObject &json, Message &msg) {
+    msg = Message();
+    msg.type = typeFromName(json["type"].toString());
+    if (msg.type == MessageType::Unknown) return false;
+
+    msg.x = json["x"].toInt();
+    msg.y = json["y"].toInt();
+    msg.hit = json["hit"].toBool();
+    msg.yourTurn = json["your_turn"].toBool();
+    msg.success = json["success"].toBool();
+    msg.win = json["result"].toString() == "win";
+    msg.protocolVersion = static_cast<quint8>(json["protocol"].toInt());
+    msg.reliable = json["reliable"].toBool();
+    msg.bundles = json["bundles"].toBool();
+    msg.firstPlayer = json["first_player"].toBool();
+    msg.sunk = json["sunk"].toBool();
+    msg.finished = json["finished"].toBool();
+    msg.username = json["username"].toString();
+    msg.opponent = json["opponent"].toString();
+    msg.lobbyId = json["lobby_id"].toString();
+    msg.sender = json["sender"].toString();
+    msg.text = json["message"].toString();
+    msg.oldClientId = json["old_client_id"].toString();
+    msg.format = json["format"].toString();
+
+    const QJsonArray parts = json["messages"].toArray();
+    for (int i = 0; i < parts.size(); ++i) {
+        msg.parts.append(QJsonDocument(parts[i].toObject()).toJson(QJsonDocument::Compact));
+    }
+
+    if (msg.type == MessageType::SpectateState) {
+        return boardStateFromJson(json["board"], msg.board)
+            && boardStateFromJson(json["other_board"], msg.otherBoard);
+    }
+    if (json.contains("board")) {
+        msg.boardStatus = boardFromJson(json["board"], msg.board)
+            ? BoardStatus::Ok : BoardStatus::Malformed;
+    }
+    return true;
+}
+
+QJsonObject toJson(const Message &msg) {
+    QJsonObject json;
+    json["type"] = typeName(msg.type);
+
+    switch (msg.type) {
+    case MessageType::Login:
+        json["username"] = msg.username;
+        if (msg.protocolVersion) json["protocol"] = int(msg.protocolVersion);
+        if (msg.reliable) json["reliable"] = true;
+        if (msg.bundles) json["bundles"] = true;
+        break;
+    case MessageType::LoginResponse:
+        json["success"] = msg.success;
+        if (msg.protocolVersion) json["protocol"] = int(msg.protocolVersion);
+        if (msg.reliable) json["reliable"] = true;
+        if (msg.bundles) json["bundles"] = true;
+        break;
+    case MessageType::Board:
+        json["board"] = boardToJson(msg.board);
+        break;
+    case MessageType::Shot:
+    case MessageType::ShotReceived:
+    case MessageType::ShipSunk:
+        json["x"] = msg.x;
+        json["y"] = msg.y;
+        break;
+    case MessageType::ShotResult:
+        json["x"] = msg.x;
+        json["y"] = msg.y;
+        json["hit"] = msg.hit;
+        break;
+    case MessageType::TurnChange:
+        json["your_turn"] = msg.yourTurn;
+        break;
+    case MessageType::GameStart:
+        json["opponent"] = msg.opponent;
+        json["your_turn"] = msg.yourTurn;
+        break;
+    case MessageType::GameFound:
+        json["opponent"] = msg.opponent;
+        break;
+    case MessageType::GameOver:
+        json["result"] = msg.win ? "win" : "lose";
+        break;
+    case MessageType::ChatMessage:
+        json["sender"] = msg.sender;
+        json["message"] = msg.text;
+        break;
+    case MessageType::LobbyCreated:
+        json["lobby_id"] = msg.lobbyId;
+        break;
+    case MessageType::Error:
+        json["message"] = msg.text;
+        break;
+    case MessageType::Reconnect:
+        json["old_client_id"] = msg.oldClientId;
+        break;
+    case MessageType::ReconnectResponse:
+        json["success"] = msg.success;
+        break;
+    case MessageType::Stats:
+        if (!msg.format.isEmpty()) json["format"] = msg.format;
+        if (!msg.text.isEmpty()) json["message"] = msg.text;
+        break;
+    case MessageType::Spectate:
+        json["lobby_id"] = msg.lobbyId;
+        break;
+    case MessageType::SpectateState:
+        json["lobby_id"] = msg.lobbyId;
+        json["username"] = msg.username;
+        json["opponent"] = msg.opponent;
+        json["your_turn"] = msg.yourTurn;
+        json["finished"] = msg.finished;
+        if (msg.finished) {
+            json["success"] = msg.success;
+            json["result"] = msg.win ? "win" : "lose";
+        }
+        json["board"] = boardStateToJson(msg.board);
+        json["other_board"] = boardStateToJson(msg.otherBoard);
+        break;
+    case MessageType::SpectateEvent:
+        json["lobby_id"] = msg.lobbyId;
+        json["x"] = msg.x;
+        json["y"] = msg.y;
+        json["hit"] = msg.hit;
+        json["sunk"] = msg.sunk;
+        json["first_player"] = msg.firstPlayer;
+        json["your_turn"] = msg.yourTurn;
+        break;
+    case MessageType::Bundle: {
+        QJsonArray messages;
+        // Части уже в JSON: объект берется как есть, без разбора в Message
+        for (const QByteArray &part : msg.parts) {
+            messages.append(QJsonDocument::fromJson(part).object());
+        }
+        json["messages"] = messages;
+        break;
+    }
+    default:
+        break;
+    }
+    return json;
+}
+
+} // namespace Protocol
@@ -0,0 +1,136 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <QByteArray>
+#include <QString>
+#include <QJsonObject>
+#include <QVector>
+#include "bitboard.h"
+
+// Сетевой протокол игры. Каждое сообщение передается одной датаграммой либо
+// в JSON (старые клиенты), либо в компактном двоичном виде:
+//
+//   [0xB5][версия][тип][поля сообщения]
+//
+// Числа записываются в little-endian, строки - как u16 длина + UTF-8 байты,
+// расстановка кораблей - как две 64-битные маски BitBoard. Двоичный формат
+// согласуется при входе: клиент присылает "protocol": <версия> в login,
+// сервер подтверждает ее в login_response, и дальше обе стороны переходят
+// на двоичные датаграммы.
+//
+// Несколько сообщений одному получателю могут ехать одной датаграммой-пачкой
+// (bundle): каждое вложенное сообщение закодировано целиком в формате пачки
+// и разбирается обычным decode(). Пачки шлются только клиентам, объявившим
+// "bundles" при входе.
+namespace Protocol {
+
+constexpr quint8 MAGIC = 0xB5;
+constexpr quint8 VERSION = 1;
+
+enum class WireFormat : quint8 {
+    Json,
+    Binary
+};
+
+enum class MessageType : quint8 {
+    Unknown = 0,
+    Login,
+    LoginResponse,
+    Board,
+    Ready,
+    Shot,
+    ShotResult,
+    ShotReceived,
+    ShipSunk,
+    TurnChange,
+    GameStart,
+    GameOver,
+    ChatMessage,
+    Ping,
+    Pong,
+    LobbyCreated,
+    LobbyTimeout,
+    Error,
+    Reconnect,
+    ReconnectResponse,
+    CreateGame,
+    JoinGame,
+    GameFound,
+    WaitingForOpponent,
+    Stats,
+    Bundle,
+    Spectate,
+    SpectateState,
+    SpectateEvent
+};
+
+enum class BoardStatus : quint8 {
+    Missing,    // в сообщении нет поля board
+    Malformed,  // неверный размер или клетки, кроме 0 и 1
+    Ok
+};
+
+struct Message {
+    MessageType type = MessageType::Unknown;
+    int x = 0;
+    int y = 0;
+    bool hit = false;
+    bool yourTurn = false;
+    bool success = false;
+    bool win = false;
+    quint8 protocolVersion = 0;
+    bool reliable = false;  // login, login_response: надежная доставка (reliablechannel.h)
+    bool bundles = false;   // login, login_response: получатель разбирает пачки
+    bool firstPlayer = false;   // spectate_event: стрелял первый игрок
+    bool sunk = false;          // spectate_event: выстрел потопил корабль
+    bool finished = false;      // spectate_state: партия закончена, корабли открыты
+    // Зрителю your_turn - ход первого игрока; в spectate_state success - партия
+    // доиграна до победы, win - победил первый игрок
+    QString username;       // login; spectate_state: первый игрок
+    QString opponent;       // game_start, game_found; spectate_state: второй игрок
+    QString lobbyId;        // lobby_created, spectate, spectate_state, spectate_event
+    QString sender;         // chat_message
+    QString text;           // chat_message, error, stats
+    QString oldClientId;    // reconnect
+    QString format;         // stats: "text" или "json"
+    BoardStatus boardStatus = BoardStatus::Missing;
+    BitBoard board;         // board; spectate_state: поле первого игрока
+    BitBoard otherBoard;    // spectate_state: поле второго игрока
+    QVector<QByteArray> parts;   // bundle: закодированные вложенные сообщения
+};
+
+// Имя типа в JSON ("shot_result" и т.п.)
+QString typeName(MessageType type);
+MessageType typeFromName(const QString &name);
+
+// Сообщения, от которых зависит ход игры: при надежной доставке они
+// повторяются до подтверждения. Пинги, чат и статистика уходят один раз.
+bool requiresDelivery(MessageType type);
+
+// Класс состояния для ReliableChannel::acceptState. Сообщения одного класса
+// заменяют состояние целиком, и опоздавший повтор старого не должен затереть
+// уже примененное новое. Класс 0 - сообщение самодостаточно и применяется в
+// любом порядке.
+enum StateClass {
+    NoState = 0,
+    TurnState = 1   // чей ход: turn_change, game_start
+};
+int stateClass(MessageType type);
+
+// Определяет формат по первому байту и разбирает датаграмму
+bool decode(const QByteArray &data, Message &msg, WireFormat *format = nullptr);
+QByteArray encode(const Message &msg, WireFormat format);
+// Размер пачки сверх самих частей: bundleOverhead на пачку и
+// bundlePartOverhead на каждую часть (с запасом в одну часть для JSON)
+int bundleOverhead(WireFormat format);
+int bundlePartOverhead(WireFormat format);
+
+bool decodeBinary(const QByteArray &data, Message &msg);
+QByteArray encodeBinary(const Message &msg);
+
+bool fromJson(const QJsonObject &json, Message &msg);
+QJsonObject toJson(const Message &msg);
+
+} // namespace Protocol
+
+#endif // PROTOCOL_H
@@ -0,0 +1,174 @@
+#include "reliablechannel.h"
+#include <QtEndian>
+#include <cmath>
+
+namespace {
+
+// Сравнение номеров с переполнением 16 бит: a новее b
+bool seqNewer(quint16 a, quint16 b) {
+    return a != b && quint16(a - b) < 0x8000;
+}
+
+} // namespace
+
+QByteArray ReliableChannel::envelope(quint8 flags, quint16 seq, const QByteArray &payload) const {
+    char header[HEADER_SIZE];
+    header[0] = char(MAGIC);
+    header[1] = char(flags | (m_hasRemote ? FLAG_HAS_ACK : 0));
+    qToLittleEndian(seq, header + 2);
+    qToLittleEndian(m_remoteSeq, header + 4);
+    qToLittleEndian(m_receivedBits, header + 6);
+
+    QByteArray datagram;
+    datagram.reserve(HEADER_SIZE + payload.size());
+    datagram.append(header, HEADER_SIZE);
+    datagram.append(payload);
+    return datagram;
+}
+
+QByteArray ReliableChannel::wrap(const QByteArray &payload, bool reliable, qint64 nowMs) {
+    m_ackPending = false;
+    if (!reliable) {
+        return envelope(0, 0, payload);
+    }
+
+    if (m_pending.size() >= MAX_PENDING) {
+        // Собеседник давно молчит: самое старое сообщение уже не спасти.
+        // Потеря учитывается как брошенное сообщение в takeRetransmits
+        m_pending.removeFirst();
+        ++m_overflowed;
+    }
+    const quint16 seq = m_nextSeq++;
+    m_pending.append({seq, payload, nowMs, nowMs + backoff(1), 1});
+    return envelope(FLAG_RELIABLE, seq, payload);
+}
+
+QByteArray ReliableChannel::makeAck() {
+    m_ackPending = false;
+    return envelope(0, 0, QByteArray());
+}
+
+ReliableChannel::Receive ReliableChannel::unwrap(const QByteArray &datagram, QByteArray *payload, qint64 nowMs) {
+    if (datagram.size() < HEADER_SIZE || !isEnvelope(datagram)) return Receive::Invalid;
+
+    const char *data = datagram.constData();
+    const quint8 flags = quint8(data[1]);
+    const quint16 seq = qFromLittleEndian<quint16>(data + 2);
+    if (flags & FLAG_HAS_ACK) {
+        processAcks(qFromLittleEndian<quint16>(data + 4), qFromLittleEndian<quint32>(data + 6), nowMs);
+    }
+
+    const int size = datagram.size() - HEADER_SIZE;
+    if (!(flags & FLAG_RELIABLE)) {
+        if (size == 0) return Receive::AckOnly;
+        m_deliveredReliable = false;
+        *payload = datagram.mid(HEADER_SIZE);
+        return Receive::Deliver;
+    }
+
+    // Подтверждать нужно и повторы: прошлое подтверждение могло потеряться
+    m_ackPending = true;
+    if (!m_hasRemote) {
+        m_hasRemote = true;
+        m_remoteSeq = seq;
+        m_receivedBits = 0;
+    } else if (seqNewer(seq, m_remoteSeq)) {
+        const int shift = quint16(seq - m_remoteSeq);
+        // Прежний старший номер становится битом shift-1 маски
+        m_receivedBits = shift > ACK_WINDOW ? 0
+            : quint32((quint64(m_receivedBits) << shift) | (quint64(1) << (shift - 1)));
+        m_remoteSeq = seq;
+    } else {
+        const int distance = quint16(m_remoteSeq - seq);
+        // Номер старше окна не отличить от повтора - считаем повтором
+        if (distance == 0 || distance > ACK_WINDOW) return Receive::Duplicate;
+        const quint32 bit = quint32(1) << (distance - 1);
+        if (m_receivedBits & bit) return Receive::Duplicate;
+        m_receivedBits |= bit;
+    }
+
+    m_deliveredReliable = true;
+    m_deliveredSeq = seq;
+    *payload = datagram.mid(HEADER_SIZE);
+    return Receive::Deliver;
+}
+
+bool ReliableChannel::acceptState(int stateClass) {
+    if (stateClass <= 0 || stateClass >= STATE_CLASSES || !m_deliveredReliable) return true;
+    if (m_hasState[stateClass] && seqNewer(m_stateSeq[stateClass], m_deliveredSeq)) return false;
+    m_hasState[stateClass] = true;
+    m_stateSeq[stateClass] = m_deliveredSeq;
+    return true;
+}
+
+void ReliableChannel::processAcks(quint16 ack, quint32 bits, qint64 nowMs) {
+    for (int i = 0; i < m_pending.size();) {
+        const Pending &p = m_pending[i];
+        const int distance = quint16(ack - p.seq);
+        const bool acked = distance == 0
+            || (distance <= ACK_WINDOW && (bits & (quint32(1) << (distance - 1))));
+        if (!acked) {
+            ++i;
+            continue;
+        }
+        if (p.attempts == 1) {
+            sampleRtt(nowMs - p.sentAt);
+        }
+        m_pending.remove(i);
+    }
+}
+
+void ReliableChannel::sampleRtt(qint64 rttMs) {
+    const double rtt = double(rttMs);
+    if (!m_hasRtt) {
+        m_srttMs = rtt;
+        m_rttVarMs = rtt / 2.0;
+        m_hasRtt = true;
+    } else {
+        m_rttVarMs = 0.75 * m_rttVarMs + 0.25 * std::fabs(m_srttMs - rtt);
+        m_srttMs = 0.875 * m_srttMs + 0.125 * rtt;
+    }
+    m_rtoMs = qBound(MIN_RTO_MS, int(m_srttMs + 4.0 * m_rttVarMs), MAX_RTO_MS);
+}
+
+qint64 ReliableChannel::backoff(int attempts) const {
+    // Экспоненциальная отсрочка: каждый повтор ждет вдвое дольше
+    return qMin(qint64(m_rtoMs) << (attempts - 1), qint64(MAX_RTO_MS));
+}
+
+QVector<QByteArray> ReliableChannel::takeRetransmits(qint64 nowMs, int *abandoned) {
+    QVector<QByteArray> datagrams;
+    int dropped = m_overflowed;
+    m_overflowed = 0;
+    for (int i = 0; i < m_pending.size();) {
+        Pending &p = m_pending[i];
+        if (p.deadline > nowMs) {
+            ++i;
+            continue;
+        }
+        if (p.attempts >= MAX_ATTEMPTS) {
+            m_pending.remove(i);
+            ++dropped;
+            continue;
+        }
+        ++p.attempts;
+        p.sentAt = nowMs;
+        p.deadline = nowMs + backoff(p.attempts);
+        datagrams.append(envelope(FLAG_RELIABLE, p.seq, p.payload));
+        ++i;
+    }
+    if (!datagrams.isEmpty()) {
+        // Подтверждения уехали вместе с повторами
+        m_ackPending = false;
+    }
+    if (abandoned) *abandoned = dropped;
+    return datagrams;
+}
+
+qint64 ReliableChannel::nextDeadline() const {
+    qint64 deadline = -1;
+    for (const Pending &p : m_pending) {
+        if (deadline < 0 || p.deadline < deadline) deadline = p.deadline;
+    }
+    return deadline;
+}
@@ -0,0 +1,118 @@
+#ifndef RELIABLECHANNEL_H
+#define RELIABLECHANNEL_H
+
+#include <QByteArray>
+#include <QVector>
+
+// Надежная доставка поверх UDP для одного собеседника. Датаграмма
+// оборачивается в конверт:
+//
+//   [0xB6][флаги][seq u16][ack u16][ack-маска u32][сообщение]
+//
+// seq нумерует сообщения, требующие доставки; ack - старший номер,
+// полученный от собеседника, а бит i маски подтверждает номер ack-1-i.
+// Подтверждения едут в конвертах встречных сообщений, отдельная датаграмма
+// с одним подтверждением уходит, только если ответить нечем. Неподтвержденные
+// сообщения повторяются по таймеру, выведенному из измеренного RTT
+// (Jacobson/Karels, без замеров по повторам - алгоритм Карна), повтор
+// уже полученного номера не доставляется второй раз.
+//
+// Порядок доставки не восстанавливается: ожидание пропущенного номера
+// задерживало бы все следующие. Не по порядку могут приходить только
+// самодостаточные сообщения - выстрелы и их результаты, потопления, чат,
+// конец игры, события для зрителей. Сообщения, заменяющие состояние целиком
+// (чей ход: turn_change и game_start, см. Protocol::stateClass), получатель
+// применяет через acceptState, и опоздавший повтор старого не затирает
+// более новое. В самом unwrap этого не сделать: пачка (bundle) везет в одном
+// конверте сообщения разных типов.
+class ReliableChannel
+{
+public:
+    static constexpr quint8 MAGIC = 0xB6;
+    static constexpr int HEADER_SIZE = 10;
+    static constexpr int ACK_WINDOW = 32;
+    static constexpr int MAX_PENDING = 64;
+    static constexpr int INITIAL_RTO_MS = 500;
+    static constexpr int MIN_RTO_MS = 100;
+    static constexpr int MAX_RTO_MS = 4000;
+    static constexpr int MAX_ATTEMPTS = 8;
+
+    enum class Receive {
+        Deliver,     // новое сообщение, payload заполнен
+        Duplicate,   // повтор уже доставленного
+        AckOnly,     // только подтверждения
+        Invalid
+    };
+
+    static bool isEnvelope(const QByteArray &datagram) {
+        return !datagram.isEmpty() && quint8(datagram.at(0)) == MAGIC;
+    }
+
+    // Конверт для исходящего сообщения. reliable - сообщение получает номер
+    // и повторяется до подтверждения, иначе конверт только везет подтверждения.
+    QByteArray wrap(const QByteArray &payload, bool reliable, qint64 nowMs);
+    // Отдельное подтверждение, когда встречного сообщения нет
+    QByteArray makeAck();
+    bool ackPending() const { return m_ackPending; }
+
+    Receive unwrap(const QByteArray &datagram, QByteArray *payload, qint64 nowMs);
+
+    // Сообщение класса состояния stateClass (1..STATE_CLASSES-1) из последнего
+    // доставленного unwrap конверта. true - оно не старше уже примененного
+    // состояния этого класса и его нужно применить; false - опоздавший повтор.
+    // Для класса 0 и ненадежных конвертов всегда true.
+    static constexpr int STATE_CLASSES = 4;
+    bool acceptState(int stateClass);
+
+    // Конверты с просроченными сообщениями для повторной отправки. Сообщения,
+    // исчерпавшие MAX_ATTEMPTS, выбрасываются; их число пишется в *abandoned
+    // вместе с вытесненными из переполненной очереди в wrap.
+    QVector<QByteArray> takeRetransmits(qint64 nowMs, int *abandoned = nullptr);
+    bool hasPending() const { return !m_pending.isEmpty(); }
+    int pendingCount() const { return m_pending.size(); }
+    // Ближайший срок повтора; -1, если ждать нечего
+    qint64 nextDeadline() const;
+
+    int rtoMs() const { return m_rtoMs; }
+    int smoothedRttMs() const { return int(m_srttMs); }
+
+private:
+    enum Flags : quint8 {
+        FLAG_RELIABLE = 0x01,
+        FLAG_HAS_ACK = 0x02
+    };
+
+    struct Pending {
+        quint16 seq;
+        QByteArray payload;
+        qint64 sentAt;
+        qint64 deadline;
+        int attempts;
+    };
+
+    QByteArray envelope(quint8 flags, quint16 seq, const QByteArray &payload) const;
+    void processAcks(quint16 ack, quint32 bits, qint64 nowMs);
+    void sampleRtt(qint64 rttMs);
+    qint64 backoff(int attempts) const;
+
+    // Исходящее направление
+    quint16 m_nextSeq = 0;
+    QVector<Pending> m_pending;
+    double m_srttMs = 0.0;
+    double m_rttVarMs = 0.0;
+    bool m_hasRtt = false;
+    int m_rtoMs = INITIAL_RTO_MS;
+    int m_overflowed = 0;   // вытеснены в wrap, еще не отданы takeRetransmits
+
+    // Входящее направление
+    bool m_hasRemote = false;
+    quint16 m_remoteSeq = 0;
+    quint32 m_receivedBits = 0;
+    bool m_ackPending = false;
+    bool m_deliveredReliable = false;   // последний доставленный конверт надежный
+    quint16 m_deliveredSeq = 0;
+    bool m_hasState[STATE_CLASSES] = {};
+    quint16 m_stateSeq[STATE_CLASSES] = {};   // номер примененного состояния
+};
+
+#endif // RELIABLECHANNEL_H
@@ -0,0 +1,427 @@
+#include "shotstrategy.h"
+#include "workstealingpool.h"
+
+namespace {
+
+constexpr CellMask horizontalNeighbours(const CellMask &m) {
+    return (m & NOT_LAST_COLUMN<BitBoard::WIDTH, BitBoard::HEIGHT>).shl(1)
+           | (m & NOT_FIRST_COLUMN<BitBoard::WIDTH, BitBoard::HEIGHT>).shr(1);
+}
+
+constexpr CellMask verticalNeighbours(const CellMask &m) {
+    return m.shl(BitBoard::WIDTH) | m.shr(BitBoard::WIDTH);
+}
+
+// Носы горизонтальных кораблей длины length: корабль не выходит за строку
+const CellMask &rowStarts(int length) {
+    static const auto table = [] {
+        std::vector<CellMask> masks(BitBoard::MAX_SHIP_SIZE + 2);
+        for (int l = 1; l <= BitBoard::MAX_SHIP_SIZE + 1; ++l) {
+            for (int i = 0; i < BitBoard::CELL_COUNT; ++i) {
+                if (i % BitBoard::WIDTH + l <= BitBoard::WIDTH) masks[l].set(i);
+            }
+        }
+        return masks;
+    }();
+    return table[length];
+}
+
+// Сдвиг маски на n клеток: n > 0 - к старшим, n < 0 - к младшим
+CellMask shifted(const CellMask &m, int n) {
+    if (n == 0) return m;
+    return n > 0 ? m.shl(n) : m.shr(-n);
+}
+
+// Равномерно по необстрелянным клеткам
+class RandomStrategy : public ShotStrategy
+{
+public:
+    const char *name() const override { return "random"; }
+
+    int nextShot(const ShotHistory &history) override {
+        return randomCell(~history.shots);
+    }
+};
+
+// Прежний бот клиента: добивает вокруг подбитых палуб, иначе стреляет
+// наугад
+class HuntStrategy : public ShotStrategy
+{
+public:
+    const char *name() const override { return "hunt"; }
+
+    int nextShot(const ShotHistory &history) override {
+        const CellMask open = ~history.shots;
+        const CellMask targets = adjacentCells(history.wounded()) & open;
+        return randomCell(targets.any() ? targets : open);
+    }
+};
+
+// Охота по диагональной решетке с шагом в длину самого короткого из
+// оставшихся кораблей (такой корабль решетку не обойдет), добивание вдоль
+// линии подбитых палуб, ореолы потопленных кораблей пропускаются
+class ParityStrategy : public ShotStrategy
+{
+public:
+    const char *name() const override { return "parity"; }
+
+    void newGame() override {
+        m_offset = m_rng();
+    }
+
+    int nextShot(const ShotHistory &history) override {
+        CellMask open = history.candidates();
+        if (open.none()) open = ~history.shots;
+
+        const CellMask wounded = history.wounded();
+        if (wounded.any()) {
+            // Две соседние подбитые палубы задают направление корабля
+            const CellMask rows = wounded & horizontalNeighbours(wounded);
+            const CellMask columns = wounded & verticalNeighbours(wounded);
+            const CellMask single = wounded & ~rows & ~columns;
+            const CellMask targets = (horizontalNeighbours(rows) | verticalNeighbours(columns)
+                                      | adjacentCells(single)) & open;
+            if (targets.any()) return randomCell(targets);
+        }
+
+        int shortest = 1;
+        while (shortest < BitBoard::MAX_SHIP_SIZE && history.sunkShips[shortest] >= BitBoard::Fleet::COUNT[shortest]) {
+            ++shortest;
+        }
+        if (shortest > 1) {
+            const CellMask lattice = latticeMask(shortest, int(m_offset % unsigned(shortest))) & open;
+            if (lattice.any()) return randomCell(lattice);
+        }
+        return randomCell(open);
+    }
+
+private:
+    // Клетки с (x + y) % step == offset
+    static CellMask latticeMask(int step, int offset) {
+        static const auto table = [] {
+            std::vector<CellMask> masks((BitBoard::MAX_SHIP_SIZE + 1) * BitBoard::MAX_SHIP_SIZE);
+            for (int s = 1; s <= BitBoard::MAX_SHIP_SIZE; ++s) {
+                for (int i = 0; i < BitBoard::CELL_COUNT; ++i) {
+                    const int x = i % BitBoard::WIDTH;
+                    const int y = i / BitBoard::WIDTH;
+                    masks[s * BitBoard::MAX_SHIP_SIZE + (x + y) % s].set(i);
+                }
+            }
+            return masks;
+        }();
+        return table[step * BitBoard::MAX_SHIP_SIZE + offset];
+    }
+
+    uint32_t m_offset = 0;
+};
+
+// Плотность вероятности: каждый еще не потопленный корабль примеряется во
+// все положения, совместимые с историей (не задевают промахов, ореолов
+// потопленных и диагоналей попаданий), выстрел - в клетку, которую
+// накрывает больше всего положений. Пока есть подбитые палубы, считаются
+// только положения через них, с весом по числу накрытых попаданий.
+// Положения перебираются масками: пересечение сдвигов свободной маски дает
+// сразу все носы корабля, а счетчики клеток хранятся битовыми срезами.
+// Плотность пересчитывается с нуля за несколько микросекунд на ход.
+class DensityStrategy : public ShotStrategy
+{
+public:
+    const char *name() const override { return "density"; }
+
+    int nextShot(const ShotHistory &history) override {
+        const CellMask open = ~history.shots;
+        const CellMask wounded = history.wounded();
+        const CellMask allowed = history.candidates() | wounded;
+
+        if (wounded.any()) {
+            Density density;
+            accumulate(history, allowed, wounded, density);
+            const CellMask best = density.maximum(open);
+            if (best.any()) return randomCell(best);
+        }
+        Density density;
+        accumulate(history, allowed, CellMask(), density);
+        const CellMask best = density.maximum(open);
+        return randomCell(best.any() ? best : open);
+    }
+
+private:
+    // Счетчик на каждую клетку, разряд j всех счетчиков - маска planes[j]
+    struct Density {
+        static constexpr int PLANES = 10;
+        CellMask planes[PLANES];
+
+        void add(const CellMask &mask, int weight) {
+            for (int j = 0; weight != 0 && j < PLANES; ++j, weight >>= 1) {
+                if (!(weight & 1)) continue;
+                CellMask carry = mask;
+                for (int k = j; carry.any() && k < PLANES; ++k) {
+                    const CellMask next = planes[k] & carry;
+                    planes[k] = planes[k] ^ carry;
+                    carry = next;
+                }
+            }
+        }
+
+        // Клетки of с наибольшим ненулевым счетчиком, пустая маска - в of
+        // все счетчики нулевые
+        CellMask maximum(const CellMask &of) const {
+            CellMask best = of;
+            bool counted = false;
+            for (int j = PLANES - 1; j >= 0; --j) {
+                const CellMask higher = best & planes[j];
+                if (higher.none()) continue;
+                best = higher;
+                counted = true;
+            }
+            return counted ? best : CellMask();
+        }
+    };
+
+    // Добавляет положения оставшихся кораблей внутри allowed. Если must не
+    // пуст, считаются только положения, накрывающие его клетки, по разу на
+    // каждую накрытую клетку must
+    static void accumulate(const ShotHistory &history, const CellMask &allowed, const CellMask &must,
+                           Density &density) {
+        for (int length = 1; length <= BitBoard::MAX_SHIP_SIZE; ++length) {
+            const int left = BitBoard::Fleet::COUNT[length] - history.sunkShips[length];
+            if (left <= 0) continue;
+            for (const int step : {1, BitBoard::WIDTH}) {
+                // Однопалубный лежит одинаково в обоих направлениях
+                if (length == 1 && step != 1) break;
+                CellMask starts = step == 1 ? rowStarts(length) & allowed : allowed;
+                for (int k = 1; k < length; ++k) starts &= shifted(allowed, -k * step);
+                if (history.hits.any()) starts &= ~touching(history.wounded(), length, step);
+                if (starts.none()) continue;
+                if (must.none()) {
+                    for (int k = 0; k < length; ++k) density.add(shifted(starts, k * step), left);
+                    continue;
+                }
+                for (int hit = 0; hit < length; ++hit) {
+                    const CellMask through = starts & shifted(must, -hit * step);
+                    if (through.none()) continue;
+                    for (int k = 0; k < length; ++k) density.add(shifted(through, k * step), left);
+                }
+            }
+        }
+    }
+
+    // Носы положений, ореол которых задевает подбитую палубу wounded: такая
+    // палуба принадлежит другому кораблю, а корабли не касаются
+    static CellMask touching(const CellMask &wounded, int length, int step) {
+        const CellMask left = (wounded & NOT_LAST_COLUMN<BitBoard::WIDTH, BitBoard::HEIGHT>).shl(1);
+        const CellMask right = (wounded & NOT_FIRST_COLUMN<BitBoard::WIDTH, BitBoard::HEIGHT>).shr(1);
+        const CellMask up = wounded.shl(BitBoard::WIDTH);
+        const CellMask down = wounded.shr(BitBoard::WIDTH);
+        // Клетка с подбитой палубой в ней самой или рядом поперек корабля
+        const CellMask across = step == 1 ? wounded | up | down : wounded | left | right;
+        const CellMask sides = step == 1 ? up | down : left | right;
+
+        CellMask bad;
+        if (step == 1) {
+            bad = (across & NOT_LAST_COLUMN<BitBoard::WIDTH, BitBoard::HEIGHT>).shl(1)
+                  | (across.shr(length) & rowStarts(length + 1));
+        } else {
+            bad = across.shl(BitBoard::WIDTH) | across.shr(length * BitBoard::WIDTH);
+        }
+        for (int k = 0; k < length; ++k) bad |= shifted(sides, -k * step);
+        return bad;
+    }
+};
+
+// Монте-Карло: случайные расстановки оставшихся кораблей, совместимые с
+// историей, - корабли ставятся по правилам BitBoard::canPlaceShip (не
+// касаются друг друга и запрещенных клеток), расстановка принимается, если
+// накрывает все подбитые палубы. Выстрел - в клетку, занятую в наибольшем
+// числе принятых расстановок. Выборки делятся на задачи по TASK_SAMPLES и
+// идут в WorkStealingPool, каждая задача со своим генератором от зерна хода
+// и номера задачи, так что без срока итог не зависит от числа потоков.
+class MonteCarloStrategy : public ShotStrategy
+{
+public:
+    static constexpr int TASK_SAMPLES = 64;
+
+    explicit MonteCarloStrategy(const SamplingOptions &options = SamplingOptions()) :
+        m_options(options),
+        m_pool(options.threads),
+        m_counts(size_t(m_pool.threads()))
+    {
+    }
+
+    const char *name() const override { return "montecarlo"; }
+
+    int nextShot(const ShotHistory &history) override {
+        const CellMask open = ~history.shots;
+        const CellMask wounded = history.wounded();
+        const CellMask allowed = history.candidates() | wounded;
+
+        // Длины непотопленных кораблей, от длинных к коротким
+        int lengths[BitBoard::Fleet::SHIPS];
+        int shipCount = 0;
+        int sunk[BitBoard::MAX_SHIP_SIZE + 1] = {0};
+        for (const int length : BitBoard::Fleet::LENGTHS.values) {
+            if (sunk[length] < history.sunkShips[length]) {
+                ++sunk[length];
+                continue;
+            }
+            lengths[shipCount++] = length;
+        }
+
+        for (Occupancy &counts : m_counts) counts = Occupancy();
+        const uint32_t seed = m_rng();
+        const auto deadline = m_options.deadlineMs > 0
+                                  ? WorkStealingPool::Clock::now() + std::chrono::milliseconds(m_options.deadlineMs)
+                                  : WorkStealingPool::Clock::time_point::max();
+        const int samples = m_options.samples > 0 ? m_options.samples : 1;
+        const int tasks = (samples + TASK_SAMPLES - 1) / TASK_SAMPLES;
+        m_pool.run(tasks, [&](int task, int worker) {
+            std::seed_seq seeds{seed, uint32_t(task)};
+            std::mt19937 rng(seeds);
+            Occupancy &counts = m_counts[size_t(worker)];
+            for (int n = 0; n < TASK_SAMPLES; ++n) {
+                CellMask fleet;
+                if (!sample(rng, allowed, lengths, shipCount, fleet) || (wounded & ~fleet).any()) continue;
+                for (CellMask rest = fleet & open; rest.any(); ) {
+                    const int cell = rest.lowest();
+                    rest.reset(cell);
+                    ++counts.cells[cell];
+                }
+            }
+        }, deadline);
+
+        uint32_t total[BitBoard::CELL_COUNT] = {0};
+        for (const Occupancy &counts : m_counts) {
+            for (int i = 0; i < BitBoard::CELL_COUNT; ++i) total[i] += counts.cells[i];
+        }
+        CellMask best;
+        uint32_t most = 0;
+        for (int i = 0; i < BitBoard::CELL_COUNT; ++i) {
+            if (!open.test(i) || total[i] < most || total[i] == 0) continue;
+            if (total[i] > most) {
+                most = total[i];
+                best = CellMask();
+            }
+            best.set(i);
+        }
+        if (best.any()) return randomCell(best);
+
+        // Ни одна выборка не подошла - добиваем вокруг подбитых палуб
+        const CellMask candidates = history.candidates();
+        const CellMask targets = adjacentCells(wounded) & candidates;
+        if (targets.any()) return randomCell(targets);
+        return randomCell(candidates.any() ? candidates : open);
+    }
+
+private:
+    // Счетчики занятости клеток одного исполнителя, на своей строке кэша
+    struct alignas(64) Occupancy {
+        uint32_t cells[BitBoard::CELL_COUNT] = {};
+    };
+
+    // Одна расстановка кораблей lengths внутри allowed: каждый корабль - в
+    // случайное из положений, где он помещается. false - очередному кораблю
+    // места не осталось
+    static bool sample(std::mt19937 &rng, const CellMask &allowed, const int *lengths, int shipCount,
+                       CellMask &fleet) {
+        CellMask free = allowed;
+        for (int s = 0; s < shipCount; ++s) {
+            const int length = lengths[s];
+            CellMask rows = rowStarts(length) & free;
+            CellMask columns = length > 1 ? free : CellMask();
+            for (int k = 1; k < length; ++k) {
+                rows &= free.shr(k);
+                columns &= free.shr(k * BitBoard::WIDTH);
+            }
+            const int rowCount = rows.count();
+            const int total = rowCount + columns.count();
+            if (total == 0) return false;
+
+            const int pick = int(rng() % unsigned(total));
+            const bool horizontal = pick < rowCount;
+            const int start = horizontal ? rows.nth(pick) : columns.nth(pick - rowCount);
+            const CellMask ship = BitBoard::shipMask(start % BitBoard::WIDTH, start / BitBoard::WIDTH, length,
+                                                     horizontal);
+            fleet |= ship;
+            free &= ~(ship | SHIP_HALOS<ClassicRules>.masks[start][length - 1][horizontal ? 0 : 1]);
+        }
+        return true;
+    }
+
+    const SamplingOptions m_options;
+    WorkStealingPool m_pool;
+    std::vector<Occupancy> m_counts;   // по исполнителю пула
+};
+
+struct StrategyEntry {
+    const char *name;
+    const char *description;
+    std::unique_ptr<ShotStrategy> (*create)();
+    bool slow;   // миллисекунды на ход: в турнир только по имени
+};
+
+template <typename T>
+std::unique_ptr<ShotStrategy> make() {
+    return std::unique_ptr<ShotStrategy>(new T());
+}
+
+const StrategyEntry STRATEGIES[] = {
+    {"random", "uniform over cells not shot yet", make<RandomStrategy>, false},
+    {"hunt", "neighbours of wounded ships, otherwise random", make<HuntStrategy>, false},
+    {"parity", "lattice hunting, line targeting, skips halos of sunk ships", make<ParityStrategy>, false},
+    {"density", "offline client bot: probability density of remaining ship placements", make<DensityStrategy>, false},
+    {"montecarlo", "hard offline bot: most occupied cell over sampled consistent fleets", make<MonteCarloStrategy>, true},
+};
+
+} // namespace
+
+void ShotHistory::record(int cell, bool hit, const CellMask &sunkShip) {
+    shots.set(cell);
+    if (!hit) return;
+    hits.set(cell);
+    if (sunkShip.any()) {
+        sunk |= sunkShip;
+        const int length = sunkShip.count();
+        if (length <= BitBoard::MAX_SHIP_SIZE) ++sunkShips[length];
+    }
+}
+
+CellMask ShotHistory::candidates() const {
+    return ~(shots | surroundingCells(sunk) | diagonalCells(hits));
+}
+
+std::unique_ptr<ShotStrategy> ShotStrategy::create(const std::string &name) {
+    for (const StrategyEntry &entry : STRATEGIES) {
+        if (name == entry.name) return entry.create();
+    }
+    return nullptr;
+}
+
+std::unique_ptr<ShotStrategy> ShotStrategy::createMonteCarlo(const SamplingOptions &options) {
+    return std::unique_ptr<ShotStrategy>(new MonteCarloStrategy(options));
+}
+
+std::vector<std::string> ShotStrategy::names(bool withSlow) {
+    std::vector<std::string> result;
+    for (const StrategyEntry &entry : STRATEGIES) {
+        if (withSlow || !entry.slow) result.push_back(entry.name);
+    }
+    return result;
+}
+
+bool ShotStrategy::isSlow(const std::string &name) {
+    for (const StrategyEntry &entry : STRATEGIES) {
+        if (name == entry.name) return entry.slow;
+    }
+    return false;
+}
+
+const char *ShotStrategy::description(const std::string &name) {
+    for (const StrategyEntry &entry : STRATEGIES) {
+        if (name == entry.name) return entry.description;
+    }
+    return "";
+}
+
+int ShotStrategy::randomCell(const CellMask &mask) {
+    return mask.nth(int(m_rng() % unsigned(mask.count())));
+}
@@ -0,0 +1,70 @@
+#ifndef SHOTSTRATEGY_H
+#define SHOTSTRATEGY_H
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "bitboard.h"
+
+// Что стреляющий знает о поле противника: свои выстрелы, попадания и
+// потопленные корабли (о потоплении сообщает сервер, как и клиенту)
+struct ShotHistory {
+    CellMask shots;
+    CellMask hits;
+    CellMask sunk;                                      // палубы потопленных кораблей
+    int sunkShips[BitBoard::MAX_SHIP_SIZE + 1] = {0};   // по длине корабля
+
+    void clear() { *this = ShotHistory(); }
+    // sunkShip - палубы корабля, потопленного этим выстрелом, иначе пустая маска
+    void record(int cell, bool hit, const CellMask &sunkShip);
+
+    // Подбитые, но еще не потопленные палубы
+    CellMask wounded() const { return hits & ~sunk; }
+    // Клетки, где еще может стоять палуба: не обстреляны, не касаются
+    // потопленных кораблей и не стоят по диагонали от попаданий
+    CellMask candidates() const;
+};
+
+// Настройки стратегии montecarlo: число случайных расстановок на ход, срок
+// хода в миллисекундах (0 - без срока, итог зависит только от зерна) и число
+// потоков вместе с вызывающим
+struct SamplingOptions {
+    int samples = 2000;
+    int deadlineMs = 0;
+    int threads = 1;
+};
+
+// Стратегия стрельбы бота. Экземпляр хранит свой генератор и не делится
+// между потоками. Новая стратегия - класс-наследник и строка в таблице
+// STRATEGIES в shotstrategy.cpp.
+class ShotStrategy
+{
+public:
+    virtual ~ShotStrategy() = default;
+
+    virtual const char *name() const = 0;
+    // Начало новой партии
+    virtual void newGame() {}
+    // Клетка следующего выстрела (BitBoard::index)
+    virtual int nextShot(const ShotHistory &history) = 0;
+
+    void seed(uint32_t value) { m_rng.seed(value); }
+
+    // Стратегия по имени, nullptr - имя неизвестно
+    static std::unique_ptr<ShotStrategy> create(const std::string &name);
+    // montecarlo с заданными настройками (create дает настройки по умолчанию)
+    static std::unique_ptr<ShotStrategy> createMonteCarlo(const SamplingOptions &options);
+    // withSlow = false - без стратегий, которым на ход нужны миллисекунды
+    static std::vector<std::string> names(bool withSlow = true);
+    static bool isSlow(const std::string &name);
+    static const char *description(const std::string &name);
+
+protected:
+    // Случайная клетка непустой маски
+    int randomCell(const CellMask &mask);
+
+    std::mt19937 m_rng;
+};
+
+#endif // SHOTSTRATEGY_H
@@ -0,0 +1,103 @@
+#include "workstealingpool.h"
+
+WorkStealingPool::WorkStealingPool(int threads) {
+    if (threads < 1) threads = 1;
+    for (int i = 0; i < threads; ++i) m_queues.emplace_back(new Queue());
+    for (int i = 1; i < threads; ++i) m_threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (std::thread &thread : m_threads) thread.join();
+}
+
+int WorkStealingPool::run(int count, const Task &task, Clock::time_point deadline) {
+    if (count <= 0) return 0;
+    const int n = threads();
+    for (int w = 0; w < n; ++w) {
+        Queue &queue = *m_queues[w];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.begin = int(int64_t(count) * w / n);
+        queue.end = int(int64_t(count) * (w + 1) / n);
+    }
+    m_task = &task;
+    m_deadline = deadline;
+    m_completed.store(0, std::memory_order_relaxed);
+    if (n > 1) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_busy = n - 1;
+            ++m_generation;
+        }
+        m_wake.notify_all();
+    }
+
+    drain(0);
+
+    if (n > 1) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return m_busy == 0; });
+    }
+    m_task = nullptr;
+    return m_completed.load(std::memory_order_relaxed);
+}
+
+void WorkStealingPool::workerLoop(int worker) {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_wake.wait(lock, [this, seen] { return m_stop || m_generation != seen; });
+        if (m_stop) return;
+        seen = m_generation;
+        lock.unlock();
+        drain(worker);
+        lock.lock();
+        if (--m_busy == 0) m_done.notify_one();
+    }
+}
+
+void WorkStealingPool::drain(int worker) {
+    int done = 0;
+    int task = 0;
+    while ((done == 0 || Clock::now() < m_deadline) && (take(worker, task) || steal(worker, task))) {
+        (*m_task)(task, worker);
+        ++done;
+    }
+    m_completed.fetch_add(done, std::memory_order_relaxed);
+}
+
+bool WorkStealingPool::take(int worker, int &task) {
+    Queue &queue = *m_queues[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.begin == queue.end) return false;
+    task = queue.begin++;
+    return true;
+}
+
+bool WorkStealingPool::steal(int thief, int &task) {
+    const int n = threads();
+    for (int i = 1; i < n; ++i) {
+        Queue &victim = *m_queues[(thief + i) % n];
+        int begin, end;
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.begin == victim.end) continue;
+            // Старшая половина, последнюю задачу забираем целиком
+            begin = victim.begin + (victim.end - victim.begin) / 2;
+            end = victim.end;
+            victim.end = begin;
+        }
+        // Своя очередь пуста: в нее кладет только сам исполнитель
+        Queue &own = *m_queues[thief];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.begin = begin + 1;
+        own.end = end;
+        task = begin;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,67 @@
+#ifndef WORKSTEALINGPOOL_H
+#define WORKSTEALINGPOOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Пул потоков для пачек однотипных задач с номерами 0..count-1. Каждый
+// исполнитель получает свой отрезок номеров и берет задачи с его начала,
+// опустевший исполнитель забирает себе старшую половину чужого отрезка.
+// Вызывающий поток - исполнитель 0, так что пул из одного исполнителя своих
+// потоков не заводит. Без Qt: подключается к клиенту и утилитам.
+class WorkStealingPool
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    // task - номер задачи, worker - номер исполнителя (0..threads()-1)
+    using Task = std::function<void(int task, int worker)>;
+
+    explicit WorkStealingPool(int threads);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    int threads() const { return int(m_queues.size()); }
+
+    // Выполняет задачи и возвращает число выполненных. После deadline
+    // исполнитель новых задач не берет, но одну задачу успевает выполнить
+    // каждый. Один вызов за раз.
+    int run(int count, const Task &task, Clock::time_point deadline = Clock::time_point::max());
+
+private:
+    // Отрезок еще не взятых задач исполнителя [begin, end)
+    struct Queue {
+        std::mutex mutex;
+        int begin = 0;
+        int end = 0;
+    };
+
+    void workerLoop(int worker);
+    void drain(int worker);
+    bool take(int worker, int &task);
+    bool steal(int thief, int &task);
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    uint64_t m_generation = 0;   // номер вызова run, будит исполнителей
+    int m_busy = 0;              // исполнители, еще не закончившие вызов
+    bool m_stop = false;
+
+    const Task *m_task = nullptr;
+    Clock::time_point m_deadline;
+    std::atomic<int> m_completed{0};
+};
+
+#endif // WORKSTEALINGPOOL_H
@@ -13,12 +13,42 @@ UI_DIR = build/ui
 
 TEMPLATE = app
 
+INCLUDEPATH += ../common
+include(../common/gamecore.pri)
+
+# В release отладочные записи журнала вырезаются при компиляции (Info и выше)
+CONFIG(release, debug|release): DEFINES += LOG_MIN_LEVEL=2
+
 SOURCES += \
     server.cpp \
-    gameserver.cpp
+    gameserver.cpp \
+    gamejournal.cpp \
+    gamereplay.cpp \
+    batchedudpio.cpp \
+    logger.cpp \
+    matchmakinghub.cpp \
+    matchmakingqueue.cpp \
+    servercluster.cpp \
+    servermetrics.cpp \
+    ../common/protocol.cpp \
+    ../common/reliablechannel.cpp
 
 HEADERS += \
-    gameserver.h
+    gameserver.h \
+    gamejournal.h \
+    gamereplay.h \
+    batchedudpio.h \
+    flathashmap.h \
+    logger.h \
+    matchmakinghub.h \
+    matchmakingqueue.h \
+    mpmcqueue.h \
+    peeraddress.h \
+    timingwheel.h \
+    servercluster.h \
+    servermetrics.h \
+    ../common/protocol.h \
+    ../common/reliablechannel.h
 
 TARGET = GameServer
 
@@ -0,0 +1,191 @@
+#include "batchedudpio.h"
+#include "logger.h"
+
+#ifdef Q_OS_LINUX
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+struct BatchedUdpIo::Buffers {
+    // Прием
+    char recvData[BATCH_SIZE][MAX_DATAGRAM_SIZE];
+    iovec recvIov[BATCH_SIZE];
+    sockaddr_in6 recvAddrs[BATCH_SIZE];   // вмещает и sockaddr_in
+    mmsghdr recvMsgs[BATCH_SIZE];
+
+    // Отправка
+    QByteArray sendData[BATCH_SIZE];
+    iovec sendIov[BATCH_SIZE];
+    sockaddr_in6 sendAddrs[BATCH_SIZE];
+    mmsghdr sendMsgs[BATCH_SIZE];
+    int sendCount = 0;
+};
+
+BatchedUdpIo::BatchedUdpIo(QObject *parent) : QObject(parent),
+    m_fd(-1),
+    m_ipv4(false),
+    m_notifier(nullptr),
+    d(new Buffers)
+{
+    std::memset(d->recvMsgs, 0, sizeof(d->recvMsgs));
+    std::memset(d->sendMsgs, 0, sizeof(d->sendMsgs));
+    for (int i = 0; i < BATCH_SIZE; ++i) {
+        d->recvIov[i].iov_base = d->recvData[i];
+        d->recvIov[i].iov_len = MAX_DATAGRAM_SIZE;
+        d->recvMsgs[i].msg_hdr.msg_iov = &d->recvIov[i];
+        d->recvMsgs[i].msg_hdr.msg_iovlen = 1;
+        d->recvMsgs[i].msg_hdr.msg_name = &d->recvAddrs[i];
+
+        d->sendMsgs[i].msg_hdr.msg_iov = &d->sendIov[i];
+        d->sendMsgs[i].msg_hdr.msg_iovlen = 1;
+        d->sendMsgs[i].msg_hdr.msg_name = &d->sendAddrs[i];
+        d->sendMsgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in6);
+    }
+}
+
+BatchedUdpIo::~BatchedUdpIo() {
+    close();
+}
+
+bool BatchedUdpIo::isSupported() {
+    // Ядро без recvmmsg ответит ENOSYS, а не EBADF
+    return ::recvmmsg(-1, nullptr, 0, 0, nullptr) < 0 && errno != ENOSYS;
+}
+
+bool BatchedUdpIo::open(int fd, Handler handler) {
+    close();
+    m_fd = fd;
+    sockaddr_in6 local = {};
+    socklen_t length = sizeof(local);
+    m_ipv4 = ::getsockname(fd, reinterpret_cast<sockaddr *>(&local), &length) == 0 && local.sin6_family == AF_INET;
+    m_handler = std::move(handler);
+    m_notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &BatchedUdpIo::onActivated);
+    return true;
+}
+
+void BatchedUdpIo::close() {
+    if (m_fd < 0) return;
+    flush();
+    delete m_notifier;
+    m_notifier = nullptr;
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+void BatchedUdpIo::onActivated() {
+    for (;;) {
+        for (int i = 0; i < BATCH_SIZE; ++i) {
+            d->recvMsgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in6);
+            d->recvMsgs[i].msg_hdr.msg_flags = 0;
+        }
+
+        const int count = ::recvmmsg(m_fd, d->recvMsgs, BATCH_SIZE, MSG_DONTWAIT, nullptr);
+        if (count < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                LOG_ERROR << "recvmmsg failed:" << strerror(errno);
+            }
+            break;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            const msghdr &hdr = d->recvMsgs[i].msg_hdr;
+            if (hdr.msg_flags & MSG_TRUNC) {
+                LOG_WARNING << "Datagram larger than" << MAX_DATAGRAM_SIZE << "bytes dropped";
+                continue;
+            }
+            const sockaddr_in6 &addr = d->recvAddrs[i];
+            PeerAddress sender;
+            if (m_ipv4) {
+                const sockaddr_in &addr4 = reinterpret_cast<const sockaddr_in &>(addr);
+                sender.ip[10] = 0xff;
+                sender.ip[11] = 0xff;
+                std::memcpy(sender.ip + 12, &addr4.sin_addr, 4);
+                sender.port = ntohs(addr4.sin_port);
+            } else {
+                std::memcpy(sender.ip, &addr.sin6_addr, sizeof(sender.ip));
+                sender.port = ntohs(addr.sin6_port);
+            }
+            m_handler(QByteArray(d->recvData[i], static_cast<int>(d->recvMsgs[i].msg_len)), sender);
+        }
+
+        // Ответы на всю пачку уходят одним системным вызовом
+        flush();
+
+        if (count < BATCH_SIZE) break;
+    }
+}
+
+void BatchedUdpIo::send(const QByteArray &data, const PeerAddress &peer) {
+    if (m_fd < 0) return;
+    if (d->sendCount == BATCH_SIZE) {
+        flush();
+    }
+
+    const int i = d->sendCount++;
+    d->sendData[i] = data;
+    d->sendIov[i].iov_base = const_cast<char *>(d->sendData[i].constData());
+    d->sendIov[i].iov_len = static_cast<size_t>(d->sendData[i].size());
+
+    sockaddr_in6 &addr = d->sendAddrs[i];
+    std::memset(&addr, 0, sizeof(addr));
+    if (m_ipv4) {
+        sockaddr_in &addr4 = reinterpret_cast<sockaddr_in &>(addr);
+        addr4.sin_family = AF_INET;
+        addr4.sin_port = htons(peer.port);
+        std::memcpy(&addr4.sin_addr, peer.ip + 12, 4);
+        d->sendMsgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        return;
+    }
+    addr.sin6_family = AF_INET6;
+    addr.sin6_port = htons(peer.port);
+    // Сокет двухстековый: IPv4-адреса уже лежат в виде ::ffff:a.b.c.d
+    std::memcpy(&addr.sin6_addr, peer.ip, sizeof(addr.sin6_addr));
+    d->sendMsgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_in6);
+}
+
+void BatchedUdpIo::flush() {
+    if (d->sendCount == 0) return;
+    int sent = 0;
+    while (sent < d->sendCount) {
+        const int result = ::sendmmsg(m_fd, d->sendMsgs + sent, d->sendCount - sent, 0);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            // UDP не гарантирует доставку: остаток пачки просто отбрасываем
+            LOG_ERROR << "sendmmsg failed:" << strerror(errno);
+            break;
+        }
+        sent += result;
+    }
+    for (int i = 0; i < d->sendCount; ++i) {
+        d->sendData[i].clear();
+    }
+    d->sendCount = 0;
+    if (m_flushHandler) {
+        m_flushHandler();
+    }
+}
+
+#else // Q_OS_LINUX
+
+struct BatchedUdpIo::Buffers {};
+
+BatchedUdpIo::BatchedUdpIo(QObject *parent) : QObject(parent),
+    m_fd(-1),
+    m_ipv4(false),
+    m_notifier(nullptr)
+{
+}
+
+BatchedUdpIo::~BatchedUdpIo() {}
+
+bool BatchedUdpIo::isSupported() { return false; }
+bool BatchedUdpIo::open(int, Handler) { return false; }
+void BatchedUdpIo::close() {}
+void BatchedUdpIo::onActivated() {}
+void BatchedUdpIo::send(const QByteArray &, const PeerAddress &) {}
+void BatchedUdpIo::flush() {}
+
+#endif // Q_OS_LINUX
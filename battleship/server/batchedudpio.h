@@ -0,0 +1,56 @@
+#ifndef BATCHEDUDPIO_H
+#define BATCHEDUDPIO_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QSocketNotifier>
+#include <functional>
+#include <memory>
+#include "peeraddress.h"
+
+// Пакетный ввод-вывод UDP для Linux: за одно пробуждение сокета забирает до
+// BATCH_SIZE датаграмм одним recvmmsg, а все ответы, накопленные за пачку,
+// отправляет одним sendmmsg. На других системах (или если ядро не знает
+// recvmmsg) isSupported() возвращает false, и сервер работает через QUdpSocket.
+class BatchedUdpIo : public QObject
+{
+    Q_OBJECT
+public:
+    using Handler = std::function<void(const QByteArray &data, const PeerAddress &sender)>;
+    using FlushHandler = std::function<void()>;
+
+    static constexpr int BATCH_SIZE = 64;
+    static constexpr int MAX_DATAGRAM_SIZE = 8192;
+
+    explicit BatchedUdpIo(QObject *parent = nullptr);
+    ~BatchedUdpIo();
+
+    static bool isSupported();
+
+    // Забирает во владение уже привязанный неблокирующий сокет AF_INET6
+    // (двухстековый) или AF_INET, если в системе нет IPv6
+    bool open(int fd, Handler handler);
+    void close();
+    bool isOpen() const { return m_fd >= 0; }
+
+    // Ставит датаграмму в очередь; очередь уходит при flush() или когда заполнится
+    void send(const QByteArray &data, const PeerAddress &peer);
+    void flush();
+    // Вызывается после каждой непустой отправки очереди
+    void setFlushHandler(FlushHandler handler) { m_flushHandler = std::move(handler); }
+
+private slots:
+    void onActivated();
+
+private:
+    struct Buffers;
+
+    int m_fd;
+    bool m_ipv4;   // сокет AF_INET: адреса пересчитываются в ::ffff:a.b.c.d
+    QSocketNotifier *m_notifier;
+    Handler m_handler;
+    FlushHandler m_flushHandler;
+    std::unique_ptr<Buffers> d;
+};
+
+#endif // BATCHEDUDPIO_H
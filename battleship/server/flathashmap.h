@@ -0,0 +1,189 @@
+#ifndef FLATHASHMAP_H
+#define FLATHASHMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// Хеш-таблица с открытой адресацией и линейным пробированием. Ключи,
+// значения и хеши лежат в плоских массивах без узлов на каждую запись,
+// поэтому поиск обычно укладывается в одну-две кэш-линии. Удаление
+// сдвигает следующие записи назад вместо "надгробий", так что цепочки
+// не деградируют при постоянной смене записей.
+//
+// Ссылки и указатели на значения действительны только до следующей вставки
+// или удаления: таблица может перестроиться или сдвинуть записи. Для
+// долгоживущих ссылок нужно хранить ключ (или номер слота, как у клиентов).
+// Хешер для ключей, у которых есть qHash (находится по ADL, так что сам
+// заголовок от Qt не зависит)
+struct QtKeyHash {
+    template <typename K>
+    size_t operator()(const K &key) const { return qHash(key); }
+};
+
+template <typename Key, typename T, typename Hash = std::hash<Key>>
+class FlatHashMap {
+public:
+    struct Entry {
+        Key key;
+        T value;
+    };
+
+    class iterator {
+    public:
+        iterator(FlatHashMap *map, size_t index) : m_map(map), m_index(index) { skip(); }
+        Entry &operator*() const { return m_map->m_entries[m_index]; }
+        Entry *operator->() const { return &m_map->m_entries[m_index]; }
+        iterator &operator++() { ++m_index; skip(); return *this; }
+        bool operator==(const iterator &other) const { return m_index == other.m_index; }
+        bool operator!=(const iterator &other) const { return m_index != other.m_index; }
+    private:
+        void skip() {
+            while (m_index < m_map->m_hashes.size() && m_map->m_hashes[m_index] == EMPTY) ++m_index;
+        }
+        FlatHashMap *m_map;
+        size_t m_index;
+    };
+
+    FlatHashMap() = default;
+
+    size_t size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+    size_t capacity() const { return m_hashes.size(); }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, m_hashes.size()); }
+
+    void clear() {
+        m_hashes.clear();
+        m_entries.clear();
+        m_size = 0;
+    }
+
+    void reserve(size_t count) {
+        size_t needed = MIN_CAPACITY;
+        while (needed * MAX_LOAD_NUM < count * MAX_LOAD_DEN) needed <<= 1;
+        if (needed > m_hashes.size()) rehash(needed);
+    }
+
+    T *find(const Key &key) {
+        const size_t index = lookup(key);
+        return index == NPOS ? nullptr : &m_entries[index].value;
+    }
+    const T *find(const Key &key) const {
+        const size_t index = lookup(key);
+        return index == NPOS ? nullptr : &m_entries[index].value;
+    }
+
+    bool contains(const Key &key) const { return lookup(key) != NPOS; }
+
+    T value(const Key &key, const T &defaultValue = T()) const {
+        const T *found = find(key);
+        return found ? *found : defaultValue;
+    }
+
+    // Вставка или замена значения
+    T &insert(const Key &key, T value) {
+        T &slot = (*this)[key];
+        slot = std::move(value);
+        return slot;
+    }
+
+    // Значение по ключу, отсутствующий ключ вставляется. Таблица растет только
+    // при вставке: поиск существующего ключа записи не двигает
+    T &operator[](const Key &key) {
+        const size_t found = lookup(key);
+        if (found != NPOS) return m_entries[found].value;
+
+        if ((m_size + 1) * MAX_LOAD_DEN > m_hashes.size() * MAX_LOAD_NUM) {
+            rehash(m_hashes.empty() ? MIN_CAPACITY : m_hashes.size() * 2);
+        }
+        const uint32_t hash = hashOf(key);
+        const size_t mask = m_hashes.size() - 1;
+        size_t i = bucket(hash);
+        while (m_hashes[i] != EMPTY) i = (i + 1) & mask;
+        m_hashes[i] = hash;
+        m_entries[i].key = key;
+        m_entries[i].value = T();
+        ++m_size;
+        return m_entries[i].value;
+    }
+
+    bool remove(const Key &key) {
+        size_t hole = lookup(key);
+        if (hole == NPOS) return false;
+
+        // Обратный сдвиг: записи за дыркой, которым она ближе к их
+        // идеальному бакету, переезжают в нее
+        const size_t mask = m_hashes.size() - 1;
+        for (size_t i = (hole + 1) & mask; m_hashes[i] != EMPTY; i = (i + 1) & mask) {
+            const size_t ideal = bucket(m_hashes[i]);
+            if (((i - ideal) & mask) >= ((i - hole) & mask)) {
+                m_hashes[hole] = m_hashes[i];
+                m_entries[hole] = std::move(m_entries[i]);
+                hole = i;
+            }
+        }
+        m_hashes[hole] = EMPTY;
+        m_entries[hole] = Entry();
+        --m_size;
+        return true;
+    }
+
+private:
+    static constexpr uint32_t EMPTY = 0;
+    static constexpr size_t NPOS = size_t(-1);
+    static constexpr size_t MIN_CAPACITY = 16;
+    // Максимальная загрузка 3/4: дальше линейное пробирование быстро
+    // удлиняет цепочки промахов
+    static constexpr size_t MAX_LOAD_NUM = 3;
+    static constexpr size_t MAX_LOAD_DEN = 4;
+
+    uint32_t hashOf(const Key &key) const {
+        // Фибоначчиево перемешивание: слабые хеши (например, qHash от
+        // соседних чисел) равномерно расходятся по старшим битам
+        const uint64_t h = uint64_t(m_hash(key)) * 0x9E3779B97F4A7C15ull;
+        const uint32_t folded = uint32_t(h >> 32);
+        return folded == EMPTY ? 1 : folded;
+    }
+
+    size_t bucket(uint32_t hash) const {
+        // Старшие биты перемешанного хеша лучше младших
+        return size_t((uint64_t(hash) * m_hashes.size()) >> 32);
+    }
+
+    size_t lookup(const Key &key) const {
+        if (m_size == 0) return NPOS;
+        const uint32_t hash = hashOf(key);
+        const size_t mask = m_hashes.size() - 1;
+        for (size_t i = bucket(hash); m_hashes[i] != EMPTY; i = (i + 1) & mask) {
+            if (m_hashes[i] == hash && m_entries[i].key == key) return i;
+        }
+        return NPOS;
+    }
+
+    void rehash(size_t newCapacity) {
+        std::vector<uint32_t> oldHashes(newCapacity, EMPTY);
+        std::vector<Entry> oldEntries(newCapacity);
+        oldHashes.swap(m_hashes);
+        oldEntries.swap(m_entries);
+
+        const size_t mask = newCapacity - 1;
+        for (size_t j = 0; j < oldHashes.size(); ++j) {
+            if (oldHashes[j] == EMPTY) continue;
+            size_t i = bucket(oldHashes[j]);
+            while (m_hashes[i] != EMPTY) i = (i + 1) & mask;
+            m_hashes[i] = oldHashes[j];
+            m_entries[i] = std::move(oldEntries[j]);
+        }
+    }
+
+    std::vector<uint32_t> m_hashes;   // 0 - свободный бакет
+    std::vector<Entry> m_entries;
+    size_t m_size = 0;
+    Hash m_hash;
+};
+
+#endif // FLATHASHMAP_H
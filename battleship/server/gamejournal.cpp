@@ -0,0 +1,491 @@
+#include "gamejournal.h"
+#include "logger.h"
+#include <QFile>
+#include <QtEndian>
+#include <chrono>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace {
+
+// CRC32C (Castagnoli), табличный вариант
+quint32 crc32c(const char *data, int size) {
+    static const struct Table {
+        quint32 entries[256];
+        Table() {
+            for (quint32 i = 0; i < 256; ++i) {
+                quint32 crc = i;
+                for (int bit = 0; bit < 8; ++bit) {
+                    crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1u)));
+                }
+                entries[i] = crc;
+            }
+        }
+    } table;
+
+    quint32 crc = ~0u;
+    for (int i = 0; i < size; ++i) {
+        crc = table.entries[(crc ^ quint8(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+class RecordWriter {
+public:
+    explicit RecordWriter(char *out) : m_out(out) {}
+
+    void u8(quint8 v) { m_out[m_pos++] = char(v); }
+    void u32(quint32 v) {
+        qToLittleEndian(v, m_out + m_pos);
+        m_pos += sizeof(v);
+    }
+    void u64(quint64 v) {
+        qToLittleEndian(v, m_out + m_pos);
+        m_pos += sizeof(v);
+    }
+    void str(const QString &s) {
+        const QByteArray utf8 = s.toUtf8();
+        const quint16 len = quint16(qMin(utf8.size(), 0xFFFF));
+        qToLittleEndian(len, m_out + m_pos);
+        std::memcpy(m_out + m_pos + 2, utf8.constData(), len);
+        m_pos += 2 + len;
+    }
+    void mask(const CellMask &m) {
+        for (quint64 word : m.words) u64(word);
+    }
+    void board(const BitBoard &b) {
+        mask(b.ships());
+        mask(b.hits());
+        mask(b.misses());
+    }
+
+    int size() const { return m_pos; }
+
+    // Верхняя граница размера тела: UTF-8 не длиннее трех байт на символ UTF-16
+    static int bound(const JournalRecord &r) {
+        const int strings = r.token.size() + r.otherToken.size() + r.lobbyId.size() + r.username.size();
+        return 1 + 4 * 2 + 3 * strings + 2 * BOARD_SIZE + 4 + 4;
+    }
+
+    static constexpr int BOARD_SIZE = 3 * 16;
+
+private:
+    char *m_out;
+    int m_pos = 0;
+};
+
+class RecordReader {
+public:
+    RecordReader(const char *data, int size) : m_data(data), m_size(size) {}
+
+    bool u8(quint8 &v) {
+        if (m_pos + 1 > m_size) return false;
+        v = quint8(m_data[m_pos++]);
+        return true;
+    }
+    bool flag(bool &v) {
+        quint8 b;
+        if (!u8(b)) return false;
+        v = b != 0;
+        return true;
+    }
+    bool coord(int &v) {
+        quint8 b;
+        if (!u8(b)) return false;
+        v = b;
+        return true;
+    }
+    bool u32(quint32 &v) {
+        if (m_pos + int(sizeof(v)) > m_size) return false;
+        v = qFromLittleEndian<quint32>(m_data + m_pos);
+        m_pos += sizeof(v);
+        return true;
+    }
+    bool u64(quint64 &v) {
+        if (m_pos + int(sizeof(v)) > m_size) return false;
+        v = qFromLittleEndian<quint64>(m_data + m_pos);
+        m_pos += sizeof(v);
+        return true;
+    }
+    bool str(QString &s) {
+        if (m_pos + 2 > m_size) return false;
+        const quint16 len = qFromLittleEndian<quint16>(m_data + m_pos);
+        m_pos += 2;
+        if (m_pos + len > m_size) return false;
+        s = QString::fromUtf8(m_data + m_pos, len);
+        m_pos += len;
+        return true;
+    }
+    bool mask(CellMask &m) {
+        for (uint64_t &word : m.words) {
+            quint64 v;
+            if (!u64(v)) return false;
+            word = v;
+        }
+        return true;
+    }
+    bool board(BitBoard &b) {
+        CellMask ships, hits, misses;
+        if (!mask(ships) || !mask(hits) || !mask(misses)) return false;
+        b.restore(ships, hits, misses);
+        return true;
+    }
+    bool atEnd() const { return m_pos == m_size; }
+
+private:
+    const char *m_data;
+    int m_size;
+    int m_pos = 0;
+};
+
+void encodeRecord(RecordWriter &out, const JournalRecord &r) {
+    using Type = JournalRecord::Type;
+    out.u8(quint8(r.type));
+    switch (r.type) {
+    case Type::Login:
+        out.str(r.token);
+        out.str(r.username);
+        break;
+    case Type::Board:
+        out.str(r.token);
+        out.board(r.board);
+        break;
+    case Type::LobbyCreated:
+    case Type::GameStart:
+        out.str(r.lobbyId);
+        out.str(r.token);
+        out.board(r.board);
+        break;
+    case Type::Shot:
+        out.str(r.lobbyId);
+        out.u8(r.player1);
+        out.u8(quint8(r.x));
+        out.u8(quint8(r.y));
+        break;
+    case Type::TurnChange:
+        out.str(r.lobbyId);
+        out.u8(r.player1);
+        break;
+    case Type::LobbyClosed:
+        out.str(r.lobbyId);
+        break;
+    case Type::Reconnect:
+        out.str(r.token);
+        out.str(r.otherToken);
+        break;
+    case Type::ClientReleased:
+        out.str(r.token);
+        break;
+    case Type::ClientState:
+        out.str(r.token);
+        out.str(r.username);
+        out.board(r.board);
+        break;
+    case Type::LobbyState:
+        out.str(r.lobbyId);
+        out.str(r.token);
+        out.str(r.otherToken);
+        out.board(r.board);
+        out.board(r.otherBoard);
+        out.u8(r.active);
+        out.u8(r.player1);
+        break;
+    case Type::SnapshotEnd:
+        out.u32(r.sequence);
+        break;
+    }
+}
+
+bool decodeRecord(RecordReader &in, JournalRecord &r) {
+    using Type = JournalRecord::Type;
+    quint8 type;
+    if (!in.u8(type)) return false;
+    r = JournalRecord();
+    r.type = Type(type);
+    bool ok = false;
+    switch (r.type) {
+    case Type::Login:
+        ok = in.str(r.token) && in.str(r.username);
+        break;
+    case Type::Board:
+        ok = in.str(r.token) && in.board(r.board);
+        break;
+    case Type::LobbyCreated:
+    case Type::GameStart:
+        ok = in.str(r.lobbyId) && in.str(r.token) && in.board(r.board);
+        break;
+    case Type::Shot:
+        ok = in.str(r.lobbyId) && in.flag(r.player1) && in.coord(r.x) && in.coord(r.y);
+        break;
+    case Type::TurnChange:
+        ok = in.str(r.lobbyId) && in.flag(r.player1);
+        break;
+    case Type::LobbyClosed:
+        ok = in.str(r.lobbyId);
+        break;
+    case Type::Reconnect:
+        ok = in.str(r.token) && in.str(r.otherToken);
+        break;
+    case Type::ClientReleased:
+        ok = in.str(r.token);
+        break;
+    case Type::ClientState:
+        ok = in.str(r.token) && in.str(r.username) && in.board(r.board);
+        break;
+    case Type::LobbyState:
+        ok = in.str(r.lobbyId) && in.str(r.token) && in.str(r.otherToken)
+            && in.board(r.board) && in.board(r.otherBoard)
+            && in.flag(r.active) && in.flag(r.player1);
+        break;
+    case Type::SnapshotEnd:
+        ok = in.u32(r.sequence);
+        break;
+    }
+    return ok && in.atEnd();
+}
+
+} // namespace
+
+GameJournal::GameJournal() :
+    m_fd(-1),
+    m_data(nullptr),
+    m_capacity(0),
+    m_end(0),
+    m_appended(0),
+    m_published(0),
+    m_syncs(0),
+    m_stopping(false)
+{
+}
+
+GameJournal::~GameJournal() {
+    close();
+}
+
+bool GameJournal::open(const QString &path, const ReplayHandler &replay) {
+    close();
+    if (!openFile(path, replay)) {
+        closeFile();
+        return false;
+    }
+    startSync();
+    return true;
+}
+
+void GameJournal::close() {
+    stopSync();
+    closeFile();
+}
+
+void GameJournal::append(const JournalRecord &record) {
+    if (m_fd < 0) return;
+    if (!reserve(RECORD_HEADER_SIZE + RecordWriter::bound(record))) {
+        LOG_ERROR << "Journal" << m_path << "cannot grow, record dropped";
+        return;
+    }
+    char *out = m_data + m_end;
+    RecordWriter body(out + RECORD_HEADER_SIZE);
+    encodeRecord(body, record);
+    qToLittleEndian(quint32(body.size()), out);
+    qToLittleEndian(crc32c(out + RECORD_HEADER_SIZE, body.size()), out + 4);
+    m_end += RECORD_HEADER_SIZE + body.size();
+    ++m_appended;
+    m_published.store(m_end, std::memory_order_release);
+}
+
+bool GameJournal::reserve(qint64 bytes) {
+    if (m_end + bytes <= m_capacity) return true;
+    return resize(qMax(m_capacity + GROW_STEP, (m_end + bytes + GROW_STEP - 1) / GROW_STEP * GROW_STEP));
+}
+
+void GameJournal::startSync() {
+    m_stopping = false;
+    m_published.store(m_end, std::memory_order_relaxed);
+    m_syncThread = std::thread([this]() { syncLoop(); });
+}
+
+void GameJournal::stopSync() {
+    if (!m_syncThread.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_one();
+    m_syncThread.join();
+}
+
+JournalImage::JournalImage() :
+    m_data(GameJournal::HEADER_SIZE, '\0')
+{
+    qToLittleEndian(GameJournal::MAGIC, m_data.data());
+    qToLittleEndian(GameJournal::VERSION, m_data.data() + 4);
+}
+
+void JournalImage::append(const JournalRecord &record) {
+    const int start = m_data.size();
+    m_data.resize(start + GameJournal::RECORD_HEADER_SIZE + RecordWriter::bound(record));
+    char *out = m_data.data() + start;
+    RecordWriter body(out + GameJournal::RECORD_HEADER_SIZE);
+    encodeRecord(body, record);
+    qToLittleEndian(quint32(body.size()), out);
+    qToLittleEndian(crc32c(out + GameJournal::RECORD_HEADER_SIZE, body.size()), out + 4);
+    m_data.resize(start + GameJournal::RECORD_HEADER_SIZE + body.size());
+}
+
+#ifdef Q_OS_LINUX
+
+bool GameJournal::isSupported() { return true; }
+
+bool GameJournal::openFile(const QString &path, const ReplayHandler &replay) {
+    m_path = path;
+    m_fd = ::open(QFile::encodeName(path).constData(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        LOG_ERROR << "Cannot open journal" << path << ":" << strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if (::fstat(m_fd, &st) < 0) {
+        LOG_ERROR << "Cannot stat journal" << path << ":" << strerror(errno);
+        return false;
+    }
+
+    if (st.st_size < HEADER_SIZE) {
+        // Новый журнал
+        if (!resize(GROW_STEP)) return false;
+        qToLittleEndian(MAGIC, m_data);
+        qToLittleEndian(VERSION, m_data + 4);
+        m_end = HEADER_SIZE;
+        return true;
+    }
+
+    if (!resize(st.st_size)) return false;
+    if (qFromLittleEndian<quint32>(m_data) != MAGIC || qFromLittleEndian<quint32>(m_data + 4) != VERSION) {
+        LOG_ERROR << path << "is not a game journal or has an unsupported version";
+        return false;
+    }
+
+    qint64 pos = HEADER_SIZE;
+    bool damaged = false;
+    while (pos + RECORD_HEADER_SIZE <= m_capacity) {
+        const quint32 size = qFromLittleEndian<quint32>(m_data + pos);
+        if (size == 0) break;
+        const char *body = m_data + pos + RECORD_HEADER_SIZE;
+        JournalRecord record;
+        RecordReader in(body, int(size));
+        if (pos + RECORD_HEADER_SIZE + size > m_capacity
+            || crc32c(body, int(size)) != qFromLittleEndian<quint32>(m_data + pos + 4)
+            || !decodeRecord(in, record)) {
+            damaged = true;
+            break;
+        }
+        if (replay) replay(record);
+        pos += RECORD_HEADER_SIZE + size;
+    }
+    if (damaged) {
+        // Запись, оборванная падением: она и все за ней отбрасываются
+        LOG_WARNING << "Journal" << path << "has a damaged record at offset" << pos << ", tail dropped";
+        std::memset(m_data + pos, 0, size_t(m_capacity - pos));
+    }
+    m_end = pos;
+    return true;
+}
+
+void GameJournal::closeFile() {
+    if (m_data) {
+        ::munmap(m_data, size_t(m_capacity));
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+    m_fd = -1;
+    m_data = nullptr;
+    m_capacity = 0;
+    m_end = 0;
+}
+
+bool GameJournal::resize(qint64 capacity) {
+    if (capacity > m_capacity && ::ftruncate(m_fd, capacity) < 0) {
+        LOG_ERROR << "Cannot extend journal" << m_path << ":" << strerror(errno);
+        return false;
+    }
+    void *data = m_data
+        ? ::mremap(m_data, size_t(m_capacity), size_t(capacity), MREMAP_MAYMOVE)
+        : ::mmap(nullptr, size_t(capacity), PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (data == MAP_FAILED) {
+        LOG_ERROR << "Cannot map journal" << m_path << ":" << strerror(errno);
+        return false;
+    }
+    m_data = static_cast<char *>(data);
+    m_capacity = capacity;
+    return true;
+}
+
+bool JournalImage::write(const char *tmpPath, const char *path, const char *dirPath) const {
+    const int fd = ::open(tmpPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    const char *data = m_data.constData();
+    size_t left = size_t(m_data.size());
+    while (left > 0) {
+        const ssize_t written = ::write(fd, data, left);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) {
+            ::close(fd);
+            return false;
+        }
+        data += written;
+        left -= size_t(written);
+    }
+    // Файл должен лечь на диск раньше, чем заменит прежний
+    const bool ok = ::fdatasync(fd) == 0;
+    ::close(fd);
+    if (!ok || ::rename(tmpPath, path) != 0) return false;
+    const int dir = ::open(dirPath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir >= 0) {
+        ::fsync(dir);
+        ::close(dir);
+    }
+    return true;
+}
+
+void GameJournal::syncLoop() {
+    qint64 synced = m_published.load(std::memory_order_acquire);
+    for (;;) {
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait_for(lock, std::chrono::milliseconds(SYNC_INTERVAL_MS), [this]() { return m_stopping; });
+            stopping = m_stopping;
+        }
+        // Все записи за интервал фиксируются одним вызовом
+        const qint64 target = m_published.load(std::memory_order_acquire);
+        if (target > synced) {
+            ::fdatasync(m_fd);
+            synced = target;
+            m_syncs.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (stopping) break;
+    }
+}
+
+#else // Q_OS_LINUX
+
+bool GameJournal::isSupported() { return false; }
+
+bool GameJournal::openFile(const QString &path, const ReplayHandler &) {
+    LOG_ERROR << "Game journal" << path << "requires Linux";
+    return false;
+}
+
+void GameJournal::closeFile() {}
+bool GameJournal::resize(qint64) { return false; }
+void GameJournal::syncLoop() {}
+bool JournalImage::write(const char *, const char *, const char *) const { return false; }
+
+#endif // Q_OS_LINUX
@@ -0,0 +1,219 @@
+#ifndef GAMEJOURNAL_H
+#define GAMEJOURNAL_H
+
+#include <QString>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "bitboard.h"
+
+// Событие, меняющее состояние игры. Клиенты названы токенами: номера
+// ClientHandle после перезапуска выдаются заново.
+struct JournalRecord {
+    enum class Type : quint8 {
+        Login = 1,       // token, username
+        Board,           // token, board
+        LobbyCreated,    // lobbyId, token - первый игрок, board
+        GameStart,       // lobbyId, token - второй игрок, board
+        Shot,            // lobbyId, player1 - стрелял первый игрок, x, y
+        TurnChange,      // lobbyId, player1 - ход у первого игрока
+        LobbyClosed,     // lobbyId
+        Reconnect,       // token - новый, otherToken - прежний
+        ClientReleased,  // token
+        // Снимок состояния: записи состояния и метка конца снимка
+        ClientState,     // token, username, board
+        LobbyState,      // lobbyId, token, otherToken, board, otherBoard, active, player1
+        SnapshotEnd      // sequence - первый сегмент журнала, не вошедший в снимок
+    };
+
+    Type type = Type::Login;
+    QString token;
+    QString otherToken;
+    QString lobbyId;
+    QString username;
+    BitBoard board;
+    BitBoard otherBoard;
+    int x = 0;
+    int y = 0;
+    quint32 sequence = 0;
+    bool player1 = false;
+    bool active = false;
+
+    static JournalRecord login(const QString &token, const QString &username) {
+        JournalRecord r(Type::Login);
+        r.token = token;
+        r.username = username;
+        return r;
+    }
+    static JournalRecord boardSaved(const QString &token, const BitBoard &board) {
+        JournalRecord r(Type::Board);
+        r.token = token;
+        r.board = board;
+        return r;
+    }
+    static JournalRecord lobbyCreated(const QString &lobbyId, const QString &token, const BitBoard &board) {
+        JournalRecord r(Type::LobbyCreated);
+        r.lobbyId = lobbyId;
+        r.token = token;
+        r.board = board;
+        return r;
+    }
+    static JournalRecord gameStart(const QString &lobbyId, const QString &token, const BitBoard &board) {
+        JournalRecord r(Type::GameStart);
+        r.lobbyId = lobbyId;
+        r.token = token;
+        r.board = board;
+        return r;
+    }
+    static JournalRecord shot(const QString &lobbyId, bool player1, int x, int y) {
+        JournalRecord r(Type::Shot);
+        r.lobbyId = lobbyId;
+        r.player1 = player1;
+        r.x = x;
+        r.y = y;
+        return r;
+    }
+    static JournalRecord turnChange(const QString &lobbyId, bool player1) {
+        JournalRecord r(Type::TurnChange);
+        r.lobbyId = lobbyId;
+        r.player1 = player1;
+        return r;
+    }
+    static JournalRecord lobbyClosed(const QString &lobbyId) {
+        JournalRecord r(Type::LobbyClosed);
+        r.lobbyId = lobbyId;
+        return r;
+    }
+    static JournalRecord reconnect(const QString &token, const QString &oldToken) {
+        JournalRecord r(Type::Reconnect);
+        r.token = token;
+        r.otherToken = oldToken;
+        return r;
+    }
+    static JournalRecord clientReleased(const QString &token) {
+        JournalRecord r(Type::ClientReleased);
+        r.token = token;
+        return r;
+    }
+
+    static JournalRecord clientState(const QString &token, const QString &username, const BitBoard &board) {
+        JournalRecord r(Type::ClientState);
+        r.token = token;
+        r.username = username;
+        r.board = board;
+        return r;
+    }
+    static JournalRecord lobbyState(const QString &lobbyId, const QString &player1Token, const QString &player2Token,
+                                    const BitBoard &player1Board, const BitBoard &player2Board,
+                                    bool active, bool player1Turn) {
+        JournalRecord r(Type::LobbyState);
+        r.lobbyId = lobbyId;
+        r.token = player1Token;
+        r.otherToken = player2Token;
+        r.board = player1Board;
+        r.otherBoard = player2Board;
+        r.active = active;
+        r.player1 = player1Turn;
+        return r;
+    }
+    static JournalRecord snapshotEnd(quint32 nextSegment) {
+        JournalRecord r(Type::SnapshotEnd);
+        r.sequence = nextSegment;
+        return r;
+    }
+
+    JournalRecord() = default;
+    explicit JournalRecord(Type t) : type(t) {}
+};
+
+// Журнал событий для восстановления после падения. Записи дописываются в
+// отображенный в память файл, каждая со своей CRC32C, поэтому оборванный
+// при падении хвост отбрасывается при чтении. Запись - копирование в
+// отображение без системных вызовов. На диск данные сбрасывает отдельный
+// поток: раз в SYNC_INTERVAL_MS один fdatasync фиксирует все записи,
+// добавленные с прошлого сброса (групповая фиксация). Падение процесса не
+// теряет ничего - страницы отображения уже в кеше ядра; при падении самой
+// системы теряются записи последнего интервала.
+//
+//   файл:   [заголовок 16 байт][запись]...[нули до конца файла]
+//   запись: [u32 длина тела][u32 crc32c тела][тело]
+//
+// Тот же формат служит для снимков состояния, их собирает JournalImage.
+//
+// Только Linux (mremap); на других системах open() возвращает false.
+class GameJournal
+{
+public:
+    using ReplayHandler = std::function<void(const JournalRecord &record)>;
+
+    static constexpr quint32 MAGIC = 0x4A425342;   // "BSBJ"
+    static constexpr quint32 VERSION = 1;
+    static constexpr int HEADER_SIZE = 16;
+    static constexpr int RECORD_HEADER_SIZE = 8;
+    static constexpr qint64 GROW_STEP = qint64(4) << 20;
+    static constexpr int SYNC_INTERVAL_MS = 10;    // период групповой фиксации
+
+    GameJournal();
+    ~GameJournal();
+
+    static bool isSupported();
+
+    // Открывает журнал (пустой создается) и отдает целые записи в replay
+    bool open(const QString &path, const ReplayHandler &replay = ReplayHandler());
+    void close();
+    bool isOpen() const { return m_fd >= 0; }
+
+    void append(const JournalRecord &record);
+
+    qint64 size() const { return m_end; }
+    quint64 appendedRecords() const { return m_appended; }
+    quint64 syncCount() const { return m_syncs.load(std::memory_order_relaxed); }
+
+private:
+    bool openFile(const QString &path, const ReplayHandler &replay);
+    void closeFile();
+    bool reserve(qint64 bytes);
+    bool resize(qint64 capacity);
+    void startSync();
+    void stopSync();
+    void syncLoop();
+
+    QString m_path;
+    int m_fd;
+    char *m_data;
+    qint64 m_capacity;
+    qint64 m_end;
+    quint64 m_appended;
+
+    // Поток сброса
+    std::thread m_syncThread;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::atomic<qint64> m_published;   // конец последней целой записи
+    std::atomic<quint64> m_syncs;
+    bool m_stopping;
+};
+
+// Файл журнала целиком в памяти, в том же формате. Снимок собирается в
+// главном потоке, а пишет его дочерний процесс после fork: там допустимы
+// только системные вызовы, поэтому write() не выделяет память, не берет
+// блокировок и не пишет в лог.
+class JournalImage
+{
+public:
+    JournalImage();
+
+    void append(const JournalRecord &record);
+    int size() const { return m_data.size(); }
+
+    // Пишет образ в tmpPath, сбрасывает на диск и атомарно переименовывает
+    // в path, затем фиксирует каталог dirPath. Пути - уже в кодировке ФС.
+    bool write(const char *tmpPath, const char *path, const char *dirPath) const;
+
+private:
+    QByteArray m_data;
+};
+
+#endif // GAMEJOURNAL_H
@@ -0,0 +1,253 @@
+#include "gamereplay.h"
+#include "logger.h"
+#include <QIODevice>
+#include <QtEndian>
+
+namespace {
+
+constexpr int MAX_VARINT_BYTES = 10;
+
+void putVarint(QByteArray &out, quint64 v) {
+    while (v >= 0x80) {
+        out.append(char(quint8(v) | 0x80));
+        v >>= 7;
+    }
+    out.append(char(v));
+}
+
+// Число прочитанных байт, 0 - число оборвано или длиннее 64 бит
+int getVarint(const char *data, int size, quint64 &v) {
+    v = 0;
+    for (int i = 0; i < size && i < MAX_VARINT_BYTES; ++i) {
+        const quint8 b = quint8(data[i]);
+        v |= quint64(b & 0x7F) << (7 * i);
+        if (!(b & 0x80)) return i + 1;
+    }
+    return 0;
+}
+
+void putMask(QByteArray &out, const CellMask &mask) {
+    char bytes[GameReplay::MASK_BYTES] = {};
+    for (int i = 0; i < CellMask::BITS; ++i) {
+        if (mask.test(i)) bytes[i / 8] |= char(1 << (i % 8));
+    }
+    out.append(bytes, GameReplay::MASK_BYTES);
+}
+
+CellMask getMask(const char *data) {
+    CellMask mask;
+    for (int i = 0; i < CellMask::BITS; ++i) {
+        if (quint8(data[i / 8]) & (1 << (i % 8))) mask.set(i);
+    }
+    return mask;
+}
+
+} // namespace
+
+void GameReplay::appendTo(QByteArray &out) const {
+    out.append(char(outcome));
+    putVarint(out, quint64(startedAt));
+    putMask(out, player1Ships);
+    putMask(out, player2Ships);
+    putVarint(out, quint64(moves.size()));
+    // Время хранится с точностью TIME_UNIT_MS, паузы считаются от округленного
+    // времени прошлого хода, чтобы ошибка не накапливалась
+    quint32 previous = 0;
+    for (const ReplayMove &move : moves) {
+        out.append(char(move.cell | (move.player1 ? 0x80 : 0)));
+        const quint32 units = move.atMs / TIME_UNIT_MS;
+        putVarint(out, units - qMin(units, previous));
+        previous = qMax(units, previous);
+    }
+}
+
+bool GameReplay::decode(const char *data, int size) {
+    int pos = 0;
+    quint64 value;
+    int used;
+    if (size < 1 || quint8(data[0]) > quint8(Outcome::Abandoned)) return false;
+    outcome = Outcome(data[0]);
+    pos = 1;
+
+    if (!(used = getVarint(data + pos, size - pos, value))) return false;
+    startedAt = qint64(value);
+    pos += used;
+    if (pos + 2 * MASK_BYTES > size) return false;
+    player1Ships = getMask(data + pos);
+    player2Ships = getMask(data + pos + MASK_BYTES);
+    pos += 2 * MASK_BYTES;
+
+    if (!(used = getVarint(data + pos, size - pos, value))) return false;
+    pos += used;
+    // Ход занимает не меньше двух байт
+    if (value > quint64(size - pos) / 2) return false;
+    moves.clear();
+    moves.reserve(int(value));
+    quint64 units = 0;
+    for (quint64 i = 0; i < value; ++i) {
+        if (pos >= size) return false;
+        ReplayMove move;
+        move.cell = quint8(data[pos]) & 0x7F;
+        move.player1 = quint8(data[pos]) & 0x80;
+        ++pos;
+        quint64 pause;
+        if (!(used = getVarint(data + pos, size - pos, pause))) return false;
+        pos += used;
+        units += pause;
+        move.atMs = quint32(units * TIME_UNIT_MS);
+        moves.append(move);
+    }
+    return pos == size;
+}
+
+ReplayVerdict simulateReplay(const GameReplay &replay) {
+    ReplayVerdict verdict;
+    auto fail = [&verdict](const char *error) {
+        verdict.valid = false;
+        verdict.error = error;
+        return verdict;
+    };
+
+    BitBoard boards[2];
+    boards[0].setShips(replay.player1Ships);
+    boards[1].setShips(replay.player2Ships);
+    FleetIndex fleets[2];
+    if (!fleets[0].build(replay.player1Ships) || !fleets[0].isFullFleet()
+        || !fleets[1].build(replay.player2Ships) || !fleets[1].isFullFleet()) {
+        return fail("invalid fleet");
+    }
+
+    // Правила те же, что в GameServer::processShotResult: первым ходит первый
+    // игрок, попадание оставляет ход за стрелявшим
+    bool player1Turn = true;
+    int winner = -1;
+    for (const ReplayMove &move : replay.moves) {
+        if (winner >= 0) return fail("move after the game was over");
+        if (move.player1 != player1Turn) return fail("move out of turn");
+        const int shooter = move.player1 ? 0 : 1;
+        if (move.isPass()) {
+            ++verdict.passes[shooter];
+            player1Turn = !player1Turn;
+            continue;
+        }
+        if (move.cell >= BitBoard::CELL_COUNT) return fail("shot outside the board");
+
+        const int x = move.cell % BitBoard::WIDTH;
+        const int y = move.cell / BitBoard::WIDTH;
+        BitBoard &target = boards[1 - shooter];
+        FleetIndex &fleet = fleets[1 - shooter];
+        ++verdict.shots[shooter];
+        if (target.cell(x, y) == BitBoard::HIT || target.cell(x, y) == BitBoard::MISS) {
+            ++verdict.repeats[shooter];
+        }
+        if (!target.shoot(x, y)) {
+            player1Turn = !player1Turn;
+            continue;
+        }
+        ++verdict.hits[shooter];
+        if (fleet.hit(move.cell)) {
+            ++verdict.sunkShips[shooter];
+            if (fleet.shipsLeft() == 0) winner = shooter;
+        }
+    }
+
+    const GameReplay::Outcome expected = winner < 0 ? GameReplay::Outcome::Abandoned
+        : winner == 0 ? GameReplay::Outcome::Player1Won : GameReplay::Outcome::Player2Won;
+    if (replay.outcome != expected) return fail("outcome does not match the moves");
+    verdict.durationMs = replay.moves.isEmpty() ? 0 : replay.moves.last().atMs;
+    return verdict;
+}
+
+ReplayWriter::~ReplayWriter() {
+    close();
+}
+
+bool ReplayWriter::open(const QString &path) {
+    close();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        LOG_ERROR << "Cannot open replay file" << path << ":" << m_file.errorString();
+        return false;
+    }
+    if (m_file.size() == 0) {
+        char header[HEADER_SIZE];
+        qToLittleEndian(MAGIC, header);
+        qToLittleEndian(VERSION, header + 4);
+        m_buffer.append(header, HEADER_SIZE);
+    }
+    return true;
+}
+
+void ReplayWriter::close() {
+    if (!m_file.isOpen()) return;
+    flush();
+    m_file.close();
+}
+
+void ReplayWriter::append(const GameReplay &replay) {
+    if (!m_file.isOpen()) return;
+    QByteArray record;
+    replay.appendTo(record);
+    putVarint(m_buffer, quint64(record.size()));
+    m_buffer.append(record);
+    ++m_recorded;
+    if (m_buffer.size() >= FLUSH_BYTES) {
+        flush();
+    }
+}
+
+void ReplayWriter::flush() {
+    if (m_buffer.isEmpty() || !m_file.isOpen()) return;
+    if (m_file.write(m_buffer) != m_buffer.size() || !m_file.flush()) {
+        LOG_ERROR << "Cannot write replay file" << m_file.fileName() << ":" << m_file.errorString();
+    }
+    m_bytes += quint64(m_buffer.size());
+    m_buffer.clear();
+}
+
+ReplayReader::ReplayReader(QIODevice *device) :
+    m_device(device)
+{
+}
+
+bool ReplayReader::fill(int bytes) {
+    if (m_buffer.size() - m_pos >= bytes) return true;
+    // Непрочитанный остаток переезжает в начало окна
+    m_buffer.remove(0, m_pos);
+    m_bufferOffset += m_pos;
+    m_pos = 0;
+    while (m_buffer.size() < bytes) {
+        const QByteArray chunk = m_device->read(qMax(CHUNK_SIZE, bytes - m_buffer.size()));
+        if (chunk.isEmpty()) return false;
+        m_buffer.append(chunk);
+    }
+    return true;
+}
+
+bool ReplayReader::readHeader() {
+    if (!fill(ReplayWriter::HEADER_SIZE)) return false;
+    const char *data = m_buffer.constData() + m_pos;
+    if (qFromLittleEndian<quint32>(data) != ReplayWriter::MAGIC
+        || qFromLittleEndian<quint32>(data + 4) != ReplayWriter::VERSION) {
+        return false;
+    }
+    m_pos += ReplayWriter::HEADER_SIZE;
+    return true;
+}
+
+ReplayReader::Status ReplayReader::next(GameReplay &replay) {
+    m_recordOffset = m_bufferOffset + m_pos;
+    // У конца файла байт может оказаться меньше длины varint
+    fill(MAX_VARINT_BYTES);
+    const int available = m_buffer.size() - m_pos;
+    if (available == 0) return Status::End;
+
+    quint64 length;
+    const int used = getVarint(m_buffer.constData() + m_pos, available, length);
+    if (!used) return available < MAX_VARINT_BYTES ? Status::Truncated : Status::Corrupt;
+    if (length == 0 || length > quint64(MAX_RECORD_SIZE)) return Status::Corrupt;
+    if (!fill(used + int(length))) return Status::Truncated;
+    if (!replay.decode(m_buffer.constData() + m_pos + used, int(length))) return Status::Corrupt;
+    m_pos += used + int(length);
+    return Status::Ok;
+}
@@ -0,0 +1,126 @@
+#ifndef GAMEREPLAY_H
+#define GAMEREPLAY_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QVector>
+#include "bitboard.h"
+
+class QIODevice;
+
+// Ход партии: выстрел по клетке или передача хода по таймауту
+struct ReplayMove {
+    static constexpr quint8 PASS = 0x7F;   // вместо номера клетки
+
+    quint8 cell = PASS;      // BitBoard::index(x, y)
+    bool player1 = false;    // ходил первый игрок
+    quint32 atMs = 0;        // от начала партии
+
+    bool isPass() const { return cell == PASS; }
+};
+
+// Запись партии: расстановки до первого выстрела и все ходы по порядку.
+// Сжатая запись:
+//
+//   [исход u8][начало varint, мс от эпохи][корабли 1][корабли 2][число ходов varint]
+//   ход: [клетка u7 | первый игрок << 7][пауза varint, единицы TIME_UNIT_MS]
+//
+// Поле - 13 байт (100 бит), партия без ходов занимает около 35 байт, каждый
+// ход добавляет обычно два.
+struct GameReplay {
+    enum class Outcome : quint8 {
+        Player1Won,
+        Player2Won,
+        Abandoned     // лобби закрыто до конца партии
+    };
+
+    static constexpr int TIME_UNIT_MS = 100;
+    static constexpr int MASK_BYTES = (CellMask::BITS + 7) / 8;
+
+    Outcome outcome = Outcome::Abandoned;
+    qint64 startedAt = 0;
+    CellMask player1Ships;
+    CellMask player2Ships;
+    QVector<ReplayMove> moves;
+
+    void appendTo(QByteArray &out) const;
+    bool decode(const char *data, int size);
+};
+
+// Итог повторного проигрывания партии по правилам сервера
+struct ReplayVerdict {
+    bool valid = true;
+    const char *error = nullptr;   // первое нарушение
+    int shots[2] = {0, 0};
+    int hits[2] = {0, 0};
+    int repeats[2] = {0, 0};       // выстрелы по уже обстрелянным клеткам
+    int passes[2] = {0, 0};
+    int sunkShips[2] = {0, 0};     // потоплено этим игроком
+    qint64 durationMs = 0;
+};
+
+// Проверяет расстановки, очередность ходов и исход
+ReplayVerdict simulateReplay(const GameReplay &replay);
+
+// Файл записей: [MAGIC u32][VERSION u32], затем [длина varint][запись]...
+// Записи копятся в буфере и уходят в файл пачками.
+class ReplayWriter
+{
+public:
+    static constexpr quint32 MAGIC = 0x50525342;   // "BSRP"
+    static constexpr quint32 VERSION = 1;
+    static constexpr int HEADER_SIZE = 8;
+    static constexpr int FLUSH_BYTES = 64 * 1024;
+
+    ~ReplayWriter();
+
+    // Открывает файл на дописывание, новому пишет заголовок
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const { return m_file.isOpen(); }
+
+    void append(const GameReplay &replay);
+    void flush();
+
+    quint64 recorded() const { return m_recorded; }
+    quint64 bytesWritten() const { return m_bytes; }
+
+private:
+    QFile m_file;
+    QByteArray m_buffer;
+    quint64 m_recorded = 0;
+    quint64 m_bytes = 0;
+};
+
+// Потоковое чтение файла записей: в памяти только окно чтения
+class ReplayReader
+{
+public:
+    static constexpr int CHUNK_SIZE = 1 << 20;
+    static constexpr int MAX_RECORD_SIZE = 64 * 1024;
+
+    enum class Status {
+        Ok,
+        End,
+        Truncated,   // запись оборвана концом файла, например при падении
+        Corrupt
+    };
+
+    explicit ReplayReader(QIODevice *device);
+
+    bool readHeader();
+    Status next(GameReplay &replay);
+    // Смещение в файле начала последней прочитанной записи
+    qint64 recordOffset() const { return m_recordOffset; }
+
+private:
+    bool fill(int bytes);
+
+    QIODevice *m_device;
+    QByteArray m_buffer;
+    int m_pos = 0;
+    qint64 m_bufferOffset = 0;   // смещение m_buffer[0] в файле
+    qint64 m_recordOffset = 0;
+};
+
+#endif // GAMEREPLAY_H
@@ -1,360 +1,838 @@
 #include "gameserver.h"
+#include "matchmakinghub.h"
+#include "batchedudpio.h"
+#include "logger.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
 #include <QUuid>
 #include <QRandomGenerator>
-#include <QJsonDocument>
-#include <QDebug>
-#include <QPoint>
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#endif
 
 GameServer::GameServer(QObject *parent) : QObject(parent),
     m_socket(new QUdpSocket(this)),
-    m_gameTimer(new QTimer(this)),
-    m_sessionTimer(new QTimer(this)),
-    m_pingTimer(new QTimer(this))
+    m_io(nullptr),
+    m_batchedIo(true),
+    m_wheelTimer(new QTimer(this)),
+    m_timers(WHEEL_TICK_MS, 0),
+    m_hub(nullptr),
+    m_shardIndex(0)
 {
     connect(m_socket, &QUdpSocket::readyRead, this, &GameServer::onReadyRead);
     connect(m_socket, &QUdpSocket::errorOccurred, this, &GameServer::onError);
     
-    m_gameTimer->setInterval(GAME_TIMEOUT_MS);
-    m_sessionTimer->setInterval(SESSION_TIMEOUT_S * 1000);
-    m_pingTimer->setInterval(PING_INTERVAL_MS);
+    m_clock.start();
+    m_wheelTimer->setInterval(WHEEL_TICK_MS);
     
-    connect(m_gameTimer, &QTimer::timeout, this, &GameServer::onGameTimeout);
-    connect(m_sessionTimer, &QTimer::timeout, this, &GameServer::onSessionTimeout);
-    connect(m_pingTimer, &QTimer::timeout, this, &GameServer::onPingTimerTimeout);
+    connect(m_wheelTimer, &QTimer::timeout, this, &GameServer::onWheelTick);
 }
 
 GameServer::~GameServer() { 
     stop(); 
 }
 
+void GameServer::attachToHub(MatchmakingHub *hub, int shardIndex) {
+    m_hub = hub;
+    m_shardIndex = shardIndex;
+    m_hub->attach(shardIndex, this);
+}
+
 bool GameServer::start(quint16 port) {
-    if (m_socket->bind(QHostAddress::Any, port)) {
-        qDebug() << "Server started on port" << port;
-        m_sessionTimer->start();
-        m_pingTimer->start();
+    if (!m_statePath.isEmpty() && !restoreState()) {
+        LOG_ERROR << "Failed to restore server state from" << m_statePath;
+        return false;
+    }
+    if (!m_replayDir.isEmpty()) {
+        m_replays = new ReplayWriter;
+        const QString path = QString("%1/shard-%2-%3.replays").arg(m_replayDir).arg(m_shardIndex)
+            .arg(QDateTime::currentDateTimeUtc().toString("yyyyMMdd-HHmmss"));
+        if (!m_replays->open(path)) {
+            delete m_replays;
+            m_replays = nullptr;
+            return false;
+        }
+    }
+    if (openSocket(port)) {
+        LOG_INFO << "Server started on port" << port;
+        m_wheelTimer->start();
         return true;
     }
-    qDebug() << "Failed to start server:" << m_socket->errorString();
+    LOG_ERROR << "Failed to start server:" << m_socket->errorString();
     return false;
 }
 
 void GameServer::stop() {
+    delete m_io;
+    m_io = nullptr;
     m_socket->close();
-    m_gameTimer->stop();
-    m_sessionTimer->stop();
-    m_pingTimer->stop();
+    m_wheelTimer->stop();
+    for (auto &entry : m_lobbies) {
+        releaseTicket(entry.value);
+    }
+    m_waitingQueue.clear();
+    m_timers = TimingWheel<ExpiryTarget>(WHEEL_TICK_MS, nowMs());
     m_clients.clear();
+    m_freeSlots.clear();
+    m_peerToClient.clear();
+    m_tokenToClient.clear();
     m_lobbies.clear();
-    m_clientAddressToId.clear();
+    m_pendingReplies.clear();
+    m_spectatorEvents.clear();
+    m_fanOutEvent = 0;
+    m_fanOutSpectator = 0;
+#ifdef Q_OS_LINUX
+    if (m_snapshotPid > 0) {
+        ::waitpid(pid_t(m_snapshotPid), nullptr, 0);
+        m_snapshotPid = -1;
+    }
+#endif
+    delete m_retiredJournal;
+    m_retiredJournal = nullptr;
+    delete m_journal;
+    m_journal = nullptr;
+    delete m_replays;
+    m_replays = nullptr;
+}
+
+MatchmakingStats GameServer::matchmakingStats() const {
+    return m_waitingQueue.stats(QDateTime::currentMSecsSinceEpoch());
+}
+
+QJsonObject GameServer::stats() {
+    int clients = 0;
+    int forwarded = 0;
+    for (const auto &slot : m_clients) {
+        if (!slot.used) continue;
+        if (slot.info.forwardShard >= 0) ++forwarded; else ++clients;
+    }
+    int games = 0;
+    for (auto &entry : m_lobbies) {
+        if (entry.value.isActive) ++games;
+    }
+
+    QJsonObject gauges;
+    gauges["clients"] = clients;
+    gauges["forwarded_clients"] = forwarded;
+    gauges["lobbies"] = int(m_lobbies.size());
+    gauges["active_games"] = games;
+    gauges["timers"] = int(m_timers.size());
+    gauges["spectator_queue"] = m_spectatorEvents.size() - m_fanOutEvent;
+
+    const MatchmakingStats queue = matchmakingStats();
+    QJsonObject matchmaking;
+    matchmaking["depth"] = queue.depth;
+    matchmaking["enqueued"] = double(queue.enqueued);
+    matchmaking["matched"] = double(queue.matched);
+    matchmaking["cancelled"] = double(queue.cancelled);
+    matchmaking["average_wait_ms"] = double(queue.averageWaitMs());
+    matchmaking["max_wait_ms"] = double(queue.maxWaitMs);
+    matchmaking["oldest_wait_ms"] = double(queue.oldestWaitMs);
+
+    QJsonObject json = m_metrics.toJson();
+    json["shard"] = m_shardIndex;
+    json["uptime_s"] = double(nowMs() / 1000);
+    json["gauges"] = gauges;
+    json["matchmaking"] = matchmaking;
+    json["log_dropped"] = double(Logger::droppedCount());
+    if (m_journal) {
+        QJsonObject journal;
+        journal["bytes"] = double(m_journal->size());
+        journal["records"] = double(m_journal->appendedRecords());
+        journal["syncs"] = double(m_journal->syncCount());
+        journal["segment"] = double(m_segment);
+        journal["snapshots"] = double(m_snapshots);
+        journal["snapshot_failures"] = double(m_snapshotFailures);
+        journal["snapshot_timeouts"] = double(m_snapshotTimeouts);
+        json["journal"] = journal;
+    }
+    if (m_replays) {
+        QJsonObject replays;
+        replays["recorded"] = double(m_replays->recorded());
+        replays["bytes"] = double(m_replays->bytesWritten());
+        json["replays"] = replays;
+    }
+    return json;
 }
 
 void GameServer::onReadyRead() {
     while (m_socket->hasPendingDatagrams()) {
         QNetworkDatagram datagram = m_socket->receiveDatagram();
-        QByteArray data = datagram.data();
-        QHostAddress sender = datagram.senderAddress();
-        quint16 senderPort = datagram.senderPort();
-        
-        qDebug() << "Received datagram from" << sender.toString() << ":" << senderPort;
-        
-        QJsonParseError error;
-        QJsonDocument doc = QJsonDocument::fromJson(data, &error);
-        if (error.error != QJsonParseError::NoError) {
-            qDebug() << "JSON parse error:" << error.errorString();
-            continue;
+        processDatagram(datagram.data(), PeerAddress::fromHostAddress(datagram.senderAddress(), datagram.senderPort()));
+    }
+}
+
+void GameServer::processDatagram(const QByteArray &data, const PeerAddress &sender) {
+    LOG_TRACE << "Received datagram from" << sender.toString();
+    const qint64 receivedNs = m_clock.nsecsElapsed();
+    m_metrics.countReceived(data.size());
+    
+    // Клиент, переехавший в другой шард, продолжает приходить на наш сокет
+    if (m_hub) {
+        ClientInfo *info = findClient(m_peerToClient.value(sender, INVALID_CLIENT));
+        if (info && info->forwardShard >= 0) {
+            touchSession(*info);
+            ShardHandoff handoff;
+            handoff.data = data;
+            handoff.peer = sender;
+            if (!m_hub->post(info->forwardShard, std::move(handoff))) {
+                LOG_WARNING << "Shard" << info->forwardShard << "inbox is full, datagram dropped";
+            }
+            return;
         }
-        
-        QJsonObject json = doc.object();
-        QString type = json["type"].toString();
-        QString clientId = getClientId(sender, senderPort);
-        
-        qDebug() << "Processing message of type:" << type << "from client:" << clientId;
-        
-        if (m_clients.contains(clientId)) {
-            m_clients[clientId].lastActive = QDateTime::currentSecsSinceEpoch();
+    }
+    
+    // Конверт надежной доставки: сначала подтверждения и отсев повторов
+    ClientHandle client = INVALID_CLIENT;
+    QByteArray payload;
+    if (ReliableChannel::isEnvelope(data)) {
+        client = resolveClient(sender);
+        ClientInfo &info = *findClient(client);
+        info.reliable = true;
+        const ReliableChannel::Receive result = info.channel.unwrap(data, &payload, nowMs());
+        if (result != ReliableChannel::Receive::Deliver) {
+            if (result == ReliableChannel::Receive::Invalid) {
+                LOG_WARNING << "Malformed envelope, size" << data.size();
+                m_metrics.countMalformed();
+                return;
+            }
+            if (result == ReliableChannel::Receive::Duplicate) {
+                m_metrics.countDuplicate();
+            }
+            sendPendingAck(info);
+            armRetransmitTimer(info);
+            return;
+        }
+    } else {
+        payload = data;
+    }
+    
+    Protocol::Message msg;
+    Protocol::WireFormat format;
+    if (!Protocol::decode(payload, msg, &format)) {
+        LOG_WARNING << "Malformed or unknown message, size" << data.size();
+        m_metrics.countMalformed();
+        return;
+    }
+    m_metrics.countMessage(msg.type);
+    const quint64 sentBefore = m_metrics.datagramsSent();
+    
+    if (msg.type == Protocol::MessageType::Stats) {
+        // Служебный запрос не заводит клиентскую сессию
+        handleStats(msg, format, sender);
+    } else {
+        if (client == INVALID_CLIENT) client = resolveClient(sender);
+        m_collecting = true;
+        dispatchMessage(msg, format, client);
+        flushBundles();
+        // Ответа не было - подтверждение уходит отдельной датаграммой
+        if (ClientInfo *info = findClient(client)) {
+            sendPendingAck(*info);
         }
-        
-        if (type == "login") handleLogin(json, clientId);
-        else if (type == "ready") handleReady(json, clientId);
-        else if (type == "shot") handleShot(json, clientId);
-        else if (type == "ping") handlePing(json, clientId);
-        else if (type == "reconnect") handleReconnect(json, clientId);
-        else if (type == "board") handleBoard(json, clientId);
-        else if (type == "chat_message") handleChatMessage(json, clientId);
-        else qDebug() << "Unknown message type:" << type;
+    }
+    
+    if (m_metrics.datagramsSent() == sentBefore) return;
+    if (m_io) {
+        // Ответ уйдет вместе со всей пачкой, задержка считается при отправке
+        m_pendingReplies.append(receivedNs);
+    } else {
+        m_metrics.recordLatency(quint64(m_clock.nsecsElapsed() - receivedNs) / 1000);
     }
 }
 
-void GameServer::onError(QAbstractSocket::SocketError socketError) {
-    qDebug() << "Socket error occurred:" << m_socket->errorString();
+void GameServer::dispatchMessage(const Protocol::Message &msg, Protocol::WireFormat format, ClientHandle client) {
+    LOG_TRACE << "Processing message of type:" << Protocol::typeName(msg.type) << "from client:" << client;
+    
+    switch (msg.type) {
+    case Protocol::MessageType::Login: handleLogin(msg, format, client); break;
+    case Protocol::MessageType::Ready: handleReady(msg, client); break;
+    case Protocol::MessageType::Shot: handleShot(msg, client); break;
+    case Protocol::MessageType::Ping: handlePing(msg, client); break;
+    case Protocol::MessageType::Reconnect: handleReconnect(msg, client); break;
+    case Protocol::MessageType::Board: handleBoard(msg, client); break;
+    case Protocol::MessageType::ChatMessage: handleChatMessage(msg, client); break;
+    case Protocol::MessageType::Spectate: handleSpectate(msg, client); break;
+    default: LOG_WARNING << "Unknown message type:" << Protocol::typeName(msg.type); break;
+    }
 }
 
-void GameServer::onGameTimeout() {
-    qint64 currentTime = QDateTime::currentSecsSinceEpoch();
-    for (auto it = m_lobbies.begin(); it != m_lobbies.end(); ) {
-        if (currentTime - it->lastActivity > GAME_TIMEOUT_MS / 1000) {
-            cleanupLobby(it.key());
-            it = m_lobbies.erase(it);
-        } else {
-            ++it;
-        }
+void GameServer::handleStats(const Protocol::Message &msg, Protocol::WireFormat format, const PeerAddress &sender) {
+    if (!sender.isLoopback()) {
+        LOG_WARNING << "Stats request from non-local address" << sender.toString() << "ignored";
+        return;
     }
+    const QJsonObject json = stats();
+    Protocol::Message response;
+    response.type = Protocol::MessageType::Stats;
+    response.format = msg.format == "json" ? "json" : "text";
+    response.text = msg.format == "json"
+        ? QString::fromUtf8(QJsonDocument(json).toJson(QJsonDocument::Compact))
+        : ServerMetrics::toText(json);
+    sendDatagram(Protocol::encode(response, format), sender);
 }
 
-void GameServer::onSessionTimeout() {
-    qint64 currentTime = QDateTime::currentSecsSinceEpoch();
-    for (auto it = m_clients.begin(); it != m_clients.end(); ) {
-        if (currentTime - it->lastActive > SESSION_TIMEOUT_S) {
-            QString addrKey = it->address.toString() + ":" + QString::number(it->port);
-            m_clientAddressToId.remove(addrKey);
-            it = m_clients.erase(it);
-        } else {
-            ++it;
+void GameServer::onError(QAbstractSocket::SocketError socketError) {
+    LOG_ERROR << "Socket error occurred:" << m_socket->errorString();
+}
+
+void GameServer::onWheelTick() {
+    // Обходятся только истекшие таймеры, остальные сессии и лобби не трогаются
+    m_timers.advance(nowMs(), [this](const ExpiryTarget &target) {
+        switch (target.kind) {
+        case ExpiryTarget::Kind::Session: expireSession(target.client); break;
+        case ExpiryTarget::Kind::Lobby: expireLobby(target.lobbyId); break;
+        case ExpiryTarget::Kind::Turn: expireTurn(target.lobbyId); break;
+        case ExpiryTarget::Kind::Retransmit: expireRetransmit(target.client); break;
+        case ExpiryTarget::Kind::Keepalive: expireKeepalive(target.client); break;
         }
+    });
+    fanOutSpectators();
+    flushOutbound();
+    if (m_journal) {
+        pollSnapshot();
+    }
+    if (m_replays && nowMs() - m_replayFlushMs >= REPLAY_FLUSH_MS) {
+        m_replays->flush();
+        m_replayFlushMs = nowMs();
     }
 }
 
-void GameServer::onPingTimerTimeout() {
-    QJsonObject pingMsg;
-    pingMsg["type"] = "ping";
-    for (const auto& client : m_clients) {
-        sendJson(pingMsg, client.id);
+void GameServer::onHandoffsPending() {
+    // Флаг снимается до разбора: запись, пришедшая во время разбора, разбудит нас снова
+    m_hub->clearWake(m_shardIndex);
+    ShardHandoff handoff;
+    while (m_hub->takeHandoff(m_shardIndex, handoff)) {
+        if (handoff.kind == ShardHandoff::Kind::Datagram) {
+            processDatagram(handoff.data, handoff.peer);
+        } else {
+            acceptMigratedClient(*handoff.client, handoff.lobbyId);
+        }
     }
+    flushOutbound();
 }
 
-void GameServer::handleLogin(const QJsonObject &json, const QString &clientId) {
-    QString username = json["username"].toString();
-    qDebug() << "Login attempt from client" << clientId << "with username:" << username;
+void GameServer::handleLogin(const Protocol::Message &msg, Protocol::WireFormat format, ClientHandle client) {
+    QString username = msg.username;
+    LOG_INFO << "Login attempt from client" << client << "with username:" << username;
     
     if (username.isEmpty()) {
-        qDebug() << "Login failed: empty username";
-        sendError("Username cannot be empty", clientId);
+        LOG_WARNING << "Login failed: empty username";
+        sendError("Username cannot be empty", client);
         return;
     }
     
-    m_clients[clientId].username = username;
+    ClientInfo &info = *findClient(client);
+    info.username = username;
+    journal(JournalRecord::login(info.token, username));
     
-    QJsonObject response;
-    response["type"] = "login_response";
-    response["success"] = true;
-    qDebug() << "Login successful for client" << clientId;
-    sendJson(response, clientId);
+    // Ответ уходит в формате запроса, после него включается согласованный формат
+    const bool binary = format == Protocol::WireFormat::Binary || msg.protocolVersion > 0;
+    info.wireFormat = format;
+    
+    Protocol::Message response;
+    response.type = Protocol::MessageType::LoginResponse;
+    response.success = true;
+    response.protocolVersion = binary ? Protocol::VERSION : 0;
+    response.reliable = msg.reliable;
+    LOG_INFO << "Login successful for client" << client << (binary ? "(binary protocol)" : "(json protocol)")
+             << (msg.reliable ? "with reliable delivery" : "");
+    // Повторный вход начинает канал заново; сам ответ идет без конверта
+    // и вне пачки, клиент включает их только получив его
+    response.bundles = msg.bundles;
+    info.reliable = false;
+    info.bundles = false;
+    info.channel = ReliableChannel();
+    m_timers.cancel(info.retransmitTimer);
+    info.retransmitTimer = 0;
+    sendMessage(response, client);
+    
+    info.wireFormat = binary ? Protocol::WireFormat::Binary : Protocol::WireFormat::Json;
+    info.reliable = msg.reliable;
+    info.bundles = msg.bundles;
 }
 
-void GameServer::handleReady(const QJsonObject &json, const QString &clientId) {
-    qDebug() << "[DEBUG] handleReady: Ready request from client" << clientId;
-    if (!validateClient(clientId)) {
-        qDebug() << "[DEBUG] handleReady: Ready failed: invalid client" << clientId;
+void GameServer::handleReady(const Protocol::Message &msg, ClientHandle client) {
+    LOG_DEBUG << "handleReady: Ready request from client" << client;
+    if (!validateClient(client)) {
+        LOG_DEBUG << "handleReady: Ready failed: invalid client" << client;
         return;
     }
-    QJsonArray board = m_clients[clientId].savedBoard;
+    const BitBoard &board = findClient(client)->savedBoard;
     if (board.isEmpty()) {
-        qDebug() << "[DEBUG] handleReady: Ready failed: no board saved for client" << clientId;
-        sendError("Сначала отправьте расстановку кораблей", clientId);
+        LOG_DEBUG << "handleReady: Ready failed: no board saved for client" << client;
+        sendError("Сначала отправьте расстановку кораблей", client);
         return;
     }
     if (!validateBoard(board)) {
-        qDebug() << "[DEBUG] handleReady: Ready failed: invalid board for client" << clientId;
-        sendError("Некорректная расстановка кораблей", clientId);
+        LOG_DEBUG << "handleReady: Ready failed: invalid board for client" << client;
+        sendError("Некорректная расстановка кораблей", client);
+        return;
+    }
+    removeSpectator(*findClient(client));
+
+    const QString currentLobbyId = findClient(client)->lobbyId;
+    if (m_waitingQueue.contains(currentLobbyId)) {
+        // Игрок уже ждет соперника - второе лобби ему не нужно
+        Protocol::Message response;
+        response.type = Protocol::MessageType::LobbyCreated;
+        response.lobbyId = currentLobbyId;
+        sendMessage(response, client);
         return;
     }
 
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
     QString foundLobbyId;
-    for (auto &lobby : m_lobbies) {
-        if (lobby.player2.isEmpty() && lobby.player1 != clientId) {
-            foundLobbyId = lobby.id;
-            break;
-        }
+    while (foundLobbyId.isEmpty()) {
+        const QString lobbyId = m_waitingQueue.takeFirst(now);
+        if (lobbyId.isEmpty()) break;
+        Lobby *lobby = m_lobbies.find(lobbyId);
+        if (!lobby) continue;
+        // Лобби, объявленное другим шардам, может быть уже занято там
+        if (lobby->ticket && !claimTicket(*lobby)) continue;
+        foundLobbyId = lobbyId;
+    }
+
+    if (foundLobbyId.isEmpty() && m_hub && joinRemoteLobby(client)) {
+        return;
     }
 
     if (foundLobbyId.isEmpty()) {
-        qDebug() << "Creating new lobby for client" << clientId;
-        Lobby newLobby;
-        newLobby.id = generateLobbyId();
-        newLobby.player1 = clientId;
-        newLobby.player1Board = board;
-        newLobby.player1Ready = true;
-        newLobby.lastActivity = QDateTime::currentSecsSinceEpoch();
-        m_lobbies[newLobby.id] = newLobby;
-        m_clients[clientId].lobbyId = newLobby.id;
-
-        QJsonObject response;
-        response["type"] = "lobby_created";
-        response["lobby_id"] = newLobby.id;
-        sendJson(response, clientId);
+        createLobby(client);
     } else {
-        qDebug() << "Joining existing lobby" << foundLobbyId << "for client" << clientId;
-        Lobby &lobby = m_lobbies[foundLobbyId];
-        lobby.player2 = clientId;
-        lobby.player2Board = board;
-        lobby.player2Ready = true;
-        lobby.lastActivity = QDateTime::currentSecsSinceEpoch();
-        m_clients[clientId].lobbyId = foundLobbyId;
+        joinLobby(foundLobbyId, client);
+    }
+}
 
-        QJsonObject startMsg;
-        startMsg["type"] = "game_start";
-        startMsg["opponent"] = m_clients[lobby.player1].username;
-        startMsg["your_turn"] = false;
-        sendJson(startMsg, lobby.player2);
+void GameServer::createLobby(ClientHandle client) {
+    LOG_INFO << "Creating new lobby for client" << client;
+    Lobby newLobby;
+    newLobby.id = generateLobbyId();
+    newLobby.player1 = client;
+    newLobby.player1Board = findClient(client)->savedBoard;
+    newLobby.player1Ready = true;
+    if (m_hub) {
+        newLobby.ticket = m_hub->publishWaiting(m_shardIndex, newLobby.id);
+    }
+    touchLobby(m_lobbies.insert(newLobby.id, newLobby));
+    findClient(client)->lobbyId = newLobby.id;
+    journal(JournalRecord::lobbyCreated(newLobby.id, findClient(client)->token, newLobby.player1Board));
+    m_waitingQueue.enqueue(newLobby.id, QDateTime::currentMSecsSinceEpoch());
 
-        startMsg["opponent"] = m_clients[lobby.player2].username;
-        startMsg["your_turn"] = true;
-        sendJson(startMsg, lobby.player1);
+    Protocol::Message response;
+    response.type = Protocol::MessageType::LobbyCreated;
+    response.lobbyId = newLobby.id;
+    sendMessage(response, client);
+}
 
-        qDebug() << "Starting game in lobby" << foundLobbyId;
-        startGame(foundLobbyId);
-    }
+void GameServer::joinLobby(const QString &lobbyId, ClientHandle client) {
+    LOG_INFO << "Joining existing lobby" << lobbyId << "for client" << client;
+    Lobby *found = m_lobbies.find(lobbyId);
+    if (!found) return;
+    Lobby &lobby = *found;
+    lobby.player2 = client;
+    lobby.player2Board = findClient(client)->savedBoard;
+    lobby.player2Ready = true;
+    touchLobby(lobby);
+    findClient(client)->lobbyId = lobbyId;
+    journal(JournalRecord::gameStart(lobbyId, findClient(client)->token, lobby.player2Board));
+
+    Protocol::Message startMsg;
+    startMsg.type = Protocol::MessageType::GameStart;
+    startMsg.opponent = findClient(lobby.player1)->username;
+    startMsg.yourTurn = false;
+    sendMessage(startMsg, lobby.player2);
+
+    startMsg.opponent = findClient(lobby.player2)->username;
+    startMsg.yourTurn = true;
+    sendMessage(startMsg, lobby.player1);
+
+    LOG_INFO << "Starting game in lobby" << lobbyId;
+    startGame(lobbyId);
 }
 
-void GameServer::handleBoard(const QJsonObject &json, const QString &clientId) {
-    qDebug() << "[DEBUG] handleBoard: Board received from client" << clientId;
-    if (!validateClient(clientId)) {
-        qDebug() << "[DEBUG] handleBoard: Board rejected: invalid client" << clientId;
-        sendError("Клиент не авторизован", clientId);
+void GameServer::handleBoard(const Protocol::Message &msg, ClientHandle client) {
+    LOG_DEBUG << "handleBoard: Board received from client" << client;
+    if (!validateClient(client)) {
+        LOG_DEBUG << "handleBoard: Board rejected: invalid client" << client;
+        sendError("Клиент не авторизован", client);
         return;
     }
-    if (!json.contains("board")) {
-        qDebug() << "[DEBUG] handleBoard: Board rejected: no board data";
-        sendError("Не получена расстановка кораблей", clientId);
+    if (msg.boardStatus == Protocol::BoardStatus::Missing) {
+        LOG_DEBUG << "handleBoard: Board rejected: no board data";
+        sendError("Не получена расстановка кораблей", client);
         return;
     }
-    QJsonArray board = json["board"].toArray();
-    for (int y = 0; y < board.size(); ++y) {
-        QJsonArray row = board[y].toArray();
-        for (int x = 0; x < row.size(); ++x) {
-            int val = row[x].toInt();
-            if (val != 0 && val != 1) {
-                qDebug() << "[DEBUG] handleBoard: Board rejected: contains non-ship/non-empty cell at" << x << y << "val=" << val;
-                sendError("Доска должна содержать только корабли и пустые клетки", clientId);
-                return;
-            }
-        }
+    if (msg.boardStatus == Protocol::BoardStatus::Malformed) {
+        LOG_DEBUG << "handleBoard: Board rejected: contains non-ship/non-empty cells or wrong size";
+        sendError("Доска должна содержать только корабли и пустые клетки", client);
+        return;
     }
-    if (!validateBoard(board)) {
-        qDebug() << "[DEBUG] handleBoard: Board rejected: invalid board layout";
-        sendError("Некорректная расстановка кораблей", clientId);
+    if (!validateBoard(msg.board)) {
+        LOG_DEBUG << "handleBoard: Board rejected: invalid board layout";
+        sendError("Некорректная расстановка кораблей", client);
         return;
     }
-    m_clients[clientId].savedBoard = board;
-    qDebug() << "[DEBUG] handleBoard: Board saved for client" << clientId;
+    ClientInfo &info = *findClient(client);
+    info.savedBoard = msg.board;
+    journal(JournalRecord::boardSaved(info.token, msg.board));
+    LOG_DEBUG << "handleBoard: Board saved for client" << client;
 }
 
-void GameServer::handleShot(const QJsonObject &json, const QString &clientId) {
-    qDebug() << "[DEBUG] handleShot: Shot received from client" << clientId;
-    if (!validateClient(clientId)) {
-        qDebug() << "[DEBUG] handleShot: Shot rejected: invalid client" << clientId;
+void GameServer::handleShot(const Protocol::Message &msg, ClientHandle client) {
+    LOG_DEBUG << "handleShot: Shot received from client" << client;
+    if (!validateClient(client)) {
+        LOG_DEBUG << "handleShot: Shot rejected: invalid client" << client;
         return;
     }
-    QString lobbyId = m_clients[clientId].lobbyId;
-    if (!m_lobbies.contains(lobbyId)) {
-        qDebug() << "[DEBUG] handleShot: Shot rejected: client not in game" << clientId;
-        sendError("You are not in a game", clientId);
+    QString lobbyId = findClient(client)->lobbyId;
+    Lobby *found = m_lobbies.find(lobbyId);
+    if (!found) {
+        LOG_DEBUG << "handleShot: Shot rejected: client not in game" << client;
+        sendError("You are not in a game", client);
         return;
     }
-    Lobby &lobby = m_lobbies[lobbyId];
-    if ((clientId == lobby.player1 && !lobby.player1Turn) ||
-        (clientId == lobby.player2 && lobby.player1Turn)) {
-        qDebug() << "[DEBUG] handleShot: Shot rejected: not client's turn" << clientId;
-        sendError("Not your turn", clientId);
+    Lobby &lobby = *found;
+    if ((client == lobby.player1 && !lobby.player1Turn) ||
+        (client == lobby.player2 && lobby.player1Turn)) {
+        LOG_DEBUG << "handleShot: Shot rejected: not client's turn" << client;
+        sendError("Not your turn", client);
         return;
     }
-    int x = json["x"].toInt();
-    int y = json["y"].toInt();
-    if (x < 0 || x >= 10 || y < 0 || y >= 10) {
-        qDebug() << "[DEBUG] handleShot: Shot rejected: invalid coordinates" << x << y;
-        sendError("Invalid coordinates", clientId);
+    int x = msg.x;
+    int y = msg.y;
+    if (!BitBoard::inBounds(x, y)) {
+        LOG_DEBUG << "handleShot: Shot rejected: invalid coordinates" << x << y;
+        sendError("Invalid coordinates", client);
         return;
     }
-    qDebug() << "[DEBUG] handleShot: Processing shot at" << x << y << "from client" << clientId;
-    processShotResult(lobbyId, clientId, x, y);
+    LOG_DEBUG << "handleShot: Processing shot at" << x << y << "from client" << client;
+    processShotResult(lobbyId, client, x, y);
 }
 
-void GameServer::handlePing(const QJsonObject &json, const QString &clientId) {
-    qDebug() << "Ping received from client" << clientId;
+void GameServer::handlePing(const Protocol::Message &msg, ClientHandle client) {
+    LOG_TRACE << "Ping received from client" << client;
     
-    if (!validateClient(clientId)) {
-        qDebug() << "Ping rejected: invalid client" << clientId;
+    if (!validateClient(client)) {
+        LOG_DEBUG << "Ping rejected: invalid client" << client;
         return;
     }
     
-    m_clients[clientId].lastActive = QDateTime::currentSecsSinceEpoch();
-    
-    QJsonObject pong;
-    pong["type"] = "pong";
-    sendJson(pong, clientId);
-    qDebug() << "Pong sent to client" << clientId;
+    Protocol::Message pong;
+    pong.type = Protocol::MessageType::Pong;
+    sendMessage(pong, client);
+    LOG_TRACE << "Pong sent to client" << client;
 }
 
-void GameServer::handleReconnect(const QJsonObject &json, const QString &clientId) {
-    qDebug() << "Reconnect attempt from client" << clientId;
+void GameServer::handleReconnect(const Protocol::Message &msg, ClientHandle client) {
+    LOG_DEBUG << "Reconnect attempt from client" << client;
     
-    if (!validateClient(clientId)) {
-        qDebug() << "Reconnect rejected: invalid client" << clientId;
+    if (!validateClient(client)) {
+        LOG_DEBUG << "Reconnect rejected: invalid client" << client;
         return;
     }
 
-    QString oldClientId = json["old_client_id"].toString();
-    if (!m_clients.contains(oldClientId)) {
-        qDebug() << "Reconnect rejected: old client not found" << oldClientId;
-        sendError("Invalid old client ID", clientId);
+    QString oldClientId = msg.oldClientId;
+    const ClientHandle oldHandle = m_tokenToClient.value(oldClientId, INVALID_CLIENT);
+    if (oldHandle == INVALID_CLIENT || oldHandle == client) {
+        LOG_DEBUG << "Reconnect rejected: old client not found" << oldClientId;
+        sendError("Invalid old client ID", client);
         return;
     }
 
-    ClientInfo &oldClient = m_clients[oldClientId];
-    ClientInfo &newClient = m_clients[clientId];
+    ClientInfo &oldClient = *findClient(oldHandle);
+    ClientInfo &newClient = *findClient(client);
     
     newClient.username = oldClient.username;
     newClient.lobbyId = oldClient.lobbyId;
     newClient.savedBoard = oldClient.savedBoard;
+    newClient.wireFormat = oldClient.wireFormat;
+    journal(JournalRecord::reconnect(newClient.token, oldClient.token));
+
+    // Лобби продолжает игру уже с новым номером клиента
+    if (Lobby *lobby = m_lobbies.find(newClient.lobbyId)) {
+        if (lobby->player1 == oldHandle) lobby->player1 = client;
+        if (lobby->player2 == oldHandle) lobby->player2 = client;
+    }
     
-    m_clients.remove(oldClientId);
+    releaseClient(oldHandle);
     
-    QJsonObject response;
-    response["type"] = "reconnect_response";
-    response["success"] = true;
-    sendJson(response, clientId);
-    qDebug() << "Reconnect successful for client" << clientId;
+    Protocol::Message response;
+    response.type = Protocol::MessageType::ReconnectResponse;
+    response.success = true;
+    sendMessage(response, client);
+    LOG_INFO << "Reconnect successful for client" << client;
 }
 
-void GameServer::handleChatMessage(const QJsonObject &json, const QString &clientId) {
-    qDebug() << "[DEBUG] handleChatMessage: from client" << clientId;
-    if (!validateClient(clientId)) {
-        qDebug() << "[DEBUG] handleChatMessage: invalid client" << clientId;
+void GameServer::handleChatMessage(const Protocol::Message &msg, ClientHandle client) {
+    LOG_DEBUG << "handleChatMessage: from client" << client;
+    if (!validateClient(client)) {
+        LOG_DEBUG << "handleChatMessage: invalid client" << client;
         return;
     }
-    QString lobbyId = m_clients[clientId].lobbyId;
-    if (!m_lobbies.contains(lobbyId)) {
-        qDebug() << "[DEBUG] handleChatMessage: client not in lobby" << clientId;
+    QString lobbyId = findClient(client)->lobbyId;
+    Lobby *found = m_lobbies.find(lobbyId);
+    if (!found) {
+        LOG_DEBUG << "handleChatMessage: client not in lobby" << client;
         return;
     }
-    Lobby &lobby = m_lobbies[lobbyId];
-    QString otherId = (clientId == lobby.player1) ? lobby.player2 : lobby.player1;
-    if (otherId.isEmpty()) {
-        qDebug() << "[DEBUG] handleChatMessage: no opponent yet";
+    Lobby &lobby = *found;
+    const ClientHandle other = (client == lobby.player1) ? lobby.player2 : lobby.player1;
+    if (other == INVALID_CLIENT) {
+        LOG_DEBUG << "handleChatMessage: no opponent yet";
         return;
     }
-    QJsonObject msg = json;
-    // Пересылаем сообщение оппоненту
-    sendJson(msg, otherId);
+    // Пересылаем сообщение оппоненту в его формате
+    sendMessage(msg, other);
 }
 
-QString GameServer::getClientId(const QHostAddress &address, quint16 port) {
-    QString key = address.toString() + ":" + QString::number(port);
-    if (!m_clientAddressToId.contains(key)) {
-        QString newId = QUuid::createUuid().toString();
-        m_clientAddressToId[key] = newId;
-        
-        ClientInfo client;
-        client.id = newId;
-        client.address = address;
-        client.port = port;
-        client.lastActive = QDateTime::currentSecsSinceEpoch();
-        client.lobbyId = "";
-        client.isConnected = true;
-        
-        m_clients[newId] = client;
+void GameServer::handleSpectate(const Protocol::Message &msg, ClientHandle client) {
+    if (!validateClient(client)) return;
+    ClientInfo &info = *findClient(client);
+    removeSpectator(info);
+    // Пустой lobby_id - зритель уходит
+    if (msg.lobbyId.isEmpty()) return;
+    if (!info.lobbyId.isEmpty()) {
+        sendError("You are already in a game", client);
+        return;
+    }
+    Lobby *lobby = m_lobbies.find(msg.lobbyId);
+    if (!lobby || !lobby->isActive) {
+        sendError("Game not found", client);
+        return;
+    }
+    lobby->spectators.append(client);
+    info.spectating = lobby->id;
+    sendMessage(spectatorState(*lobby, false), client);
+}
+
+void GameServer::touchSession(ClientInfo &client) {
+    client.lastActive = QDateTime::currentSecsSinceEpoch();
+    client.lastInboundMs = nowMs();
+    const qint64 deadline = nowMs() + SESSION_TIMEOUT_S * 1000;
+    if (!m_timers.reschedule(client.sessionTimer, deadline)) {
+        client.sessionTimer = m_timers.schedule(deadline, {ExpiryTarget::Kind::Session, client.handle, QString()});
+    }
+}
+
+void GameServer::touchLobby(Lobby &lobby) {
+    lobby.lastActivity = QDateTime::currentSecsSinceEpoch();
+    const qint64 deadline = nowMs() + GAME_TIMEOUT_MS;
+    if (!m_timers.reschedule(lobby.expiryTimer, deadline)) {
+        lobby.expiryTimer = m_timers.schedule(deadline, {ExpiryTarget::Kind::Lobby, INVALID_CLIENT, lobby.id});
+    }
+}
+
+void GameServer::armTurnTimer(Lobby &lobby) {
+    const qint64 deadline = nowMs() + TURN_TIMEOUT_S * 1000;
+    if (!m_timers.reschedule(lobby.turnTimer, deadline)) {
+        lobby.turnTimer = m_timers.schedule(deadline, {ExpiryTarget::Kind::Turn, INVALID_CLIENT, lobby.id});
+    }
+}
+
+void GameServer::cancelLobbyTimers(Lobby &lobby) {
+    m_timers.cancel(lobby.expiryTimer);
+    m_timers.cancel(lobby.turnTimer);
+    lobby.expiryTimer = 0;
+    lobby.turnTimer = 0;
+}
+
+void GameServer::expireSession(ClientHandle client) {
+    ClientInfo *info = findClient(client);
+    if (!info) return;
+    // Сработавший таймер уже освобожден колесом
+    info->sessionTimer = 0;
+    LOG_INFO << "Session expired for client" << client;
+
+    // Отключившийся игрок больше не ждет соперника
+    if (m_waitingQueue.cancel(info->lobbyId)) {
+        journal(JournalRecord::lobbyClosed(info->lobbyId));
+        if (Lobby *lobby = m_lobbies.find(info->lobbyId)) {
+            releaseTicket(*lobby);
+            cancelLobbyTimers(*lobby);
+            m_lobbies.remove(info->lobbyId);
+        }
+    }
+    releaseClient(client);
+}
+
+void GameServer::expireLobby(const QString &lobbyId) {
+    Lobby *lobby = m_lobbies.find(lobbyId);
+    if (!lobby) return;
+    lobby->expiryTimer = 0;
+    LOG_INFO << "Lobby" << lobbyId << "expired after inactivity";
+    cleanupLobby(lobbyId);
+    m_lobbies.remove(lobbyId);
+}
+
+void GameServer::armRetransmitTimer(ClientInfo &info) {
+    const qint64 deadline = info.channel.nextDeadline();
+    if (deadline < 0) {
+        m_timers.cancel(info.retransmitTimer);
+        info.retransmitTimer = 0;
+        return;
+    }
+    if (!m_timers.reschedule(info.retransmitTimer, deadline)) {
+        info.retransmitTimer = m_timers.schedule(deadline, {ExpiryTarget::Kind::Retransmit, info.handle, QString()});
+    }
+}
+
+void GameServer::expireRetransmit(ClientHandle client) {
+    ClientInfo *info = findClient(client);
+    if (!info) return;
+    info->retransmitTimer = 0;
+    int abandoned = 0;
+    const QVector<QByteArray> datagrams = info->channel.takeRetransmits(nowMs(), &abandoned);
+    for (const QByteArray &datagram : datagrams) {
+        sendDatagram(datagram, info->peer);
+    }
+    m_metrics.countRetransmits(datagrams.size());
+    if (abandoned > 0) {
+        LOG_WARNING << "Client" << client << "did not acknowledge" << abandoned << "messages, giving up";
+        m_metrics.countAbandoned(abandoned);
     }
-    return m_clientAddressToId[key];
+    armRetransmitTimer(*info);
+}
+
+void GameServer::scheduleKeepalive(ClientInfo &info, qint64 deadline) {
+    if (!m_timers.reschedule(info.keepaliveTimer, deadline)) {
+        info.keepaliveTimer = m_timers.schedule(deadline, {ExpiryTarget::Kind::Keepalive, info.handle, QString()});
+    }
+}
+
+void GameServer::expireKeepalive(ClientHandle client) {
+    ClientInfo *info = findClient(client);
+    if (!info) return;
+    info->keepaliveTimer = 0;
+    // Клиент из журнала еще не прислал свой адрес
+    if (!info->isConnected) return;
+
+    const qint64 now = nowMs();
+    if (now - info->lastInboundMs < info->keepaliveIntervalMs) {
+        // Клиент сам недавно писал - пинг не нужен, отсчет идет от его датаграммы
+        m_metrics.countKeepalive(false);
+        info->keepaliveIntervalMs = KEEPALIVE_INTERVAL_MS;
+        scheduleKeepalive(*info, info->lastInboundMs + KEEPALIVE_INTERVAL_MS);
+        return;
+    }
+
+    Protocol::Message pingMsg;
+    pingMsg.type = Protocol::MessageType::Ping;
+    sendMessage(pingMsg, client);
+    m_metrics.countKeepalive(true);
+
+    // Игроку в партии пингуем с обычным шагом, ожидающего в лобби - все реже
+    const Lobby *lobby = m_lobbies.find(info->lobbyId);
+    const bool playing = lobby && lobby->isActive;
+    info->keepaliveIntervalMs = playing ? KEEPALIVE_INTERVAL_MS
+        : qMin(info->keepaliveIntervalMs * 2, KEEPALIVE_MAX_INTERVAL_MS);
+    scheduleKeepalive(*info, now + info->keepaliveIntervalMs);
+}
+
+void GameServer::expireTurn(const QString &lobbyId) {
+    Lobby *found = m_lobbies.find(lobbyId);
+    if (!found) return;
+    Lobby &lobby = *found;
+    lobby.turnTimer = 0;
+    if (lobby.player2 == INVALID_CLIENT) return;
+
+    // Игрок не выстрелил вовремя - ход переходит сопернику
+    recordMove(lobby, ReplayMove::PASS, lobby.player1Turn);
+    lobby.player1Turn = !lobby.player1Turn;
+    journal(JournalRecord::turnChange(lobbyId, lobby.player1Turn));
+    Protocol::Message turnMsg;
+    turnMsg.type = Protocol::MessageType::TurnChange;
+    turnMsg.yourTurn = lobby.player1Turn;
+    sendMessage(turnMsg, lobby.player1);
+    turnMsg.yourTurn = !lobby.player1Turn;
+    sendMessage(turnMsg, lobby.player2);
+    publishToSpectators(lobby, spectatorState(lobby, false));
+    LOG_WARNING << "Turn timed out in lobby" << lobbyId << ", now player" << (lobby.player1Turn ? "1" : "2");
+    armTurnTimer(lobby);
+}
+
+ClientHandle GameServer::resolveClient(const PeerAddress &peer) {
+    const ClientHandle existing = m_peerToClient.value(peer, INVALID_CLIENT);
+    if (existing != INVALID_CLIENT) {
+        touchSession(*findClient(existing));
+        return existing;
+    }
+
+    ClientInfo info;
+    info.token = QUuid::createUuid().toString();
+    info.peer = peer;
+    info.lobbyId = "";
+    info.isConnected = true;
+    return allocateClient(info);
+}
+
+ClientInfo *GameServer::findClient(ClientHandle client) {
+    const quint32 index = client & HANDLE_INDEX_MASK;
+    if (client == INVALID_CLIENT || index >= quint32(m_clients.size())) return nullptr;
+    ClientSlot &slot = m_clients[index];
+    if (!slot.used || slot.generation != client >> HANDLE_INDEX_BITS) return nullptr;
+    return &slot.info;
+}
+
+ClientHandle GameServer::allocateClient(const ClientInfo &info) {
+    quint32 index;
+    if (!m_freeSlots.isEmpty()) {
+        index = m_freeSlots.takeLast();
+    } else {
+        index = quint32(m_clients.size());
+        m_clients.append(ClientSlot());
+    }
+    ClientSlot &slot = m_clients[index];
+    slot.used = true;
+    slot.info = info;
+    slot.info.handle = ClientHandle(slot.generation) << HANDLE_INDEX_BITS | index;
+    slot.info.sessionTimer = 0;
+    slot.info.retransmitTimer = 0;
+    slot.info.keepaliveTimer = 0;
+    slot.info.keepaliveIntervalMs = KEEPALIVE_INTERVAL_MS;
+    // У клиента из журнала адреса еще нет, он появится при reconnect
+    if (info.isConnected) {
+        m_peerToClient.insert(info.peer, slot.info.handle);
+    }
+    m_tokenToClient.insert(info.token, slot.info.handle);
+    touchSession(slot.info);
+    // Случайная фаза разносит пинги равномерно по интервалу вместо
+    // одновременной рассылки всем клиентам
+    scheduleKeepalive(slot.info, nowMs() + QRandomGenerator::global()->bounded(KEEPALIVE_INTERVAL_MS));
+    return slot.info.handle;
+}
+
+void GameServer::releaseClient(ClientHandle client) {
+    ClientInfo *info = findClient(client);
+    if (!info) return;
+    m_timers.cancel(info->sessionTimer);
+    m_timers.cancel(info->retransmitTimer);
+    m_timers.cancel(info->keepaliveTimer);
+    journal(JournalRecord::clientReleased(info->token));
+    removeSpectator(*info);
+    // Адрес мог уже перейти к другому клиенту
+    if (m_peerToClient.value(info->peer, INVALID_CLIENT) == client) {
+        m_peerToClient.remove(info->peer);
+    }
+    if (m_tokenToClient.value(info->token, INVALID_CLIENT) == client) {
+        m_tokenToClient.remove(info->token);
+    }
+
+    ClientSlot &slot = m_clients[client & HANDLE_INDEX_MASK];
+    slot.used = false;
+    slot.info = ClientInfo();
+    // Нулевое поколение не выдается, чтобы номер никогда не совпал с INVALID_CLIENT
+    if (++slot.generation == 0) slot.generation = 1;
+    m_freeSlots.append(client & HANDLE_INDEX_MASK);
 }
 
 QString GameServer::generateLobbyId() const {
@@ -366,243 +844,858 @@ QString GameServer::generateLobbyId() const {
     return id;
 }
 
-bool GameServer::validateBoard(const QJsonArray &board) {
-    if (board.size() != 10) return false;
-    
-    // Проверяем количество кораблей
-    QMap<int, int> shipCounts = {
-        {4, 1}, // 1 корабль на 4 клетки
-        {3, 2}, // 2 корабля на 3 клетки
-        {2, 3}, // 3 корабля на 2 клетки
-        {1, 4}  // 4 корабля на 1 клетку
-    };
-    
-    QVector<QVector<bool>> visited(10, QVector<bool>(10, false));
-    
-    for (int y = 0; y < 10; ++y) {
-        if (board[y].toArray().size() != 10) return false;
-        
-        for (int x = 0; x < 10; ++x) {
-            if (board[y].toArray()[x].toInt() == 1 && !visited[y][x]) {
-                int length = 1;
-                bool horizontal = false;
-                
-                // Проверяем направление корабля
-                if (x < 9 && board[y].toArray()[x+1].toInt() == 1) {
-                    horizontal = true;
-                    // Проверяем горизонтальный корабль
-                    for (int dx = x+1; dx < 10 && board[y].toArray()[dx].toInt() == 1; ++dx) {
-                        length++;
-                        visited[y][dx] = true;
-                    }
-                } else if (y < 9 && board[y+1].toArray()[x].toInt() == 1) {
-                    // Проверяем вертикальный корабль
-                    for (int dy = y+1; dy < 10 && board[dy].toArray()[x].toInt() == 1; ++dy) {
-                        length++;
-                        visited[dy][x] = true;
-                    }
-                }
-                
-                // Проверяем диагонали (корабли не должны касаться углами)
-                if (x > 0 && y > 0 && board[y-1].toArray()[x-1].toInt() == 1) return false;
-                if (x < 9 && y > 0 && board[y-1].toArray()[x+1].toInt() == 1) return false;
-                if (x > 0 && y < 9 && board[y+1].toArray()[x-1].toInt() == 1) return false;
-                if (x < 9 && y < 9 && board[y+1].toArray()[x+1].toInt() == 1) return false;
-                
-                // Проверяем длину корабля
-                if (!shipCounts.contains(length) || shipCounts[length] <= 0) {
-                    return false;
-                }
-                shipCounts[length]--;
-            }
-            visited[y][x] = true;
-        }
-    }
-    
-    // Проверяем, что все корабли расставлены
-    for (auto count : shipCounts) {
-        if (count != 0) return false;
-    }
-    
-    return true;
+bool GameServer::validateBoard(const BitBoard &board) {
+    return board.isValidFleet();
 }
 
 void GameServer::cleanupLobby(const QString &lobbyId) {
-    if (!m_lobbies.contains(lobbyId)) return;
+    Lobby *found = m_lobbies.find(lobbyId);
+    if (!found) return;
 
-    Lobby &lobby = m_lobbies[lobbyId];
-    QJsonObject msg;
-    msg["type"] = "lobby_timeout";
-    
-    if (!lobby.player1.isEmpty()) {
-        sendJson(msg, lobby.player1);
-        m_clients[lobby.player1].lobbyId.clear();
+    journal(JournalRecord::lobbyClosed(lobbyId));
+    Lobby &lobby = *found;
+    finishReplay(lobby, GameReplay::Outcome::Abandoned);
+    if (lobby.isActive) {
+        publishToSpectators(lobby, spectatorState(lobby, true));
+        lobby.spectators.clear();
     }
-    if (!lobby.player2.isEmpty()) {
-        sendJson(msg, lobby.player2);
-        m_clients[lobby.player2].lobbyId.clear();
+    releaseTicket(lobby);
+    cancelLobbyTimers(lobby);
+    m_waitingQueue.cancel(lobbyId);
+    Protocol::Message msg;
+    msg.type = Protocol::MessageType::LobbyTimeout;
+    
+    for (ClientHandle player : {lobby.player1, lobby.player2}) {
+        ClientInfo *info = findClient(player);
+        if (!info) continue;
+        sendMessage(msg, player);
+        info->lobbyId.clear();
     }
 }
 
 void GameServer::startGame(const QString &lobbyId) {
-    if (!m_lobbies.contains(lobbyId)) {
-        qDebug() << "Лобби не найдено:" << lobbyId;
+    Lobby *found = m_lobbies.find(lobbyId);
+    if (!found) {
+        LOG_WARNING << "Лобби не найдено:" << lobbyId;
         return;
     }
 
-    Lobby &lobby = m_lobbies[lobbyId];
+    Lobby &lobby = *found;
     lobby.isActive = true;
     lobby.player1Turn = true;
-    lobby.lastActivity = QDateTime::currentSecsSinceEpoch();
-
-    if (!m_gameTimer->isActive()) {
-        m_gameTimer->start();
+    lobby.player1Fleet.build(lobby.player1Board.ships());
+    lobby.player2Fleet.build(lobby.player2Board.ships());
+    touchLobby(lobby);
+    armTurnTimer(lobby);
+    if (m_replays) {
+        lobby.replay = GameReplay();
+        lobby.replay.startedAt = QDateTime::currentMSecsSinceEpoch();
+        lobby.replay.player1Ships = lobby.player1Board.ships();
+        lobby.replay.player2Ships = lobby.player2Board.ships();
     }
 }
 
-void GameServer::processShotResult(const QString &lobbyId, const QString &shooterId, int x, int y) {
-    qDebug() << "[DEBUG] processShotResult: lobby=" << lobbyId << "shooterId=" << shooterId << "x=" << x << "y=" << y;
-    Lobby &lobby = m_lobbies[lobbyId];
-    QString targetId = (shooterId == lobby.player1) ? lobby.player2 : lobby.player1;
-    QJsonArray targetBoard = (shooterId == lobby.player1) ? lobby.player2Board : lobby.player1Board;
+void GameServer::processShotResult(const QString &lobbyId, ClientHandle shooter, int x, int y) {
+    LOG_DEBUG << "processShotResult: lobby=" << lobbyId << "shooter=" << shooter << "x=" << x << "y=" << y;
+    Lobby *found = m_lobbies.find(lobbyId);
+    if (!found) return;
+    Lobby &lobby = *found;
+    touchLobby(lobby);
+    armTurnTimer(lobby);
+    const ClientHandle target = (shooter == lobby.player1) ? lobby.player2 : lobby.player1;
+    BitBoard &targetBoard = (shooter == lobby.player1) ? lobby.player2Board : lobby.player1Board;
+    FleetIndex &targetFleet = (shooter == lobby.player1) ? lobby.player2Fleet : lobby.player1Fleet;
+    journal(JournalRecord::shot(lobbyId, shooter == lobby.player1, x, y));
+    // Выстрел мимо поля передает ход так же, как таймаут
+    recordMove(lobby, BitBoard::inBounds(x, y) ? quint8(BitBoard::index(x, y)) : ReplayMove::PASS,
+               shooter == lobby.player1);
     bool hit = false;
-    if (x >= 0 && x < 10 && y >= 0 && y < 10) {
-        QJsonArray row = targetBoard[y].toArray();
-        hit = row[x].toInt() == 1;
-        row[x] = hit ? 2 : 3;
-        qDebug() << "[DEBUG] processShotResult: cell before=" << row[x].toInt() << "after=" << (hit ? 2 : 3);
-        targetBoard[y] = row;
-    }
-    qDebug() << "[DEBUG] processShotResult: Shot result:" << (hit ? "hit" : "miss");
-    QJsonObject resultMsg;
-    resultMsg["type"] = "shot_result";
-    resultMsg["x"] = x;
-    resultMsg["y"] = y;
-    resultMsg["hit"] = hit;
-    sendJson(resultMsg, shooterId);
-    QJsonObject shotMsg;
-    shotMsg["type"] = "shot_received";
-    shotMsg["x"] = x;
-    shotMsg["y"] = y;
-    sendJson(shotMsg, targetId);
+    if (BitBoard::inBounds(x, y)) {
+        hit = targetBoard.shoot(x, y);
+        if (hit) targetFleet.hit(BitBoard::index(x, y));
+    }
+    LOG_DEBUG << "processShotResult: Shot result:" << (hit ? "hit" : "miss");
+    Protocol::Message resultMsg;
+    resultMsg.type = Protocol::MessageType::ShotResult;
+    resultMsg.x = x;
+    resultMsg.y = y;
+    resultMsg.hit = hit;
+    sendMessage(resultMsg, shooter);
+    Protocol::Message shotMsg;
+    shotMsg.type = Protocol::MessageType::ShotReceived;
+    shotMsg.x = x;
+    shotMsg.y = y;
+    sendMessage(shotMsg, target);
+    bool shipSunk = false;
     if (hit) {
-        bool shipSunk = checkShipSunk(targetBoard, x, y);
+        shipSunk = checkShipSunk(targetFleet, x, y);
         if (shipSunk) {
-            QJsonObject sunkMsg;
-            sunkMsg["type"] = "ship_sunk";
-            sunkMsg["x"] = x;
-            sunkMsg["y"] = y;
-            sendJson(sunkMsg, shooterId);
-            sendJson(sunkMsg, targetId);
-            if (checkGameOver(targetBoard)) {
-                qDebug() << "[DEBUG] processShotResult: Game over in lobby" << lobbyId;
+            Protocol::Message sunkMsg;
+            sunkMsg.type = Protocol::MessageType::ShipSunk;
+            sunkMsg.x = x;
+            sunkMsg.y = y;
+            sendMessage(sunkMsg, shooter);
+            sendMessage(sunkMsg, target);
+            if (checkGameOver(targetFleet)) {
+                LOG_DEBUG << "processShotResult: Game over in lobby" << lobbyId;
                 // Победителю win, проигравшему lose
-                QJsonObject winMsg, loseMsg;
-                winMsg["type"] = "game_over";
-                winMsg["result"] = "win";
-                loseMsg["type"] = "game_over";
-                loseMsg["result"] = "lose";
-                sendJson(winMsg, shooterId);
-                sendJson(loseMsg, targetId);
+                Protocol::Message winMsg, loseMsg;
+                winMsg.type = Protocol::MessageType::GameOver;
+                winMsg.win = true;
+                loseMsg.type = Protocol::MessageType::GameOver;
+                loseMsg.win = false;
+                sendMessage(winMsg, shooter);
+                sendMessage(loseMsg, target);
+                publishShot(lobby, shooter, x, y, hit, shipSunk);
+                publishToSpectators(lobby, spectatorState(lobby, true, shooter));
+                lobby.spectators.clear();
+                finishReplay(lobby, shooter == lobby.player1 ? GameReplay::Outcome::Player1Won
+                                                             : GameReplay::Outcome::Player2Won);
                 cleanupLobby(lobbyId);
+                m_lobbies.remove(lobbyId);
                 return;
             }
         }
     } else {
         lobby.player1Turn = !lobby.player1Turn;
-        QJsonObject turnMsg;
-        turnMsg["type"] = "turn_change";
-        turnMsg["your_turn"] = lobby.player1Turn;
-        sendJson(turnMsg, lobby.player1);
-        turnMsg["your_turn"] = !lobby.player1Turn;
-        sendJson(turnMsg, lobby.player2);
-        qDebug() << "[DEBUG] processShotResult: Turn changed to player" << (lobby.player1Turn ? "1" : "2");
-    }
-    if (shooterId == lobby.player1) {
-        lobby.player2Board = targetBoard;
-    } else {
-        lobby.player1Board = targetBoard;
+        Protocol::Message turnMsg;
+        turnMsg.type = Protocol::MessageType::TurnChange;
+        turnMsg.yourTurn = lobby.player1Turn;
+        sendMessage(turnMsg, lobby.player1);
+        turnMsg.yourTurn = !lobby.player1Turn;
+        sendMessage(turnMsg, lobby.player2);
+        LOG_DEBUG << "processShotResult: Turn changed to player" << (lobby.player1Turn ? "1" : "2");
     }
+    publishShot(lobby, shooter, x, y, hit, shipSunk);
 }
 
-bool GameServer::checkShipSunk(const QJsonArray &board, int x, int y) {
-    // Найти все клетки корабля (влево, вправо, вверх, вниз)
-    QVector<QPoint> shipCells;
-    shipCells.append(QPoint(x, y));
-    const QVector<QPair<int, int>> directions = {
-        {-1, 0}, {1, 0}, {0, -1}, {0, 1}
-    };
-    for (const auto& dir : directions) {
-        int nx = x + dir.first;
-        int ny = y + dir.second;
-        while (nx >= 0 && nx < 10 && ny >= 0 && ny < 10) {
-            int val = board[ny].toArray()[nx].toInt();
-            if (val == 1 || val == 2) {
-                shipCells.append(QPoint(nx, ny));
-                nx += dir.first;
-                ny += dir.second;
-            } else {
-                break;
+bool GameServer::checkShipSunk(const FleetIndex &fleet, int x, int y) {
+    const int ship = fleet.shipAt(BitBoard::index(x, y));
+    return ship != FleetIndex::NO_SHIP && fleet.isSunk(ship);
+}
+
+bool GameServer::checkGameOver(const FleetIndex &fleet) {
+    // Непотопленных кораблей не осталось
+    return fleet.shipsLeft() == 0;
+}
+
+void GameServer::endGame(const QString &lobbyId, ClientHandle winner) {
+    Lobby *found = m_lobbies.find(lobbyId);
+    if (!found) return;
+    Lobby &lobby = *found;
+    const ClientHandle loser = (winner == lobby.player1) ? lobby.player2 : lobby.player1;
+    journal(JournalRecord::lobbyClosed(lobbyId));
+    finishReplay(lobby, winner == lobby.player1 ? GameReplay::Outcome::Player1Won
+                                                : GameReplay::Outcome::Player2Won);
+    publishToSpectators(lobby, spectatorState(lobby, true, winner));
+    lobby.spectators.clear();
+    
+    Protocol::Message winMsg, loseMsg;
+    winMsg.type = Protocol::MessageType::GameOver;
+    winMsg.win = true;
+    loseMsg.type = Protocol::MessageType::GameOver;
+    loseMsg.win = false;
+    
+    sendMessage(winMsg, winner);
+    sendMessage(loseMsg, loser);
+    
+    for (ClientHandle player : {lobby.player1, lobby.player2}) {
+        if (ClientInfo *info = findClient(player)) info->lobbyId = "";
+    }
+    releaseTicket(lobby);
+    cancelLobbyTimers(lobby);
+    m_waitingQueue.cancel(lobbyId);
+    m_lobbies.remove(lobbyId);
+}
+
+Protocol::Message GameServer::spectatorState(const Lobby &lobby, bool finished, ClientHandle winner) {
+    Protocol::Message state;
+    state.type = Protocol::MessageType::SpectateState;
+    state.lobbyId = lobby.id;
+    if (const ClientInfo *player1 = findClient(lobby.player1)) state.username = player1->username;
+    if (const ClientInfo *player2 = findClient(lobby.player2)) state.opponent = player2->username;
+    state.yourTurn = lobby.player1Turn;
+    state.finished = finished;
+    state.success = winner != INVALID_CLIENT;
+    state.win = winner != INVALID_CLIENT && winner == lobby.player1;
+    state.board = lobby.player1Board;
+    state.otherBoard = lobby.player2Board;
+    if (!finished) {
+        // До конца партии зритель видит только обстрелянные клетки
+        state.board.restore(lobby.player1Board.hits(), lobby.player1Board.hits(), lobby.player1Board.misses());
+        state.otherBoard.restore(lobby.player2Board.hits(), lobby.player2Board.hits(), lobby.player2Board.misses());
+    }
+    return state;
+}
+
+void GameServer::publishShot(const Lobby &lobby, ClientHandle shooter, int x, int y, bool hit, bool sunk) {
+    if (lobby.spectators.isEmpty()) return;
+    Protocol::Message event;
+    event.type = Protocol::MessageType::SpectateEvent;
+    event.lobbyId = lobby.id;
+    event.x = x;
+    event.y = y;
+    event.hit = hit;
+    event.sunk = sunk;
+    event.firstPlayer = shooter == lobby.player1;
+    event.yourTurn = lobby.player1Turn;
+    publishToSpectators(lobby, event);
+}
+
+void GameServer::publishToSpectators(const Lobby &lobby, const Protocol::Message &event) {
+    if (lobby.spectators.isEmpty()) return;
+    SpectatorEvent entry;
+    entry.lobbyId = lobby.id;
+    entry.message = event;
+    entry.audience = lobby.spectators;
+    m_spectatorEvents.append(entry);
+}
+
+void GameServer::removeSpectator(ClientInfo &info) {
+    if (info.spectating.isEmpty()) return;
+    if (Lobby *lobby = m_lobbies.find(info.spectating)) {
+        lobby->spectators.removeOne(info.handle);
+    }
+    info.spectating.clear();
+    info.spectatorBehind = false;
+}
+
+void GameServer::fanOutSpectators() {
+    int budget = SPECTATOR_SENDS_PER_TICK;
+    while (m_fanOutEvent < m_spectatorEvents.size()) {
+        SpectatorEvent &event = m_spectatorEvents[m_fanOutEvent];
+        while (m_fanOutSpectator < event.audience.size()) {
+            if (budget-- == 0) {
+                // Продолжим со следующего тика; разосланное начало очереди отбрасывается
+                m_spectatorEvents.remove(0, m_fanOutEvent);
+                m_fanOutEvent = 0;
+                return;
             }
+            deliverToSpectator(event, event.audience[m_fanOutSpectator++]);
         }
+        ++m_fanOutEvent;
+        m_fanOutSpectator = 0;
     }
-    // Проверить, что все клетки корабля подбиты (2)
-    for (const QPoint &p : shipCells) {
-        if (board[p.y()].toArray()[p.x()].toInt() != 2) {
-            return false;
+    m_spectatorEvents.clear();
+    m_fanOutEvent = 0;
+}
+
+void GameServer::deliverToSpectator(SpectatorEvent &event, ClientHandle spectator) {
+    ClientInfo *info = findClient(spectator);
+    if (!info || !info->isConnected || info->spectating != event.lobbyId) return;
+
+    // Итоговое состояние уходит всегда: лобби сразу удаляется, и восстановить
+    // из него конец партии и открытые поля для отставшего зрителя будет не из чего
+    const bool terminal = event.message.type == Protocol::MessageType::SpectateState && event.message.finished;
+    if (!terminal && info->reliable && info->channel.pendingCount() >= SPECTATOR_MAX_IN_FLIGHT) {
+        // Зритель не успевает подтверждать: события ему пропускаются, а после
+        // разгрузки он получит одно текущее состояние вместо всех пропущенных
+        info->spectatorBehind = true;
+        m_metrics.countSpectatorSend(false);
+        return;
+    }
+    if (info->spectatorBehind) {
+        info->spectatorBehind = false;
+        const Lobby *lobby = m_lobbies.find(event.lobbyId);
+        if (lobby && event.message.type != Protocol::MessageType::SpectateState) {
+            m_metrics.countSpectatorResync();
+            transmit(*info, Protocol::encode(spectatorState(*lobby, false), info->wireFormat), true);
+            return;
         }
     }
-    return true;
+
+    QByteArray &payload = event.encoded[int(info->wireFormat)];
+    if (payload.isEmpty()) {
+        payload = Protocol::encode(event.message, info->wireFormat);
+        m_metrics.countSpectatorEncode();
+    }
+    transmit(*info, payload, true);
+    m_metrics.countSpectatorSend(true);
+}
+
+void GameServer::recordMove(Lobby &lobby, quint8 cell, bool player1) {
+    if (lobby.replay.startedAt == 0) return;
+    ReplayMove move;
+    move.cell = cell;
+    move.player1 = player1;
+    move.atMs = quint32(QDateTime::currentMSecsSinceEpoch() - lobby.replay.startedAt);
+    lobby.replay.moves.append(move);
+}
+
+void GameServer::finishReplay(Lobby &lobby, GameReplay::Outcome outcome) {
+    // Партии, восстановленные из журнала, не записываются: их начало потеряно
+    if (!m_replays || lobby.replay.startedAt == 0) return;
+    lobby.replay.outcome = outcome;
+    m_replays->append(lobby.replay);
+    lobby.replay = GameReplay();
+}
+
+void GameServer::sendMessage(const Protocol::Message &msg, ClientHandle client) {
+    ClientInfo *info = findClient(client);
+    if (!info || !info->isConnected) return;
+    const QByteArray payload = Protocol::encode(msg, info->wireFormat);
+    const bool reliable = Protocol::requiresDelivery(msg.type);
+    if (!m_collecting || !info->bundles) {
+        transmit(*info, payload, reliable);
+        return;
+    }
+    // Получателей за один разбор один-два, линейный поиск дешевле хеша
+    for (Outbound &entry : m_outbox) {
+        if (entry.client == client) {
+            entry.parts.append({payload, reliable});
+            return;
+        }
+    }
+    m_outbox.append({client, {{payload, reliable}}});
+}
+
+void GameServer::transmit(ClientInfo &info, const QByteArray &payload, bool reliable) {
+    if (!info.reliable) {
+        sendDatagram(payload, info.peer);
+        return;
+    }
+    sendDatagram(info.channel.wrap(payload, reliable, nowMs()), info.peer);
+    if (reliable) {
+        armRetransmitTimer(info);
+    }
 }
 
-bool GameServer::checkGameOver(const QJsonArray &board) {
-    // Проверяем, остались ли неповрежденные корабли
-    for (int y = 0; y < 10; y++) {
-        QJsonArray row = board[y].toArray();
-        for (int x = 0; x < 10; x++) {
-            if (row[x].toInt() == 1) {
-                return false; // Нашли неповрежденный корабль
+void GameServer::flushBundles() {
+    m_collecting = false;
+    for (Outbound &entry : m_outbox) {
+        ClientInfo *info = findClient(entry.client);
+        if (!info) continue;
+        if (entry.parts.size() == 1) {
+            transmit(*info, entry.parts.first().payload, entry.parts.first().reliable);
+            continue;
+        }
+        // Предел - на всю датаграмму: заголовок пачки, префиксы частей и
+        // конверт канала доставки тоже занимают место
+        const int limit = MAX_BUNDLE_BYTES - Protocol::bundleOverhead(info->wireFormat)
+                          - (info->reliable ? ReliableChannel::HEADER_SIZE : 0);
+        const int partOverhead = Protocol::bundlePartOverhead(info->wireFormat);
+        Protocol::Message bundle;
+        bundle.type = Protocol::MessageType::Bundle;
+        int bytes = 0;
+        // Повторять до подтверждения нужно только пачку с надежной частью
+        bool reliable = false;
+        for (const OutboundPart &part : entry.parts) {
+            const int size = part.payload.size() + partOverhead;
+            const bool full = bytes + size > limit || bundle.parts.size() == 0xFF;
+            if (!bundle.parts.isEmpty() && full) {
+                transmit(*info, Protocol::encode(bundle, info->wireFormat), reliable);
+                bundle.parts.clear();
+                bytes = 0;
+                reliable = false;
             }
+            bundle.parts.append(part.payload);
+            bytes += size;
+            reliable = reliable || part.reliable;
         }
+        transmit(*info, Protocol::encode(bundle, info->wireFormat), reliable);
     }
-    return true; // Все корабли уничтожены
+    m_outbox.clear();
 }
 
-void GameServer::endGame(const QString &lobbyId, const QString &winnerId) {
-    Lobby &lobby = m_lobbies[lobbyId];
-    QString loserId = (winnerId == lobby.player1) ? lobby.player2 : lobby.player1;
-    
-    QJsonObject winMsg, loseMsg;
-    winMsg["type"] = "game_over";
-    winMsg["result"] = "win";
-    loseMsg["type"] = "game_over";
-    loseMsg["result"] = "lose";
-    
-    sendJson(winMsg, winnerId);
-    sendJson(loseMsg, loserId);
-    
-    m_clients[lobby.player1].lobbyId = "";
-    m_clients[lobby.player2].lobbyId = "";
-    m_lobbies.remove(lobbyId);
+void GameServer::sendPendingAck(ClientInfo &info) {
+    if (info.reliable && info.channel.ackPending()) {
+        sendDatagram(info.channel.makeAck(), info.peer);
+    }
+}
+
+void GameServer::sendError(const QString &message, ClientHandle client) {
+    m_metrics.countError(message);
+    Protocol::Message error;
+    error.type = Protocol::MessageType::Error;
+    error.text = message;
+    sendMessage(error, client);
+}
+
+bool GameServer::validateClient(ClientHandle client) {
+    if (!findClient(client)) {
+        sendError("Client not registered", client);
+        return false;
+    }
+    return true;
+}
+
+bool GameServer::openSocket(quint16 port) {
+#ifdef Q_OS_LINUX
+    const bool batched = m_batchedIo && BatchedUdpIo::isSupported();
+    if (batched || m_hub) {
+        const int fd = openNativeSocket(port, m_hub != nullptr);
+        if (fd < 0) return false;
+        if (batched) {
+            m_io = new BatchedUdpIo(this);
+            m_io->open(fd, [this](const QByteArray &data, const PeerAddress &sender) {
+                processDatagram(data, sender);
+            });
+            m_io->setFlushHandler([this]() { recordReplyLatencies(); });
+            LOG_INFO << "Using batched recvmmsg/sendmmsg I/O";
+            return true;
+        }
+        return m_socket->setSocketDescriptor(fd, QAbstractSocket::BoundState);
+    }
+    return m_socket->bind(QHostAddress::Any, port);
+#else
+    if (m_hub) {
+        return m_socket->bind(QHostAddress::Any, port, QAbstractSocket::ShareAddress | QAbstractSocket::ReuseAddressHint);
+    }
+    return m_socket->bind(QHostAddress::Any, port);
+#endif
+}
+
+int GameServer::openNativeSocket(quint16 port, bool reusePort) {
+#ifdef Q_OS_LINUX
+    // Qt не умеет выставлять SO_REUSEPORT и не дает пакетных вызовов,
+    // поэтому сокет создается вручную
+    int family = AF_INET6;
+    int fd = ::socket(AF_INET6, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 && errno == EAFNOSUPPORT) {
+        // Ядро без IPv6 (ipv6.disable=1): работаем только по IPv4
+        LOG_WARNING << "IPv6 is unavailable, listening on IPv4 only";
+        family = AF_INET;
+        fd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    }
+    if (fd < 0) {
+        LOG_ERROR << "socket() failed:" << strerror(errno);
+        return -1;
+    }
+    const int on = 1;
+    const int off = 0;
+    // Без SO_REUSEPORT следующий шард не сможет занять порт
+    if (reusePort && ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+        LOG_ERROR << "SO_REUSEPORT failed:" << strerror(errno);
+        ::close(fd);
+        return -1;
+    }
+
+    int result;
+    if (family == AF_INET6) {
+        ::setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+        sockaddr_in6 addr = {};
+        addr.sin6_family = AF_INET6;
+        addr.sin6_port = htons(port);
+        addr.sin6_addr = in6addr_any;
+        result = ::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    } else {
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        result = ::bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    }
+    if (result < 0) {
+        LOG_ERROR << "bind() failed:" << strerror(errno);
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+#else
+    Q_UNUSED(port);
+    Q_UNUSED(reusePort);
+    return -1;
+#endif
 }
 
-void GameServer::sendJson(const QJsonObject &json, const QString &clientId) {
-    if (!m_clients.contains(clientId)) return;
-    const ClientInfo &client = m_clients[clientId];
-    m_socket->writeDatagram(QJsonDocument(json).toJson(), client.address, client.port);
+void GameServer::sendDatagram(const QByteArray &data, const PeerAddress &peer) {
+    m_metrics.countSent(data.size());
+    if (m_io) {
+        m_io->send(data, peer);
+    } else {
+        m_socket->writeDatagram(data, peer.hostAddress(), peer.port);
+    }
 }
 
-void GameServer::sendError(const QString &message, const QString &clientId) {
-    QJsonObject error;
-    error["type"] = "error";
-    error["message"] = message;
-    sendJson(error, clientId);
+void GameServer::flushOutbound() {
+    // Ответы, накопленные вне пачки приема (таймеры, межшардовые передачи)
+    if (m_io) {
+        m_io->flush();
+    }
 }
 
-bool GameServer::validateClient(const QString &clientId) {
-    if (!m_clients.contains(clientId)) {
-        sendError("Client not registered", clientId);
+void GameServer::recordReplyLatencies() {
+    const qint64 flushedNs = m_clock.nsecsElapsed();
+    for (qint64 receivedNs : m_pendingReplies) {
+        m_metrics.recordLatency(quint64(flushedNs - receivedNs) / 1000);
+    }
+    m_pendingReplies.clear();
+}
+
+bool GameServer::claimTicket(Lobby &lobby) {
+    // Неудачный захват значит, что соперник из другого шарда уже едет к нам:
+    // билет остается в лобби до его прибытия
+    if (!lobby.ticket->claim()) return false;
+    lobby.ticket->release();
+    lobby.ticket = nullptr;
+    return true;
+}
+
+void GameServer::releaseTicket(Lobby &lobby) {
+    if (!lobby.ticket) return;
+    lobby.ticket->claim();
+    lobby.ticket->release();
+    lobby.ticket = nullptr;
+}
+
+bool GameServer::joinRemoteLobby(ClientHandle client) {
+    while (WaitingTicket *ticket = m_hub->takeWaiting()) {
+        if (ticket->shard == m_shardIndex) {
+            // Свои лобби локальный поиск уже просмотрел: живой билет
+            // возвращаем в очередь для других шардов
+            if (!ticket->isClaimed() && m_hub->republishWaiting(ticket)) {
+                return false;
+            }
+            ticket->release();
+            continue;
+        }
+        if (!ticket->claim()) {
+            ticket->release();
+            continue;
+        }
+
+        const int targetShard = ticket->shard;
+        ShardHandoff handoff;
+        handoff.kind = ShardHandoff::Kind::JoinLobby;
+        handoff.client.reset(new ClientInfo(*findClient(client)));
+        handoff.lobbyId = ticket->lobbyId;
+
+        if (!m_hub->post(targetShard, std::move(handoff))) {
+            LOG_WARNING << "Shard" << targetShard << "inbox is full, remote join failed for" << client;
+            // Иначе владелец считал бы, что соперник уже едет, и лобби ждало
+            // бы вечно. Если лобби успеют закрыть, приехавший по билету
+            // игрок просто станет ожидающим у владельца
+            ticket->unclaim();
+            if (!m_hub->republishWaiting(ticket)) ticket->release();
+            return false;
+        }
+        ticket->release();
+        LOG_INFO << "Client" << client << "moved to shard" << targetShard;
+        ClientInfo &info = *findClient(client);
+        info.forwardShard = targetShard;
+        info.lobbyId.clear();
+        // Неподтвержденные сообщения и пинги переехали вместе с клиентом,
+        // в журнал он теперь попадает там
+        journal(JournalRecord::clientReleased(info.token));
+        m_timers.cancel(info.retransmitTimer);
+        m_timers.cancel(info.keepaliveTimer);
+        info.retransmitTimer = 0;
+        info.keepaliveTimer = 0;
+        return true;
+    }
+    return false;
+}
+
+void GameServer::acceptMigratedClient(const ClientInfo &info, const QString &lobbyId) {
+    ClientInfo migrated = info;
+    migrated.forwardShard = -1;
+    migrated.lobbyId.clear();
+    // Номер клиента и таймеры относятся к массиву и колесу прежнего шарда,
+    // здесь клиент получает новые
+    const ClientHandle client = allocateClient(migrated);
+    armRetransmitTimer(*findClient(client));
+    journal(JournalRecord::clientState(migrated.token, migrated.username, migrated.savedBoard));
+
+    Lobby *lobby = m_lobbies.find(lobbyId);
+    if (lobby && lobby->player2 == INVALID_CLIENT) {
+        releaseTicket(*lobby);
+        m_waitingQueue.take(lobbyId, QDateTime::currentMSecsSinceEpoch());
+        joinLobby(lobbyId, client);
+    } else {
+        // Лобби успело закрыться - игрок становится ожидающим уже у нас
+        createLobby(client);
+    }
+}
+
+bool GameServer::restoreState() {
+    struct SavedLobby {
+        QString player1;
+        QString player2;
+        BitBoard player1Board;
+        BitBoard player2Board;
+        bool active = false;
+        bool player1Turn = true;
+    };
+    QHash<QString, JournalRecord> clients;   // token -> username и доска
+    QHash<QString, SavedLobby> lobbies;
+    bool snapshotComplete = false;
+    quint32 firstSegment = 0;
+
+    // Записи повторяют переходы состояния без сетевой части
+    auto apply = [&](const JournalRecord &r) {
+        using Type = JournalRecord::Type;
+        switch (r.type) {
+        case Type::Login:
+            clients[r.token].username = r.username;
+            break;
+        case Type::Board:
+            clients[r.token].board = r.board;
+            break;
+        case Type::ClientState:
+            clients[r.token] = r;
+            break;
+        case Type::Reconnect:
+            clients[r.token] = clients.value(r.otherToken);
+            for (SavedLobby &lobby : lobbies) {
+                if (lobby.player1 == r.otherToken) lobby.player1 = r.token;
+                if (lobby.player2 == r.otherToken) lobby.player2 = r.token;
+            }
+            break;
+        case Type::ClientReleased:
+            clients.remove(r.token);
+            break;
+        case Type::LobbyCreated: {
+            SavedLobby lobby;
+            lobby.player1 = r.token;
+            lobby.player1Board = r.board;
+            lobbies.insert(r.lobbyId, lobby);
+            break;
+        }
+        case Type::GameStart: {
+            auto it = lobbies.find(r.lobbyId);
+            if (it == lobbies.end()) break;
+            it->player2 = r.token;
+            it->player2Board = r.board;
+            it->active = true;
+            it->player1Turn = true;
+            break;
+        }
+        case Type::Shot: {
+            auto it = lobbies.find(r.lobbyId);
+            if (it == lobbies.end() || !it->active || !BitBoard::inBounds(r.x, r.y)) break;
+            BitBoard &target = r.player1 ? it->player2Board : it->player1Board;
+            if (!target.shoot(r.x, r.y)) {
+                it->player1Turn = !it->player1Turn;
+            } else if (target.allShipsSunk()) {
+                lobbies.erase(it);
+            }
+            break;
+        }
+        case Type::TurnChange: {
+            auto it = lobbies.find(r.lobbyId);
+            if (it != lobbies.end()) it->player1Turn = r.player1;
+            break;
+        }
+        case Type::LobbyClosed:
+            lobbies.remove(r.lobbyId);
+            break;
+        case Type::LobbyState: {
+            SavedLobby lobby;
+            lobby.player1 = r.token;
+            lobby.player2 = r.otherToken;
+            lobby.player1Board = r.board;
+            lobby.player2Board = r.otherBoard;
+            lobby.active = r.active;
+            lobby.player1Turn = r.player1;
+            lobbies.insert(r.lobbyId, lobby);
+            break;
+        }
+        case Type::SnapshotEnd:
+            snapshotComplete = true;
+            firstSegment = r.sequence;
+            break;
+        }
+    };
+
+    // Снимок, затем сегменты журнала, записанные после него
+    GameJournal reader;
+    if (QFileInfo::exists(snapshotPath())) {
+        if (!reader.open(snapshotPath(), apply) || !snapshotComplete) {
+            LOG_ERROR << "Snapshot" << snapshotPath() << "is damaged, replaying the journal alone";
+            clients.clear();
+            lobbies.clear();
+            firstSegment = 0;
+        }
+        reader.close();
+    }
+    const QVector<quint32> segments = journalSegments();
+    int replayed = 0;
+    for (quint32 segment : segments) {
+        if (segment < firstSegment) continue;
+        if (!reader.open(segmentPath(segment), apply)) return false;
+        reader.close();
+        ++replayed;
+    }
+    m_segment = segments.isEmpty() ? firstSegment : qMax(firstSegment, segments.last() + 1);
+
+    QHash<QString, ClientHandle> handles;
+    for (auto it = clients.cbegin(); it != clients.cend(); ++it) {
+        ClientInfo info;
+        info.token = it.key();
+        info.username = it.value().username;
+        info.savedBoard = it.value().board;
+        info.isConnected = false;
+        handles.insert(info.token, allocateClient(info));
+    }
+
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    int games = 0;
+    for (auto it = lobbies.cbegin(); it != lobbies.cend(); ++it) {
+        const SavedLobby &saved = it.value();
+        const ClientHandle player1 = handles.value(saved.player1, INVALID_CLIENT);
+        const ClientHandle player2 = handles.value(saved.player2, INVALID_CLIENT);
+        // Игрок, чья сессия истекла до падения, свое лобби не дождется
+        if (player1 == INVALID_CLIENT || (saved.active && player2 == INVALID_CLIENT)) continue;
+
+        Lobby restored;
+        restored.id = it.key();
+        restored.player1 = player1;
+        restored.player2 = player2;
+        restored.player1Board = saved.player1Board;
+        restored.player2Board = saved.player2Board;
+        restored.player1Fleet.build(saved.player1Board.ships(), saved.player1Board.hits());
+        restored.player2Fleet.build(saved.player2Board.ships(), saved.player2Board.hits());
+        restored.player1Ready = true;
+        restored.player2Ready = saved.active;
+        restored.isActive = saved.active;
+        restored.player1Turn = saved.player1Turn;
+        Lobby &lobby = m_lobbies.insert(restored.id, restored);
+        touchLobby(lobby);
+        findClient(player1)->lobbyId = restored.id;
+        if (saved.active) {
+            findClient(player2)->lobbyId = restored.id;
+            armTurnTimer(lobby);
+            ++games;
+        } else {
+            if (m_hub) {
+                lobby.ticket = m_hub->publishWaiting(m_shardIndex, restored.id);
+            }
+            m_waitingQueue.enqueue(restored.id, now);
+        }
+    }
+    LOG_INFO << "Restored" << clients.size() << "clients," << m_lobbies.size() << "lobbies and"
+             << games << "games in progress from" << m_statePath << "(" << replayed << "journal segments )";
+
+    m_journal = new GameJournal;
+    if (!m_journal->open(segmentPath(m_segment))) {
+        delete m_journal;
+        m_journal = nullptr;
         return false;
     }
+    m_snapshotStartedMs = nowMs();
+    // Следующий запуск начнет со свежего снимка, а не с проигранных сегментов
+    if (replayed > 0) {
+        startSnapshot();
+    }
     return true;
-}
\ No newline at end of file
+}
+
+void GameServer::writeState(JournalImage &out) {
+    for (const auto &slot : m_clients) {
+        if (!slot.used || slot.info.forwardShard >= 0 || slot.info.username.isEmpty()) continue;
+        out.append(JournalRecord::clientState(slot.info.token, slot.info.username, slot.info.savedBoard));
+    }
+    for (auto &entry : m_lobbies) {
+        const Lobby &lobby = entry.value;
+        const ClientInfo *player1 = findClient(lobby.player1);
+        const ClientInfo *player2 = findClient(lobby.player2);
+        if (!player1) continue;
+        // Лобби без второго игрока пишется ожидающим: иначе восстановление
+        // увидит партию без соперника и выбросит ждущего игрока
+        const bool active = lobby.isActive && player2;
+        out.append(JournalRecord::lobbyState(lobby.id, player1->token, player2 ? player2->token : QString(),
+                                               lobby.player1Board, lobby.player2Board,
+                                               active, active ? lobby.player1Turn : true));
+    }
+}
+
+void GameServer::startSnapshot() {
+#ifdef Q_OS_LINUX
+    // Записи после снимка идут в новый сегмент: снимок заменит все предыдущие
+    GameJournal *next = new GameJournal;
+    if (!next->open(segmentPath(m_segment + 1))) {
+        delete next;
+        ++m_snapshotFailures;
+        return;
+    }
+    // Прежний сегмент закроется в pollSnapshot(): его поток сброса допишет
+    // хвост на диск, не задерживая цикл событий
+    m_retiredJournal = m_journal;
+    m_journal = next;
+    ++m_segment;
+    m_snapshotStartedMs = nowMs();
+
+    // Все, что требует Qt, памяти или блокировок, - до fork: в дочернем
+    // процессе живет только вызвавший поток, а мьютексы аллокатора, логгера
+    // и потоков сброса могли остаться захваченными
+    JournalImage image;
+    writeState(image);
+    image.append(JournalRecord::snapshotEnd(m_segment));
+    const QByteArray path = QFile::encodeName(snapshotPath());
+    const QByteArray tmpPath = path + ".tmp";
+    const QByteArray dirPath = QFile::encodeName(QFileInfo(snapshotPath()).absolutePath());
+
+    const pid_t pid = ::fork();
+    if (pid == 0) {
+        ::_exit(image.write(tmpPath.constData(), path.constData(), dirPath.constData()) ? 0 : 1);
+    }
+    if (pid < 0) {
+        LOG_WARNING << "Cannot fork snapshot writer:" << strerror(errno);
+        ++m_snapshotFailures;
+        delete m_retiredJournal;
+        m_retiredJournal = nullptr;
+        return;
+    }
+    m_snapshotKilled = false;
+    m_snapshotPid = pid;
+#endif
+}
+
+void GameServer::pollSnapshot() {
+#ifdef Q_OS_LINUX
+    if (m_snapshotPid > 0) {
+        int status = 0;
+        const pid_t done = ::waitpid(pid_t(m_snapshotPid), &status, WNOHANG);
+        if (done == 0) {
+            // Писатель застрял на диске: убиваем, сегменты остаются до
+            // следующего снимка. Процесс соберем на следующих тиках
+            if (!m_snapshotKilled && nowMs() - m_snapshotStartedMs >= SNAPSHOT_DEADLINE_MS) {
+                ::kill(pid_t(m_snapshotPid), SIGKILL);
+                m_snapshotKilled = true;
+                ++m_snapshotTimeouts;
+                LOG_WARNING << "Snapshot writer did not finish in" << SNAPSHOT_DEADLINE_MS << "ms, killed";
+            }
+            return;
+        }
+        m_snapshotPid = -1;
+        delete m_retiredJournal;
+        m_retiredJournal = nullptr;
+        if (done > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            ++m_snapshots;
+            removeSegmentsBefore(m_segment);
+            LOG_DEBUG << "Snapshot" << snapshotPath() << "written in" << nowMs() - m_snapshotStartedMs << "ms";
+        } else {
+            // Сегменты остаются: следующий удачный снимок покроет и их
+            ++m_snapshotFailures;
+            LOG_WARNING << "Snapshot writer failed, journal segments kept";
+        }
+    }
+
+    if (m_snapshotIntervalMs <= 0 || m_journal->appendedRecords() == 0) return;
+    if (nowMs() - m_snapshotStartedMs >= m_snapshotIntervalMs || m_journal->size() >= SNAPSHOT_JOURNAL_BYTES) {
+        startSnapshot();
+    }
+#endif
+}
+
+QVector<quint32> GameServer::journalSegments() const {
+    const QFileInfo prefix(m_statePath);
+    const QString stem = prefix.fileName() + ".journal.";
+    QVector<quint32> segments;
+    const QStringList names = prefix.dir().entryList(QStringList() << stem + "*", QDir::Files);
+    for (const QString &name : names) {
+        bool ok = false;
+        const quint32 segment = name.mid(stem.size()).toUInt(&ok);
+        if (ok) segments.append(segment);
+    }
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+void GameServer::removeSegmentsBefore(quint32 segment) {
+    for (quint32 old : journalSegments()) {
+        if (old < segment) {
+            QFile::remove(segmentPath(old));
+        }
+    }
+}
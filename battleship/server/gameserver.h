@@ -5,91 +5,299 @@
 #include <QUdpSocket>
 #include <QTimer>
 #include <QMap>
+#include <QHash>
+#include <QVector>
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QNetworkDatagram>
+#include <QElapsedTimer>
+#include "bitboard.h"
+#include "protocol.h"
+#include "matchmakingqueue.h"
+#include "timingwheel.h"
+#include "peeraddress.h"
+#include "flathashmap.h"
+#include "servermetrics.h"
+#include "reliablechannel.h"
+#include "gamejournal.h"
+#include "gamereplay.h"
 
+class BatchedUdpIo;
+
+class MatchmakingHub;
+struct WaitingTicket;
+
+// Внутренний номер клиента: младшие 24 бита - индекс слота в массиве
+// клиентов, старшие 8 - поколение слота. Поколение меняется при каждом
+// освобождении слота, так что устаревший номер не попадет к новому владельцу.
+using ClientHandle = quint32;
+constexpr ClientHandle INVALID_CLIENT = 0;
 
 struct ClientInfo {
-    QString id;
-    QHostAddress address;
-    quint16 port;
+    ClientHandle handle = INVALID_CLIENT;
+    QString token;           // внешний идентификатор (UUID) для reconnect
+    PeerAddress peer;
     qint64 lastActive;
     QString username;
     QString lobbyId;
     bool isConnected;
-    QJsonArray savedBoard;
+    int forwardShard = -1;   // >= 0: клиент обслуживается другим шардом
+    Protocol::WireFormat wireFormat = Protocol::WireFormat::Json;
+    BitBoard savedBoard;
+    quint32 sessionTimer = 0;   // таймер колеса, истекающий при молчании клиента
+    bool reliable = false;      // клиент договорился о надежной доставке
+    ReliableChannel channel;
+    quint32 retransmitTimer = 0;   // ближайший повтор неподтвержденных сообщений
+    bool bundles = false;          // клиент разбирает пачки сообщений
+    qint64 lastInboundMs = 0;      // последняя датаграмма от клиента (часы сервера)
+    quint32 keepaliveTimer = 0;
+    int keepaliveIntervalMs = 0;   // растет, пока клиент молчит вне игры
+    QString spectating;            // лобби, за которым клиент наблюдает
+    bool spectatorBehind = false;  // события пропущены, нужен новый снимок
 };
 
 struct Lobby {
     QString id;
-    QString player1;
-    QString player2;
-    QJsonArray player1Board;
-    QJsonArray player2Board;
-    bool player1Ready;
-    bool player2Ready;
-    bool isActive;
-    bool player1Turn;
-    qint64 lastActivity;
+    ClientHandle player1 = INVALID_CLIENT;
+    ClientHandle player2 = INVALID_CLIENT;
+    BitBoard player1Board;
+    BitBoard player2Board;
+    FleetIndex player1Fleet;           // корабли полей, строятся в startGame
+    FleetIndex player2Fleet;
+    bool player1Ready = false;
+    bool player2Ready = false;
+    bool isActive = false;             // второй игрок есть, партия идет
+    bool player1Turn = true;
+    qint64 lastActivity = 0;
+    WaitingTicket *ticket = nullptr;   // объявление для других шардов, пока лобби ждет
+    quint32 expiryTimer = 0;           // закрытие лобби по бездействию
+    quint32 turnTimer = 0;             // передача хода, если игрок не стреляет
+    GameReplay replay;                 // запись идущей партии, startedAt = 0 - не ведется
+    QVector<ClientHandle> spectators;
+};
+
+// Событие партии для зрителей. Кодируется один раз на формат и рассылается
+// из тика колеса порциями, чтобы зрители не задерживали ответы игрокам.
+struct SpectatorEvent {
+    QString lobbyId;
+    Protocol::Message message;
+    QByteArray encoded[2];              // по Protocol::WireFormat, по первому запросу
+    QVector<ClientHandle> audience;     // зрители на момент события (общая копия)
+};
+
+// Владелец таймера в колесе сервера
+struct ExpiryTarget {
+    enum class Kind { Session, Lobby, Turn, Retransmit, Keepalive };
+
+    Kind kind = Kind::Session;
+    ClientHandle client = INVALID_CLIENT;
+    QString lobbyId;
 };
 
 class GameServer : public QObject
 {
     Q_OBJECT
+    // Микробенчмарк вызывает игровую логику напрямую (bench/gamelogic)
+    friend class GameLogicBench;
 public:
     explicit GameServer(QObject *parent = nullptr);
     ~GameServer();
 
     bool start(quint16 port);
     void stop();
+    // Работа шардом многопоточного сервера, вызывается до start()
+    void attachToHub(MatchmakingHub *hub, int shardIndex);
+    // Пакетный прием/отправка через recvmmsg/sendmmsg (только Linux),
+    // вызывается до start(). Выключенный режим работает через QUdpSocket.
+    void setBatchedIo(bool enabled) { m_batchedIo = enabled; }
+    // Состояние для восстановления после падения, вызывается до start():
+    // снимок <prefix>.snapshot и сегменты журнала <prefix>.journal.<N>.
+    // При запуске читается снимок и проигрывается хвост журнала после него.
+    void setStatePath(const QString &prefix) { m_statePath = prefix; }
+    // Период снимков состояния; 0 - снимок только при запуске
+    void setSnapshotInterval(int seconds) { m_snapshotIntervalMs = qint64(seconds) * 1000; }
+    // Каталог записей партий, вызывается до start(). Каждый запуск шарда
+    // пишет свой файл shard-<N>-<время запуска>.replays.
+    void setReplayDir(const QString &dir) { m_replayDir = dir; }
+
+    // Глубина очереди подбора и время ожидания соперника
+    MatchmakingStats matchmakingStats() const;
+    // Счетчики, текущие размеры и гистограмма задержек ответа
+    QJsonObject stats();
 
 private slots:
     void onReadyRead();
     void onError(QAbstractSocket::SocketError socketError);
-    void onGameTimeout();
-    void onSessionTimeout();
-    void onPingTimerTimeout();
+    void onWheelTick();
+    void onHandoffsPending();
 
 private:
     // Основные функции
-    void handleLogin(const QJsonObject &json, const QString &clientId);
-    void handleReady(const QJsonObject &json, const QString &clientId);
-    void handleShot(const QJsonObject &json, const QString &clientId);
-    void handlePing(const QJsonObject &json, const QString &clientId);
-    void handleReconnect(const QJsonObject &json, const QString &clientId);
-    void handleBoard(const QJsonObject &json, const QString &clientId);
-    void handleChatMessage(const QJsonObject &json, const QString &clientId);
+    void handleLogin(const Protocol::Message &msg, Protocol::WireFormat format, ClientHandle client);
+    void handleReady(const Protocol::Message &msg, ClientHandle client);
+    void handleShot(const Protocol::Message &msg, ClientHandle client);
+    void handlePing(const Protocol::Message &msg, ClientHandle client);
+    void handleReconnect(const Protocol::Message &msg, ClientHandle client);
+    void handleBoard(const Protocol::Message &msg, ClientHandle client);
+    void handleChatMessage(const Protocol::Message &msg, ClientHandle client);
+    void handleStats(const Protocol::Message &msg, Protocol::WireFormat format, const PeerAddress &sender);
+    void handleSpectate(const Protocol::Message &msg, ClientHandle client);
     
     // Вспомогательные функции
-    QString getClientId(const QHostAddress &address, quint16 port);
+    void processDatagram(const QByteArray &data, const PeerAddress &sender);
+    void dispatchMessage(const Protocol::Message &msg, Protocol::WireFormat format, ClientHandle client);
+    ClientHandle resolveClient(const PeerAddress &peer);
+
+    // Массив клиентов
+    ClientInfo *findClient(ClientHandle client);
+    ClientHandle allocateClient(const ClientInfo &info);
+    void releaseClient(ClientHandle client);
+    void createLobby(ClientHandle client);
+    void joinLobby(const QString &lobbyId, ClientHandle client);
+
+    // Сокет и ввод-вывод
+    bool openSocket(quint16 port);
+    int openNativeSocket(quint16 port, bool reusePort);
+    void sendDatagram(const QByteArray &data, const PeerAddress &peer);
+    void flushOutbound();
+    void recordReplyLatencies();
+
+    // Межшардовый подбор
+    bool claimTicket(Lobby &lobby);
+    void releaseTicket(Lobby &lobby);
+    bool joinRemoteLobby(ClientHandle client);
+    void acceptMigratedClient(const ClientInfo &info, const QString &lobbyId);
     QString generateLobbyId() const;
-    bool validateBoard(const QJsonArray &board);
+    bool validateBoard(const BitBoard &board);
     void cleanupLobby(const QString &lobbyId);
     void startGame(const QString &lobbyId);
-    void processShotResult(const QString &lobbyId, const QString &shooterId, int x, int y);
+    void processShotResult(const QString &lobbyId, ClientHandle shooter, int x, int y);
     bool checkWinCondition(const QJsonArray &board);
-    void endGame(const QString &lobbyId, const QString &winnerId);
-    void sendJson(const QJsonObject &json, const QString &clientId);
-    void sendError(const QString &message, const QString &clientId);
-    bool validateClient(const QString &clientId);
-    bool checkShipSunk(const QJsonArray &board, int x, int y);
+    void endGame(const QString &lobbyId, ClientHandle winner);
+    void sendMessage(const Protocol::Message &msg, ClientHandle client);
+    void transmit(ClientInfo &info, const QByteArray &payload, bool reliable);
+    void flushBundles();
+    void sendPendingAck(ClientInfo &info);
+    void sendError(const QString &message, ClientHandle client);
+    bool validateClient(ClientHandle client);
+    bool checkShipSunk(const FleetIndex &fleet, int x, int y);
+
+    bool checkGameOver(const FleetIndex &fleet);
+
+    // Сроки сессий, лобби и ходов
+    qint64 nowMs() const { return m_clock.elapsed(); }
+    void touchSession(ClientInfo &client);
+    void touchLobby(Lobby &lobby);
+    void armTurnTimer(Lobby &lobby);
+    void cancelLobbyTimers(Lobby &lobby);
+    void expireSession(ClientHandle client);
+    void expireLobby(const QString &lobbyId);
+    void expireTurn(const QString &lobbyId);
+    void armRetransmitTimer(ClientInfo &info);
+    void expireRetransmit(ClientHandle client);
+    void scheduleKeepalive(ClientInfo &info, qint64 deadline);
+    void expireKeepalive(ClientHandle client);
+
+    // Журнал событий
+    void journal(const JournalRecord &record) {
+        if (m_journal) m_journal->append(record);
+    }
+    bool restoreState();
+    void writeState(JournalImage &out);
+    // Снимок собирается в памяти, а на диск его пишет дочерний процесс:
+    // цикл событий не ждет fdatasync, а зависшего писателя можно убить
+    void startSnapshot();
+    void pollSnapshot();
+    QString snapshotPath() const { return m_statePath + ".snapshot"; }
+    QString segmentPath(quint32 segment) const { return m_statePath + ".journal." + QString::number(segment); }
+    QVector<quint32> journalSegments() const;
+    void removeSegmentsBefore(quint32 segment);
+
+    // Зрители
+    // Поле зрителя: до конца партии только обстрелянные клетки
+    Protocol::Message spectatorState(const Lobby &lobby, bool finished, ClientHandle winner = INVALID_CLIENT);
+    void publishShot(const Lobby &lobby, ClientHandle shooter, int x, int y, bool hit, bool sunk);
+    void publishToSpectators(const Lobby &lobby, const Protocol::Message &event);
+    void removeSpectator(ClientInfo &info);
+    void fanOutSpectators();
+    void deliverToSpectator(SpectatorEvent &event, ClientHandle spectator);
 
-    bool checkGameOver(const QJsonArray &board);
+    // Записи партий
+    void recordMove(Lobby &lobby, quint8 cell, bool player1);
+    void finishReplay(Lobby &lobby, GameReplay::Outcome outcome);
 
     // Константы
     static constexpr int GAME_TIMEOUT_MS = 1800000; // 30 минут
     static constexpr int SESSION_TIMEOUT_S = 300;   // 5 минут
-    static constexpr int PING_INTERVAL_MS = 10000;  // 10 секунд
+    static constexpr int TURN_TIMEOUT_S = 90;       // полторы минуты на ход
+    static constexpr int KEEPALIVE_INTERVAL_MS = 10000;      // пинг молчащему игроку
+    static constexpr int KEEPALIVE_MAX_INTERVAL_MS = 60000;  // предел отсрочки вне игры
+    static constexpr int WHEEL_TICK_MS = 50;        // точность всех сроков, включая повторы
+    static constexpr int MAX_BUNDLE_BYTES = 1200;   // пачка не должна дробиться по MTU
+    static constexpr int SNAPSHOT_INTERVAL_S = 60;
+    static constexpr qint64 SNAPSHOT_JOURNAL_BYTES = qint64(64) << 20;  // внеочередной снимок
+    static constexpr int SNAPSHOT_DEADLINE_MS = 30000;      // дольше писатель считается зависшим
+    static constexpr int REPLAY_FLUSH_MS = 1000;
+    static constexpr int SPECTATOR_SENDS_PER_TICK = 4096;   // остальное ждет следующего тика
+    static constexpr int SPECTATOR_MAX_IN_FLIGHT = 16;      // неподтвержденных у одного зрителя
+    static constexpr int HANDLE_INDEX_BITS = 24;
+    static constexpr quint32 HANDLE_INDEX_MASK = (1u << HANDLE_INDEX_BITS) - 1;
 
     // Члены класса
     QUdpSocket *m_socket;
-    QTimer *m_gameTimer;
-    QTimer *m_sessionTimer;
-    QTimer *m_pingTimer;
-    QMap<QString, ClientInfo> m_clients;
-    QMap<QString, Lobby> m_lobbies;
-    QMap<QString, QString> m_clientAddressToId;
+    BatchedUdpIo *m_io;
+    bool m_batchedIo;
+    QTimer *m_wheelTimer;
+    QElapsedTimer m_clock;
+    TimingWheel<ExpiryTarget> m_timers;
+    struct ClientSlot {
+        ClientInfo info;
+        quint8 generation = 1;
+        bool used = false;
+    };
+    QVector<ClientSlot> m_clients;
+    QVector<quint32> m_freeSlots;
+    FlatHashMap<PeerAddress, ClientHandle, QtKeyHash> m_peerToClient;
+    FlatHashMap<QString, ClientHandle, QtKeyHash> m_tokenToClient;
+    FlatHashMap<QString, Lobby, QtKeyHash> m_lobbies;
+    MatchmakingQueue m_waitingQueue;
+    MatchmakingHub *m_hub;
+    int m_shardIndex;
+    ServerMetrics m_metrics;
+    // Время приема датаграмм, ответы на которые еще лежат в пачке отправки
+    QVector<qint64> m_pendingReplies;
+    // Сообщения, накопленные за разбор одной датаграммы: каждому получателю
+    // они уходят одной пачкой в порядке отправки
+    struct OutboundPart {
+        QByteArray payload;
+        bool reliable;
+    };
+    struct Outbound {
+        ClientHandle client;
+        QVector<OutboundPart> parts;
+    };
+    QVector<Outbound> m_outbox;
+    bool m_collecting = false;
+    QString m_statePath;
+    GameJournal *m_journal = nullptr;
+    // Сегмент, в который пишет m_journal. Прежний сегмент закрывается, когда
+    // снимок, начатый при переключении, ляжет на диск.
+    quint32 m_segment = 0;
+    GameJournal *m_retiredJournal = nullptr;
+    qint64 m_snapshotIntervalMs = qint64(SNAPSHOT_INTERVAL_S) * 1000;
+    qint64 m_snapshotPid = -1;
+    qint64 m_snapshotStartedMs = 0;
+    quint64 m_snapshots = 0;
+    quint64 m_snapshotFailures = 0;
+    quint64 m_snapshotTimeouts = 0;
+    bool m_snapshotKilled = false;
+    QString m_replayDir;
+    // Очередь рассылки зрителям и позиция в ней: событие и его зритель
+    QVector<SpectatorEvent> m_spectatorEvents;
+    int m_fanOutEvent = 0;
+    int m_fanOutSpectator = 0;
+    ReplayWriter *m_replays = nullptr;
+    qint64 m_replayFlushMs = 0;
 };
 
 #endif // GAMESERVER_H
\ No newline at end of file
@@ -0,0 +1,234 @@
+#include "logger.h"
+#include "mpmcqueue.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <thread>
+
+std::atomic<int> Logger::s_level{int(LogLevel::Info)};
+
+namespace {
+
+constexpr size_t QUEUE_CAPACITY = 1 << 14;
+constexpr int IDLE_SLEEP_MS = 2;
+
+struct LoggerState {
+    MpmcQueue<Logger::Record> queue{QUEUE_CAPACITY};
+    std::atomic<bool> running{false};
+    std::atomic<quint64> dropped{0};
+    std::thread drainer;
+};
+
+LoggerState &state() {
+    static LoggerState instance;
+    return instance;
+}
+
+thread_local char t_threadName[Logger::THREAD_NAME_SIZE] = "main";
+
+const char *levelTag(LogLevel level) {
+    switch (level) {
+    case LogLevel::Trace: return "T";
+    case LogLevel::Debug: return "D";
+    case LogLevel::Info: return "I";
+    case LogLevel::Warning: return "W";
+    case LogLevel::Error: return "E";
+    default: return "?";
+    }
+}
+
+void writeRecord(const Logger::Record &record) {
+    const time_t seconds = time_t(record.timeNs / 1000000000);
+    const int millis = int(record.timeNs / 1000000 % 1000);
+    tm local;
+    localtime_r(&seconds, &local);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &local);
+    std::fprintf(stderr, "%s.%03d %s [%s] %.*s\n", stamp, millis, levelTag(record.level),
+                 record.thread, record.length, record.text);
+}
+
+void drainLoop() {
+    LoggerState &s = state();
+    Logger::Record record;
+    for (;;) {
+        bool wrote = false;
+        while (s.queue.pop(record)) {
+            writeRecord(record);
+            wrote = true;
+        }
+        if (wrote) {
+            std::fflush(stderr);
+        }
+        if (!s.running.load(std::memory_order_acquire)) {
+            // Последний проход после stop() уже выполнен выше
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(IDLE_SLEEP_MS));
+    }
+}
+
+} // namespace
+
+bool Logger::parseLevel(const QString &name, LogLevel *level) {
+    static const struct { const char *name; LogLevel level; } names[] = {
+        {"trace", LogLevel::Trace}, {"debug", LogLevel::Debug}, {"info", LogLevel::Info},
+        {"warning", LogLevel::Warning}, {"error", LogLevel::Error}, {"off", LogLevel::Off}
+    };
+    const QString lower = name.trimmed().toLower();
+    for (const auto &entry : names) {
+        if (lower == entry.name) {
+            *level = entry.level;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Logger::setThreadName(const char *name) {
+    std::strncpy(t_threadName, name, THREAD_NAME_SIZE - 1);
+    t_threadName[THREAD_NAME_SIZE - 1] = '\0';
+}
+
+void Logger::start() {
+    LoggerState &s = state();
+    if (s.running.exchange(true)) return;
+    s.drainer = std::thread(drainLoop);
+}
+
+void Logger::stop() {
+    LoggerState &s = state();
+    if (!s.running.exchange(false)) return;
+    s.drainer.join();
+    const quint64 dropped = s.dropped.load();
+    if (dropped > 0) {
+        std::fprintf(stderr, "logger: %llu records dropped on full queue\n",
+                     static_cast<unsigned long long>(dropped));
+    }
+}
+
+void Logger::submit(Record &record) {
+    record.timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    std::memcpy(record.thread, t_threadName, THREAD_NAME_SIZE);
+
+    LoggerState &s = state();
+    if (!s.running.load(std::memory_order_acquire)) {
+        writeRecord(record);
+        return;
+    }
+    if (!s.queue.push(record)) {
+        s.dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+quint64 Logger::droppedCount() {
+    return state().dropped.load(std::memory_order_relaxed);
+}
+
+LogStream::LogStream(LogLevel level) {
+    m_record.level = level;
+}
+
+LogStream::~LogStream() {
+    Logger::submit(m_record);
+}
+
+void LogStream::separate() {
+    if (m_record.length > 0) append(" ", 1);
+}
+
+void LogStream::append(const char *data, int size) {
+    const int room = Logger::MESSAGE_SIZE - m_record.length;
+    if (size > room) size = room;
+    std::memcpy(m_record.text + m_record.length, data, size_t(size));
+    m_record.length += size;
+}
+
+LogStream &LogStream::operator<<(const char *text) {
+    separate();
+    append(text, int(std::strlen(text)));
+    return *this;
+}
+
+LogStream &LogStream::operator<<(const QString &text) {
+    separate();
+    // UTF-16 -> UTF-8 прямо в буфер записи, без временного QByteArray
+    char buffer[4];
+    const int count = text.size();
+    for (int i = 0; i < count && m_record.length < Logger::MESSAGE_SIZE; ++i) {
+        uint code = text.at(i).unicode();
+        if (code >= 0xD800 && code < 0xDC00 && i + 1 < count) {
+            const uint low = text.at(i + 1).unicode();
+            if (low >= 0xDC00 && low < 0xE000) {
+                code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                ++i;
+            }
+        }
+        int size;
+        if (code < 0x80) {
+            buffer[0] = char(code);
+            size = 1;
+        } else if (code < 0x800) {
+            buffer[0] = char(0xC0 | (code >> 6));
+            buffer[1] = char(0x80 | (code & 0x3F));
+            size = 2;
+        } else if (code < 0x10000) {
+            buffer[0] = char(0xE0 | (code >> 12));
+            buffer[1] = char(0x80 | ((code >> 6) & 0x3F));
+            buffer[2] = char(0x80 | (code & 0x3F));
+            size = 3;
+        } else {
+            buffer[0] = char(0xF0 | (code >> 18));
+            buffer[1] = char(0x80 | ((code >> 12) & 0x3F));
+            buffer[2] = char(0x80 | ((code >> 6) & 0x3F));
+            buffer[3] = char(0x80 | (code & 0x3F));
+            size = 4;
+        }
+        // Многобайтовый символ не разрезается на границе буфера
+        if (size > Logger::MESSAGE_SIZE - m_record.length) break;
+        append(buffer, size);
+    }
+    return *this;
+}
+
+LogStream &LogStream::operator<<(const QByteArray &text) {
+    separate();
+    append(text.constData(), text.size());
+    return *this;
+}
+
+LogStream &LogStream::operator<<(char c) {
+    separate();
+    append(&c, 1);
+    return *this;
+}
+
+LogStream &LogStream::operator<<(bool value) {
+    return *this << (value ? "true" : "false");
+}
+
+LogStream &LogStream::operator<<(double value) {
+    char buffer[32];
+    const int size = std::snprintf(buffer, sizeof(buffer), "%g", value);
+    separate();
+    append(buffer, size);
+    return *this;
+}
+
+LogStream &LogStream::appendSigned(long long value) {
+    char buffer[24];
+    const int size = std::snprintf(buffer, sizeof(buffer), "%lld", value);
+    separate();
+    append(buffer, size);
+    return *this;
+}
+
+LogStream &LogStream::appendUnsigned(unsigned long long value) {
+    char buffer[24];
+    const int size = std::snprintf(buffer, sizeof(buffer), "%llu", value);
+    separate();
+    append(buffer, size);
+    return *this;
+}
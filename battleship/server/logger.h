@@ -0,0 +1,108 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <QByteArray>
+#include <QString>
+#include <atomic>
+#include <cstdint>
+
+// Минимальный уровень, который вообще попадает в сборку. Вызовы ниже него
+// отсекаются условием на константе и вырезаются компилятором целиком, вместе
+// с форматированием аргументов. GameServer.pro выставляет Info для release.
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
+enum class LogLevel : int {
+    Trace = 0,
+    Debug,
+    Info,
+    Warning,
+    Error,
+    Off
+};
+
+// Асинхронный журнал сервера. Рабочие потоки только копируют готовую строку
+// в запись фиксированного размера и кладут ее в lock-free очередь; запись
+// в stderr и форматирование времени делает отдельный поток. При
+// переполнении очереди записи отбрасываются, а не блокируют обработку
+// датаграмм. Пока фоновый поток не запущен, записи печатаются сразу.
+class Logger
+{
+public:
+    static constexpr int MESSAGE_SIZE = 200;
+    static constexpr int THREAD_NAME_SIZE = 16;
+
+    struct Record {
+        int64_t timeNs = 0;
+        LogLevel level = LogLevel::Info;
+        int length = 0;
+        char thread[THREAD_NAME_SIZE] = {};
+        char text[MESSAGE_SIZE];
+    };
+
+    static bool isEnabled(LogLevel level) {
+        return int(level) >= s_level.load(std::memory_order_relaxed);
+    }
+    static void setLevel(LogLevel level) { s_level.store(int(level), std::memory_order_relaxed); }
+    static LogLevel level() { return LogLevel(s_level.load(std::memory_order_relaxed)); }
+    static bool parseLevel(const QString &name, LogLevel *level);
+
+    // Имя потока в записях, например "shard-2"
+    static void setThreadName(const char *name);
+
+    static void start();
+    // Дописывает все, что осталось в очереди, и останавливает поток
+    static void stop();
+
+    static void submit(Record &record);
+    static quint64 droppedCount();
+
+private:
+    static std::atomic<int> s_level;
+};
+
+// Построчная запись в стиле qDebug(): аргументы разделяются пробелами,
+// строка уходит в журнал в деструкторе. Не выделяет памяти.
+class LogStream
+{
+public:
+    explicit LogStream(LogLevel level);
+    ~LogStream();
+
+    LogStream(const LogStream &) = delete;
+    LogStream &operator=(const LogStream &) = delete;
+
+    LogStream &operator<<(const char *text);
+    LogStream &operator<<(const QString &text);
+    LogStream &operator<<(const QByteArray &text);
+    LogStream &operator<<(char c);
+    LogStream &operator<<(bool value);
+    LogStream &operator<<(int value) { return appendSigned(value); }
+    LogStream &operator<<(long value) { return appendSigned(value); }
+    LogStream &operator<<(long long value) { return appendSigned(value); }
+    LogStream &operator<<(unsigned value) { return appendUnsigned(value); }
+    LogStream &operator<<(unsigned long value) { return appendUnsigned(value); }
+    LogStream &operator<<(unsigned long long value) { return appendUnsigned(value); }
+    LogStream &operator<<(unsigned short value) { return appendUnsigned(value); }
+    LogStream &operator<<(double value);
+
+private:
+    LogStream &appendSigned(long long value);
+    LogStream &appendUnsigned(unsigned long long value);
+    void separate();
+    void append(const char *data, int size);
+
+    Logger::Record m_record;
+};
+
+#define LOG_AT(level) \
+    if (int(level) < LOG_MIN_LEVEL || !Logger::isEnabled(level)) {} else LogStream(level)
+
+#define LOG_TRACE LOG_AT(LogLevel::Trace)
+#define LOG_DEBUG LOG_AT(LogLevel::Debug)
+#define LOG_INFO LOG_AT(LogLevel::Info)
+#define LOG_WARNING LOG_AT(LogLevel::Warning)
+#define LOG_ERROR LOG_AT(LogLevel::Error)
+
+#endif // LOGGER_H
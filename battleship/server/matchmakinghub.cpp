@@ -0,0 +1,61 @@
+#include "matchmakinghub.h"
+#include <QMetaObject>
+
+MatchmakingHub::MatchmakingHub(int shardCount) :
+    m_shardCount(shardCount),
+    m_shards(new Shard[shardCount]),
+    m_waiting(WAITING_CAPACITY)
+{
+    for (int i = 0; i < m_shardCount; ++i) {
+        m_shards[i].inbox.reset(new MpmcQueue<ShardHandoff>(INBOX_CAPACITY));
+    }
+}
+
+MatchmakingHub::~MatchmakingHub() {
+    WaitingTicket *ticket;
+    while (m_waiting.pop(ticket)) {
+        ticket->release();
+    }
+}
+
+void MatchmakingHub::attach(int shard, GameServer *server) {
+    m_shards[shard].server = server;
+}
+
+bool MatchmakingHub::post(int shard, ShardHandoff handoff) {
+    Shard &target = m_shards[shard];
+    if (!target.inbox->push(std::move(handoff))) {
+        return false;
+    }
+    if (!target.wakeScheduled.exchange(true, std::memory_order_acq_rel)) {
+        QMetaObject::invokeMethod(target.server, "onHandoffsPending", Qt::QueuedConnection);
+    }
+    return true;
+}
+
+bool MatchmakingHub::takeHandoff(int shard, ShardHandoff &handoff) {
+    return m_shards[shard].inbox->pop(handoff);
+}
+
+void MatchmakingHub::clearWake(int shard) {
+    m_shards[shard].wakeScheduled.store(false, std::memory_order_release);
+}
+
+WaitingTicket *MatchmakingHub::publishWaiting(int shard, const QString &lobbyId) {
+    WaitingTicket *ticket = new WaitingTicket(shard, lobbyId);
+    if (!m_waiting.push(ticket)) {
+        // Очередь не получила своей ссылки, а владельцу билет без очереди не нужен
+        delete ticket;
+        return nullptr;
+    }
+    return ticket;
+}
+
+bool MatchmakingHub::republishWaiting(WaitingTicket *ticket) {
+    return m_waiting.push(ticket);
+}
+
+WaitingTicket *MatchmakingHub::takeWaiting() {
+    WaitingTicket *ticket = nullptr;
+    return m_waiting.pop(ticket) ? ticket : nullptr;
+}
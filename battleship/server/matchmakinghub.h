@@ -0,0 +1,91 @@
+#ifndef MATCHMAKINGHUB_H
+#define MATCHMAKINGHUB_H
+
+#include <atomic>
+#include <memory>
+#include "gameserver.h"
+#include "mpmcqueue.h"
+
+// Объявление об ожидающем лобби, видимое всем шардам. Забрать игрока может
+// только тот, кто первым выставит claimed: шард-владелец при локальной паре
+// или отмене, либо чужой шард при межшардовом подборе.
+struct WaitingTicket {
+    WaitingTicket(int shardIndex, const QString &lobby) : shard(shardIndex), lobbyId(lobby) {}
+
+    bool claim() {
+        bool expected = false;
+        return claimed.compare_exchange_strong(expected, true, std::memory_order_acq_rel);
+    }
+    bool isClaimed() const { return claimed.load(std::memory_order_acquire); }
+    // Возврат захвата, если переезд к владельцу не состоялся
+    void unclaim() { claimed.store(false, std::memory_order_release); }
+
+    // Одна ссылка у лобби-владельца, вторая - у общей очереди
+    void release() {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+    }
+
+    const int shard;
+    const QString lobbyId;
+    std::atomic<bool> claimed{false};
+    std::atomic<int> refs{2};
+};
+
+// Запись, передаваемая между потоками шардов. Состояние клиента (строки,
+// поле, канал доставки) едет отдельным объектом и только при переезде:
+// ячейки очереди и каждая пересланная датаграмма его не копируют.
+struct ShardHandoff {
+    enum class Kind {
+        Datagram,   // датаграмма клиента, которого обслуживает другой шард
+        JoinLobby   // клиент переезжает в шард, где ждет его соперник
+    };
+
+    Kind kind = Kind::Datagram;
+    QByteArray data;
+    PeerAddress peer;
+    std::unique_ptr<ClientInfo> client;   // только JoinLobby
+    QString lobbyId;
+};
+
+// Общая точка обмена между шардами многопоточного сервера: входящие очереди
+// каждого шарда и очередь ожидающих лобби. Все операции lock-free, кроме
+// пробуждения потока-получателя, которое ставится не чаще одного раза на
+// пачку записей.
+class MatchmakingHub
+{
+public:
+    explicit MatchmakingHub(int shardCount);
+    ~MatchmakingHub();
+
+    int shardCount() const { return m_shardCount; }
+    void attach(int shard, GameServer *server);
+
+    bool post(int shard, ShardHandoff handoff);
+    bool takeHandoff(int shard, ShardHandoff &handoff);
+    // Вызывается шардом перед разбором своей очереди
+    void clearWake(int shard);
+
+    // Возвращает билет со ссылкой владельца или nullptr, если очередь заполнена
+    WaitingTicket *publishWaiting(int shard, const QString &lobbyId);
+    bool republishWaiting(WaitingTicket *ticket);
+    WaitingTicket *takeWaiting();
+
+private:
+    // Пересылки приходят пачкой за один разбор сокета чужого шарда и
+    // разбираются за одно пробуждение; переполнение - потеря датаграммы,
+    // как в сети, надежная доставка ее повторит
+    static constexpr size_t INBOX_CAPACITY = 1 << 12;
+    static constexpr size_t WAITING_CAPACITY = 1 << 16;
+
+    struct Shard {
+        GameServer *server = nullptr;
+        std::unique_ptr<MpmcQueue<ShardHandoff>> inbox;
+        std::atomic<bool> wakeScheduled{false};
+    };
+
+    int m_shardCount;
+    std::unique_ptr<Shard[]> m_shards;
+    MpmcQueue<WaitingTicket *> m_waiting;
+};
+
+#endif // MATCHMAKINGHUB_H
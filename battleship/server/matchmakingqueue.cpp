@@ -0,0 +1,54 @@
+#include "matchmakingqueue.h"
+
+void MatchmakingQueue::enqueue(const QString &lobbyId, qint64 nowMs) {
+    if (m_index.contains(lobbyId)) return;
+    m_entries.push_back({lobbyId, nowMs});
+    m_index.insert(lobbyId, std::prev(m_entries.end()));
+    ++m_stats.enqueued;
+}
+
+QString MatchmakingQueue::takeFirst(qint64 nowMs) {
+    if (m_entries.empty()) return QString();
+    const Entry entry = m_entries.front();
+    m_entries.pop_front();
+    m_index.remove(entry.lobbyId);
+    recordMatch(entry, nowMs);
+    return entry.lobbyId;
+}
+
+bool MatchmakingQueue::take(const QString &lobbyId, qint64 nowMs) {
+    auto it = m_index.find(lobbyId);
+    if (it == m_index.end()) return false;
+    recordMatch(*it.value(), nowMs);
+    m_entries.erase(it.value());
+    m_index.erase(it);
+    return true;
+}
+
+bool MatchmakingQueue::cancel(const QString &lobbyId) {
+    auto it = m_index.find(lobbyId);
+    if (it == m_index.end()) return false;
+    m_entries.erase(it.value());
+    m_index.erase(it);
+    ++m_stats.cancelled;
+    return true;
+}
+
+void MatchmakingQueue::clear() {
+    m_entries.clear();
+    m_index.clear();
+}
+
+MatchmakingStats MatchmakingQueue::stats(qint64 nowMs) const {
+    MatchmakingStats result = m_stats;
+    result.depth = depth();
+    result.oldestWaitMs = m_entries.empty() ? 0 : nowMs - m_entries.front().enqueuedAt;
+    return result;
+}
+
+void MatchmakingQueue::recordMatch(const Entry &entry, qint64 nowMs) {
+    const qint64 waited = nowMs - entry.enqueuedAt;
+    ++m_stats.matched;
+    m_stats.totalWaitMs += waited;
+    if (waited > m_stats.maxWaitMs) m_stats.maxWaitMs = waited;
+}
@@ -0,0 +1,52 @@
+#ifndef MATCHMAKINGQUEUE_H
+#define MATCHMAKINGQUEUE_H
+
+#include <QHash>
+#include <QString>
+#include <list>
+
+struct MatchmakingStats {
+    int depth = 0;              // сколько лобби ждут соперника сейчас
+    quint64 enqueued = 0;
+    quint64 matched = 0;
+    quint64 cancelled = 0;      // таймаут, отключение, закрытие лобби
+    qint64 totalWaitMs = 0;     // суммарное ожидание подобранных игроков
+    qint64 maxWaitMs = 0;
+    qint64 oldestWaitMs = 0;    // сколько ждет первый в очереди
+
+    qint64 averageWaitMs() const { return matched ? totalWaitMs / qint64(matched) : 0; }
+};
+
+// Очередь лобби, ожидающих второго игрока. Порядок - FIFO, все операции,
+// включая отмену из середины очереди, выполняются за O(1): элементы лежат
+// в списке, а хеш по id лобби указывает на узел списка.
+class MatchmakingQueue
+{
+public:
+    void enqueue(const QString &lobbyId, qint64 nowMs);
+    // Первый ожидающий или пустая строка; вынутое лобби считается подобранным
+    QString takeFirst(qint64 nowMs);
+    // Лобби подобрано в обход очереди (например, соперником из другого шарда)
+    bool take(const QString &lobbyId, qint64 nowMs);
+    bool cancel(const QString &lobbyId);
+    void clear();
+
+    bool contains(const QString &lobbyId) const { return m_index.contains(lobbyId); }
+    int depth() const { return m_index.size(); }
+    MatchmakingStats stats(qint64 nowMs) const;
+
+private:
+    struct Entry {
+        QString lobbyId;
+        qint64 enqueuedAt;
+    };
+    using Iterator = std::list<Entry>::iterator;
+
+    void recordMatch(const Entry &entry, qint64 nowMs);
+
+    std::list<Entry> m_entries;
+    QHash<QString, Iterator> m_index;
+    MatchmakingStats m_stats;
+};
+
+#endif // MATCHMAKINGQUEUE_H
@@ -0,0 +1,94 @@
+#ifndef MPMCQUEUE_H
+#define MPMCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// Ограниченная lock-free очередь для нескольких производителей и потребителей
+// (схема Д. Вьюкова). Каждая ячейка хранит свой номер последовательности,
+// поэтому push/pop обходятся одной CAS-операцией над головой или хвостом.
+// Емкость округляется вверх до степени двойки.
+template <typename T>
+class MpmcQueue {
+public:
+    explicit MpmcQueue(size_t capacity)
+        : m_mask(roundUp(capacity) - 1),
+          m_cells(new Cell[m_mask + 1])
+    {
+        for (size_t i = 0; i <= m_mask; ++i) {
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcQueue(const MpmcQueue &) = delete;
+    MpmcQueue &operator=(const MpmcQueue &) = delete;
+
+    // false, если очередь заполнена
+    bool push(T value) {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            const size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = intptr_t(seq) - intptr_t(pos);
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // false, если очередь пуста
+    bool pop(T &value) {
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;) {
+            cell = &m_cells[pos & m_mask];
+            const size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = intptr_t(seq) - intptr_t(pos + 1);
+            if (diff == 0) {
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = m_head.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->value);
+        cell->value = T();
+        cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static size_t roundUp(size_t n) {
+        size_t p = 2;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    // Голова и хвост в разных кэш-линиях, чтобы производители и потребители
+    // не мешали друг другу
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) std::atomic<size_t> m_tail{0};
+    alignas(64) const size_t m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+};
+
+#endif // MPMCQUEUE_H
@@ -0,0 +1,66 @@
+#ifndef PEERADDRESS_H
+#define PEERADDRESS_H
+
+#include <QHostAddress>
+#include <QString>
+#include <cstring>
+
+// Адрес UDP-клиента в сыром виде: 16 байт IPv6 (IPv4 хранится как
+// ::ffff:a.b.c.d, как его отдает двухстековый сокет) и порт. Сравнение
+// и хеширование работают с байтами напрямую, без строк и выделений памяти.
+struct PeerAddress {
+    quint8 ip[16] = {};
+    quint16 port = 0;
+
+    static PeerAddress fromHostAddress(const QHostAddress &address, quint16 port) {
+        PeerAddress peer;
+        const Q_IPV6ADDR ip6 = address.toIPv6Address();
+        std::memcpy(peer.ip, &ip6, sizeof(peer.ip));
+        peer.port = port;
+        return peer;
+    }
+
+    bool isV4Mapped() const {
+        static const quint8 prefix[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+        return std::memcmp(ip, prefix, sizeof(prefix)) == 0;
+    }
+
+    // ::1 или 127.0.0.0/8
+    bool isLoopback() const {
+        static const quint8 v6Loopback[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+        return (isV4Mapped() && ip[12] == 127) || std::memcmp(ip, v6Loopback, sizeof(ip)) == 0;
+    }
+
+    QHostAddress hostAddress() const {
+        if (isV4Mapped()) {
+            return QHostAddress(quint32(ip[12]) << 24 | quint32(ip[13]) << 16 | quint32(ip[14]) << 8 | ip[15]);
+        }
+        return QHostAddress(ip);
+    }
+
+    QString toString() const {
+        return hostAddress().toString() + ":" + QString::number(port);
+    }
+
+    bool operator==(const PeerAddress &other) const {
+        return port == other.port && std::memcmp(ip, other.ip, sizeof(ip)) == 0;
+    }
+    bool operator!=(const PeerAddress &other) const { return !(*this == other); }
+};
+
+inline uint qHash(const PeerAddress &peer, uint seed = 0) {
+    quint64 a, b;
+    std::memcpy(&a, peer.ip, 8);
+    std::memcpy(&b, peer.ip + 8, 8);
+    // Перемешивание в духе splitmix64: у соседних адресов и портов
+    // различаются младшие биты, а QHash берет бакет по модулю
+    quint64 h = a * 0x9E3779B97F4A7C15ull ^ (b + peer.port + seed);
+    h ^= h >> 31;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBull;
+    h ^= h >> 31;
+    return uint(h ^ (h >> 32));
+}
+
+#endif // PEERADDRESS_H
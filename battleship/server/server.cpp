@@ -1,7 +1,11 @@
 #include "gameserver.h"
+#include "servercluster.h"
+#include "logger.h"
 #include <QCoreApplication>
 #include <QCommandLineParser>
-#include <QDebug>
+#include <QDir>
+#include <QThread>
+#include <cstdio>
 
 int main(int argc, char *argv[]) {
     QCoreApplication app(argc, argv);
@@ -10,14 +14,84 @@ int main(int argc, char *argv[]) {
     parser.addHelpOption();
     QCommandLineOption portOption(QStringList() << "p" << "port", "Port to listen on", "port", "12345");
     parser.addOption(portOption);
+    QCommandLineOption threadsOption(QStringList() << "t" << "threads",
+        "Number of worker threads, each with its own socket (0 = one per core)", "threads", "1");
+    parser.addOption(threadsOption);
+    QCommandLineOption ioOption("io",
+        "Datagram I/O backend: batched (recvmmsg/sendmmsg, Linux only) or qt", "backend", "batched");
+    parser.addOption(ioOption);
+    QCommandLineOption logLevelOption("log-level",
+        "Log verbosity: trace, debug, info, warning, error or off", "level", "info");
+    parser.addOption(logLevelOption);
+    QCommandLineOption journalOption("journal",
+        "Directory for the crash recovery journal (Linux only); games are restored from it on start", "dir");
+    parser.addOption(journalOption);
+    QCommandLineOption snapshotOption("snapshot-interval",
+        "Seconds between state snapshots written next to the journal (0 = only on start)", "seconds", "60");
+    parser.addOption(snapshotOption);
+    QCommandLineOption replaysOption("replays",
+        "Directory for compact records of finished games (see tools/replaytool)", "dir");
+    parser.addOption(replaysOption);
     parser.process(app);
 
+    LogLevel logLevel;
+    if (!Logger::parseLevel(parser.value(logLevelOption), &logLevel)) {
+        fprintf(stderr, "Unknown log level: %s\n", qPrintable(parser.value(logLevelOption)));
+        return 1;
+    }
+    Logger::setLevel(logLevel);
+    Logger::start();
+
     quint16 port = parser.value(portOption).toUShort();
+    int threads = parser.value(threadsOption).toInt();
+    if (threads <= 0) {
+        threads = QThread::idealThreadCount();
+    }
+    const bool batchedIo = parser.value(ioOption) != "qt";
+    const QString journalDir = parser.value(journalOption);
+    const int snapshotInterval = parser.value(snapshotOption).toInt();
+    const QString replayDir = parser.value(replaysOption);
+    if (!replayDir.isEmpty() && !QDir().mkpath(replayDir)) {
+        LOG_ERROR << "Cannot create replay directory" << replayDir;
+        Logger::stop();
+        return 1;
+    }
+    if (!journalDir.isEmpty() && !QDir().mkpath(journalDir)) {
+        LOG_ERROR << "Cannot create journal directory" << journalDir;
+        Logger::stop();
+        return 1;
+    }
+
+    if (threads > 1) {
+        ServerCluster cluster(threads);
+        cluster.setBatchedIo(batchedIo);
+        cluster.setJournalDir(journalDir);
+        cluster.setSnapshotInterval(snapshotInterval);
+        cluster.setReplayDir(replayDir);
+        if (!cluster.start(port)) {
+            LOG_ERROR << "Не удалось запустить сервер";
+            Logger::stop();
+            return 1;
+        }
+        const int code = app.exec();
+        Logger::stop();
+        return code;
+    }
+
     GameServer server;
+    server.setBatchedIo(batchedIo);
+    server.setReplayDir(replayDir);
+    if (!journalDir.isEmpty()) {
+        server.setStatePath(journalDir + "/shard-0");
+        server.setSnapshotInterval(snapshotInterval);
+    }
     if (!server.start(port)) {
-        qDebug() << "Не удалось запустить сервер";
+        LOG_ERROR << "Не удалось запустить сервер";
+        Logger::stop();
         return 1;
     }
 
-    return app.exec();
-} 
\ No newline at end of file
+    const int code = app.exec();
+    Logger::stop();
+    return code;
+}
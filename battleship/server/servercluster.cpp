@@ -0,0 +1,67 @@
+#include "servercluster.h"
+#include "logger.h"
+#include <QMetaObject>
+
+ServerCluster::ServerCluster(int threadCount, QObject *parent) : QObject(parent),
+    m_threadCount(threadCount),
+    m_batchedIo(true),
+    m_snapshotInterval(60),
+    m_hub(threadCount)
+{
+}
+
+ServerCluster::~ServerCluster() {
+    stop();
+}
+
+bool ServerCluster::start(quint16 port) {
+    for (int i = 0; i < m_threadCount; ++i) {
+        QThread *thread = new QThread(this);
+        thread->setObjectName(QString("shard-%1").arg(i));
+
+        GameServer *server = new GameServer;
+        server->attachToHub(&m_hub, i);
+        server->setBatchedIo(m_batchedIo);
+        if (!m_journalDir.isEmpty()) {
+            server->setStatePath(QString("%1/shard-%2").arg(m_journalDir).arg(i));
+            server->setSnapshotInterval(m_snapshotInterval);
+        }
+        server->setReplayDir(m_replayDir);
+        server->moveToThread(thread);
+        connect(thread, &QThread::finished, server, &QObject::deleteLater);
+
+        m_threads.append(thread);
+        m_servers.append(server);
+        thread->start();
+
+        // Сокет и таймеры должны создаваться в потоке шарда
+        bool started = false;
+        const QByteArray threadName = thread->objectName().toLatin1();
+        QMetaObject::invokeMethod(server, [server, port, threadName, &started]() {
+            Logger::setThreadName(threadName.constData());
+            started = server->start(port);
+        }, Qt::BlockingQueuedConnection);
+
+        if (!started) {
+            LOG_ERROR << "Failed to start shard" << i;
+            stop();
+            return false;
+        }
+    }
+    LOG_INFO << "Server cluster started with" << m_threadCount << "shards on port" << port;
+    return true;
+}
+
+void ServerCluster::stop() {
+    for (GameServer *server : m_servers) {
+        QMetaObject::invokeMethod(server, [server]() {
+            server->stop();
+        }, Qt::BlockingQueuedConnection);
+    }
+    for (QThread *thread : m_threads) {
+        thread->quit();
+        thread->wait();
+    }
+    m_servers.clear();
+    m_threads.clear();
+}
@@ -0,0 +1,40 @@
+#ifndef SERVERCLUSTER_H
+#define SERVERCLUSTER_H
+
+#include <QObject>
+#include <QThread>
+#include <QVector>
+#include "matchmakinghub.h"
+
+// Многопоточный режим: по одному GameServer на поток, каждый со своим
+// UDP-сокетом на общем порту (SO_REUSEPORT). Ядро распределяет клиентов
+// между сокетами по адресу, так что каждый шард владеет своей частью
+// клиентов и лобби, а межшардовый подбор идет через MatchmakingHub.
+class ServerCluster : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ServerCluster(int threadCount, QObject *parent = nullptr);
+    ~ServerCluster();
+
+    bool start(quint16 port);
+    void stop();
+    int threadCount() const { return m_threadCount; }
+    void setBatchedIo(bool enabled) { m_batchedIo = enabled; }
+    // Каталог состояния: у каждого шарда свои снимок и журнал shard-<N>.*
+    void setJournalDir(const QString &dir) { m_journalDir = dir; }
+    void setSnapshotInterval(int seconds) { m_snapshotInterval = seconds; }
+    void setReplayDir(const QString &dir) { m_replayDir = dir; }
+
+private:
+    int m_threadCount;
+    bool m_batchedIo;
+    QString m_journalDir;
+    int m_snapshotInterval;
+    QString m_replayDir;
+    MatchmakingHub m_hub;
+    QVector<QThread *> m_threads;
+    QVector<GameServer *> m_servers;
+};
+
+#endif // SERVERCLUSTER_H
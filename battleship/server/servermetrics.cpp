@@ -0,0 +1,131 @@
+#include "servermetrics.h"
+#include <QJsonArray>
+#include <QStringList>
+#include <cmath>
+
+int LatencyHistogram::bucketOf(quint64 value) {
+    if (value < LINEAR_BUCKETS) return int(value);
+    // Старший бит задает степень двойки, следующие четыре - бакет внутри нее
+    const int msb = 63 - __builtin_clzll(value);
+    const int shift = msb - SUB_BUCKET_BITS;
+    const int sub = int(value >> shift) - SUB_BUCKETS;
+    return LINEAR_BUCKETS + (shift - 1) * SUB_BUCKETS + sub;
+}
+
+quint64 LatencyHistogram::upperBound(int bucket) {
+    if (bucket < LINEAR_BUCKETS) return quint64(bucket);
+    const int shift = (bucket - LINEAR_BUCKETS) / SUB_BUCKETS + 1;
+    const quint64 top = quint64((bucket - LINEAR_BUCKETS) % SUB_BUCKETS + SUB_BUCKETS);
+    return ((top + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(quint64 micros) {
+    ++m_buckets[bucketOf(micros)];
+    ++m_count;
+    m_sum += micros;
+    if (micros < m_min) m_min = micros;
+    if (micros > m_max) m_max = micros;
+}
+
+quint64 LatencyHistogram::valueAtPercentile(double percentile) const {
+    if (m_count == 0) return 0;
+    quint64 target = quint64(std::ceil(percentile / 100.0 * double(m_count)));
+    if (target == 0) target = 1;
+    quint64 seen = 0;
+    for (int i = 0; i < BUCKET_COUNT; ++i) {
+        seen += m_buckets[i];
+        if (seen >= target) return qMin(upperBound(i), m_max);
+    }
+    return m_max;
+}
+
+QJsonObject LatencyHistogram::toJson() const {
+    QJsonObject json;
+    json["count"] = double(m_count);
+    json["min_us"] = double(min());
+    json["mean_us"] = std::round(mean() * 10.0) / 10.0;
+    json["p50_us"] = double(valueAtPercentile(50.0));
+    json["p90_us"] = double(valueAtPercentile(90.0));
+    json["p99_us"] = double(valueAtPercentile(99.0));
+    json["p999_us"] = double(valueAtPercentile(99.9));
+    json["max_us"] = double(m_max);
+    return json;
+}
+
+void ServerMetrics::countMessage(Protocol::MessageType type) {
+    const int index = int(type);
+    if (index < MESSAGE_TYPE_COUNT) ++m_messages[index];
+}
+
+QJsonObject ServerMetrics::toJson() const {
+    QJsonObject datagrams;
+    datagrams["received"] = double(m_datagramsReceived);
+    datagrams["sent"] = double(m_datagramsSent);
+    datagrams["bytes_received"] = double(m_bytesReceived);
+    datagrams["bytes_sent"] = double(m_bytesSent);
+    datagrams["malformed"] = double(m_malformed);
+
+    QJsonObject messages;
+    for (int i = 0; i < MESSAGE_TYPE_COUNT; ++i) {
+        if (m_messages[i] == 0) continue;
+        messages[Protocol::typeName(Protocol::MessageType(i))] = double(m_messages[i]);
+    }
+
+    QJsonObject errors;
+    for (auto it = m_errors.cbegin(); it != m_errors.cend(); ++it) {
+        errors[it.key()] = double(it.value());
+    }
+
+    QJsonObject reliability;
+    reliability["retransmits"] = double(m_retransmits);
+    reliability["duplicates"] = double(m_duplicates);
+    reliability["abandoned"] = double(m_abandoned);
+
+    QJsonObject keepalive;
+    keepalive["sent"] = double(m_keepalivesSent);
+    keepalive["skipped"] = double(m_keepalivesSkipped);
+
+    QJsonObject spectators;
+    spectators["encodes"] = double(m_spectatorEncodes);
+    spectators["sent"] = double(m_spectatorSent);
+    spectators["skipped"] = double(m_spectatorSkipped);
+    spectators["resyncs"] = double(m_spectatorResyncs);
+
+    QJsonObject json;
+    json["datagrams"] = datagrams;
+    json["messages"] = messages;
+    json["errors"] = errors;
+    json["reliability"] = reliability;
+    json["keepalive"] = keepalive;
+    json["spectators"] = spectators;
+    json["reply_latency"] = m_replyLatency.toJson();
+    return json;
+}
+
+namespace {
+
+void appendText(QStringList &lines, const QString &prefix, const QJsonObject &object) {
+    for (const QString &name : object.keys()) {
+        const QString key = prefix.isEmpty() ? name : prefix + "." + name;
+        const QJsonValue value = object.value(name);
+        if (value.isObject()) {
+            appendText(lines, key, value.toObject());
+        } else if (value.isDouble()) {
+            const double number = value.toDouble();
+            lines.append(key + " " + (number == std::floor(number)
+                ? QString::number(qint64(number)) : QString::number(number)));
+        } else if (value.isBool()) {
+            lines.append(key + " " + (value.toBool() ? "1" : "0"));
+        } else {
+            lines.append(key + " " + value.toString());
+        }
+    }
+}
+
+} // namespace
+
+QString ServerMetrics::toText(const QJsonObject &stats) {
+    QStringList lines;
+    appendText(lines, QString(), stats);
+    return lines.join("\n") + "\n";
+}
@@ -0,0 +1,96 @@
+#ifndef SERVERMETRICS_H
+#define SERVERMETRICS_H
+
+#include <QJsonObject>
+#include <QMap>
+#include <QString>
+#include "protocol.h"
+
+// Гистограмма задержек в духе HdrHistogram: до 32 мкс каждое значение
+// получает свой бакет, дальше каждая степень двойки делится на 16 равных
+// бакетов. Относительная погрешность не больше 1/16 на всем диапазоне до
+// ~70 минут, запись - несколько битовых операций без выделений памяти.
+class LatencyHistogram
+{
+public:
+    void record(quint64 micros);
+
+    quint64 count() const { return m_count; }
+    quint64 min() const { return m_count ? m_min : 0; }
+    quint64 max() const { return m_max; }
+    double mean() const { return m_count ? double(m_sum) / double(m_count) : 0.0; }
+    // Верхняя граница бакета, в который попадает заданный перцентиль
+    quint64 valueAtPercentile(double percentile) const;
+
+    QJsonObject toJson() const;
+
+private:
+    static constexpr int LINEAR_BUCKETS = 32;
+    static constexpr int SUB_BUCKET_BITS = 4;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int BUCKET_COUNT = LINEAR_BUCKETS + (64 - 5) * SUB_BUCKETS;
+
+    static int bucketOf(quint64 value);
+    static quint64 upperBound(int bucket);
+
+    quint64 m_buckets[BUCKET_COUNT] = {};
+    quint64 m_count = 0;
+    quint64 m_sum = 0;
+    quint64 m_min = ~quint64(0);
+    quint64 m_max = 0;
+};
+
+// Счетчики одного сервера (шарда). Обновляются только из его потока,
+// поэтому обычные целые без атомиков.
+class ServerMetrics
+{
+public:
+    static constexpr int MESSAGE_TYPE_COUNT = 32;
+
+    void countReceived(int bytes) { ++m_datagramsReceived; m_bytesReceived += quint64(bytes); }
+    void countSent(int bytes) { ++m_datagramsSent; m_bytesSent += quint64(bytes); }
+    void countMalformed() { ++m_malformed; }
+    void countMessage(Protocol::MessageType type);
+    void countError(const QString &reason) { ++m_errors[reason]; }
+    void recordLatency(quint64 micros) { m_replyLatency.record(micros); }
+    void countRetransmits(int count) { m_retransmits += quint64(count); }
+    void countDuplicate() { ++m_duplicates; }
+    void countAbandoned(int count) { m_abandoned += quint64(count); }
+    void countKeepalive(bool sent) { ++(sent ? m_keepalivesSent : m_keepalivesSkipped); }
+    void countSpectatorEncode() { ++m_spectatorEncodes; }
+    void countSpectatorSend(bool sent) { ++(sent ? m_spectatorSent : m_spectatorSkipped); }
+    void countSpectatorResync() { ++m_spectatorResyncs; }
+
+    quint64 datagramsSent() const { return m_datagramsSent; }
+
+    QJsonObject toJson() const;
+
+    // Плоский текст "ключ значение" по строке на метрику, ключи вложенных
+    // объектов склеиваются через точку
+    static QString toText(const QJsonObject &stats);
+
+private:
+    quint64 m_datagramsReceived = 0;
+    quint64 m_datagramsSent = 0;
+    quint64 m_bytesReceived = 0;
+    quint64 m_bytesSent = 0;
+    quint64 m_malformed = 0;
+    quint64 m_messages[MESSAGE_TYPE_COUNT] = {};
+    QMap<QString, quint64> m_errors;
+    // Надежная доставка
+    quint64 m_retransmits = 0;
+    quint64 m_duplicates = 0;
+    quint64 m_abandoned = 0;
+    // Пинги: отправленные и ненужные из-за свежего входящего трафика
+    quint64 m_keepalivesSent = 0;
+    quint64 m_keepalivesSkipped = 0;
+    // Зрители: кодирования событий, отправки, пропуски из-за отставания
+    // и повторные снимки после них
+    quint64 m_spectatorEncodes = 0;
+    quint64 m_spectatorSent = 0;
+    quint64 m_spectatorSkipped = 0;
+    quint64 m_spectatorResyncs = 0;
+    LatencyHistogram m_replyLatency;   // прием датаграммы -> отправка ответа
+};
+
+#endif // SERVERMETRICS_H
@@ -0,0 +1,185 @@
+#ifndef TIMINGWHEEL_H
+#define TIMINGWHEEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Иерархическое колесо таймеров. Четыре уровня по 64 слота: нижний уровень
+// покрывает ближайшие 64 тика, каждый следующий - в 64 раза больший
+// интервал. Таймер лежит в двусвязном списке своего слота, поэтому
+// постановка, перевзвод и отмена стоят O(1), а продвижение колеса обходит
+// только истекшие таймеры и изредка переносит слот верхнего уровня вниз.
+//
+// Идентификатор таймера действителен до его срабатывания или отмены;
+// сработавший таймер освобождается, владелец должен забыть его id.
+template <typename T>
+class TimingWheel {
+public:
+    using TimerId = uint32_t;
+    static constexpr TimerId INVALID_TIMER = 0;
+
+    TimingWheel(int64_t tickMs, int64_t nowMs)
+        : m_tickMs(tickMs),
+          m_currentTick(nowMs / tickMs)
+    {
+        for (auto &level : m_slots) {
+            for (auto &head : level) head = NIL;
+        }
+    }
+
+    TimerId schedule(int64_t deadlineMs, T payload) {
+        uint32_t index;
+        if (m_free != NIL) {
+            index = m_free;
+            m_free = m_nodes[index].next;
+        } else {
+            index = uint32_t(m_nodes.size());
+            m_nodes.emplace_back();
+        }
+        Node &node = m_nodes[index];
+        node.payload = std::move(payload);
+        node.active = true;
+        insert(index, toTick(deadlineMs));
+        ++m_size;
+        return index + 1;
+    }
+
+    // Перевзвод на новый срок; false, если таймер уже сработал или отменен
+    bool reschedule(TimerId id, int64_t deadlineMs) {
+        if (!isActive(id)) return false;
+        unlink(id - 1);
+        insert(id - 1, toTick(deadlineMs));
+        return true;
+    }
+
+    bool cancel(TimerId id) {
+        if (!isActive(id)) return false;
+        unlink(id - 1);
+        release(id - 1);
+        return true;
+    }
+
+    bool isActive(TimerId id) const {
+        return id != INVALID_TIMER && id <= m_nodes.size() && m_nodes[id - 1].active;
+    }
+
+    size_t size() const { return m_size; }
+
+    // Продвигает колесо до nowMs и вызывает onExpired(payload) для каждого
+    // истекшего таймера. Обработчик может ставить, перевзводить и отменять
+    // таймеры, в том числе в обрабатываемом слоте.
+    template <typename F>
+    void advance(int64_t nowMs, F &&onExpired) {
+        const int64_t target = nowMs / m_tickMs;
+        while (m_currentTick < target) {
+            ++m_currentTick;
+            cascade();
+            uint32_t &head = m_slots[0][m_currentTick & SLOT_MASK];
+            while (head != NIL) {
+                const uint32_t index = head;
+                unlink(index);
+                T payload = std::move(m_nodes[index].payload);
+                release(index);
+                onExpired(payload);
+            }
+        }
+    }
+
+private:
+    static constexpr int LEVELS = 4;
+    static constexpr int SLOT_BITS = 6;
+    static constexpr int SLOTS = 1 << SLOT_BITS;
+    static constexpr int64_t SLOT_MASK = SLOTS - 1;
+    static constexpr uint32_t NIL = UINT32_MAX;
+
+    struct Node {
+        T payload{};
+        int64_t expires = 0;
+        uint32_t prev = NIL;
+        uint32_t next = NIL;
+        uint8_t level = 0;
+        uint8_t slot = 0;
+        bool active = false;
+    };
+
+    int64_t toTick(int64_t deadlineMs) const {
+        // Округление вверх: таймер не срабатывает раньше срока
+        const int64_t tick = (deadlineMs + m_tickMs - 1) / m_tickMs;
+        return tick > m_currentTick ? tick : m_currentTick + 1;
+    }
+
+    void insert(uint32_t index, int64_t expires) {
+        Node &node = m_nodes[index];
+        node.expires = expires;
+        const int64_t delta = expires - m_currentTick;
+        int level = 0;
+        while (level < LEVELS - 1 && delta >= (int64_t(1) << (SLOT_BITS * (level + 1)))) {
+            ++level;
+        }
+        // Сроки дальше охвата колеса ждут полный оборот верхнего уровня
+        // и раскладываются заново
+        int64_t slotTick = expires;
+        if (delta >= (int64_t(1) << (SLOT_BITS * LEVELS))) {
+            slotTick = m_currentTick;
+        }
+        node.level = uint8_t(level);
+        node.slot = uint8_t((slotTick >> (SLOT_BITS * level)) & SLOT_MASK);
+
+        uint32_t &head = m_slots[level][node.slot];
+        node.prev = NIL;
+        node.next = head;
+        if (head != NIL) m_nodes[head].prev = index;
+        head = index;
+    }
+
+    void unlink(uint32_t index) {
+        Node &node = m_nodes[index];
+        if (node.prev != NIL) {
+            m_nodes[node.prev].next = node.next;
+        } else {
+            m_slots[node.level][node.slot] = node.next;
+        }
+        if (node.next != NIL) m_nodes[node.next].prev = node.prev;
+        node.prev = node.next = NIL;
+    }
+
+    void release(uint32_t index) {
+        Node &node = m_nodes[index];
+        node.active = false;
+        node.payload = T();
+        node.next = m_free;
+        m_free = index;
+        --m_size;
+    }
+
+    // На границе интервала уровня L слот этого уровня раскладывается по
+    // нижним уровням. Верхние уровни переносятся первыми, чтобы их таймеры
+    // успели попасть в только что открытые нижние слоты.
+    void cascade() {
+        int top = 0;
+        while (top < LEVELS - 1 && (m_currentTick & ((int64_t(1) << (SLOT_BITS * (top + 1))) - 1)) == 0) {
+            ++top;
+        }
+        for (int level = top; level >= 1; --level) {
+            uint32_t &head = m_slots[level][(m_currentTick >> (SLOT_BITS * level)) & SLOT_MASK];
+            uint32_t index = head;
+            head = NIL;
+            while (index != NIL) {
+                const uint32_t next = m_nodes[index].next;
+                insert(index, m_nodes[index].expires);
+                index = next;
+            }
+        }
+    }
+
+    int64_t m_tickMs;
+    int64_t m_currentTick;
+    std::vector<Node> m_nodes;
+    uint32_t m_free = NIL;
+    size_t m_size = 0;
+    uint32_t m_slots[LEVELS][SLOTS];
+};
+
+#endif // TIMINGWHEEL_H
@@ -0,0 +1,27 @@
+QT += core network
+QT -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# Настройки для временных файлов
+MOC_DIR = build/moc
+OBJECTS_DIR = build/obj
+
+TEMPLATE = app
+
+INCLUDEPATH += ../../server ../../common
+include(../../common/gamecore.pri)
+
+SOURCES += \
+    main.cpp \
+    loadgenerator.cpp \
+    ../../server/servermetrics.cpp \
+    ../../common/protocol.cpp
+
+HEADERS += \
+    loadgenerator.h \
+    ../../server/servermetrics.h \
+    ../../common/protocol.h
+
+TARGET = loadgen
@@ -0,0 +1,338 @@
+#include "loadgenerator.h"
+#include <QNetworkDatagram>
+#include <cstdio>
+
+namespace {
+
+constexpr qint64 NS_PER_MS = 1000000;
+
+} // namespace
+
+LoadGenerator::LoadGenerator(const LoadConfig &config, QObject *parent) : QObject(parent),
+    m_config(config),
+    m_rng(config.seed)
+{
+    m_bots.reserve(size_t(config.bots));
+    m_tickTimer.setInterval(TICK_MS);
+    m_reportTimer.setInterval(REPORT_INTERVAL_MS);
+    connect(&m_tickTimer, &QTimer::timeout, this, &LoadGenerator::onTick);
+    connect(&m_reportTimer, &QTimer::timeout, this, &LoadGenerator::onReport);
+}
+
+LoadGenerator::~LoadGenerator() {
+    for (Bot &bot : m_bots) {
+        delete bot.socket;
+    }
+}
+
+void LoadGenerator::start() {
+    std::printf("%6s %6s %9s %8s %8s %8s %8s %8s\n",
+                "time_s", "bots", "moves/s", "p50_us", "p99_us", "p999_us", "timeouts", "errors");
+    std::fflush(stdout);
+    m_clock.start();
+    m_nextSpawnNs = 0;
+    m_tickTimer.start();
+    m_reportTimer.start();
+}
+
+void LoadGenerator::onTick() {
+    const qint64 now = m_clock.nsecsElapsed();
+
+    // Игроки приходят с заданной частотой, а не все сразу
+    const qint64 spawnIntervalNs = qint64(1e9 / m_config.arrivalRate);
+    while (int(m_bots.size()) < m_config.bots && now >= m_nextSpawnNs) {
+        spawnBot();
+        m_nextSpawnNs += spawnIntervalNs;
+    }
+
+    while (!m_events.empty() && m_events.top().dueNs <= now) {
+        const Event event = m_events.top();
+        m_events.pop();
+        Bot &bot = m_bots[size_t(event.bot)];
+        if (event.token != bot.token) continue;
+        if (bot.awaiting != Protocol::MessageType::Unknown) {
+            retransmit(event.bot);
+        } else {
+            act(event.bot);
+        }
+    }
+}
+
+void LoadGenerator::onReport() {
+    const qint64 elapsedS = m_clock.elapsed() / 1000;
+    quint64 errors = 0;
+    for (quint64 count : m_errors) {
+        errors += count;
+    }
+    std::printf("%6lld %6d %9.1f %8llu %8llu %8llu %8llu %8llu\n",
+                static_cast<long long>(elapsedS), int(m_bots.size()),
+                double(m_intervalMoves) * 1000.0 / REPORT_INTERVAL_MS,
+                static_cast<unsigned long long>(m_intervalLatency.valueAtPercentile(50.0)),
+                static_cast<unsigned long long>(m_intervalLatency.valueAtPercentile(99.0)),
+                static_cast<unsigned long long>(m_intervalLatency.valueAtPercentile(99.9)),
+                static_cast<unsigned long long>(m_timeouts),
+                static_cast<unsigned long long>(errors));
+    std::fflush(stdout);
+    m_intervalMoves = 0;
+    m_intervalLatency = LatencyHistogram();
+
+    if (elapsedS < m_config.durationS) return;
+
+    m_tickTimer.stop();
+    m_reportTimer.stop();
+    const double seconds = double(m_clock.nsecsElapsed()) / 1e9;
+    std::printf("\n");
+    std::printf("duration_s %.1f\n", seconds);
+    std::printf("bots %d\n", int(m_bots.size()));
+    std::printf("games %llu\n", static_cast<unsigned long long>(m_games));
+    std::printf("moves %llu\n", static_cast<unsigned long long>(m_moves));
+    std::printf("moves_per_s %.1f\n", double(m_moves) / seconds);
+    std::printf("datagrams_sent %llu\n", static_cast<unsigned long long>(m_sent));
+    std::printf("datagrams_received %llu\n", static_cast<unsigned long long>(m_received));
+    std::printf("datagrams_dropped %llu\n", static_cast<unsigned long long>(m_dropped));
+    std::printf("malformed %llu\n", static_cast<unsigned long long>(m_malformed));
+    std::printf("timeouts %llu\n", static_cast<unsigned long long>(m_timeouts));
+    std::printf("latency_count %llu\n", static_cast<unsigned long long>(m_latency.count()));
+    std::printf("latency_mean_us %.1f\n", m_latency.mean());
+    std::printf("latency_p50_us %llu\n", static_cast<unsigned long long>(m_latency.valueAtPercentile(50.0)));
+    std::printf("latency_p99_us %llu\n", static_cast<unsigned long long>(m_latency.valueAtPercentile(99.0)));
+    std::printf("latency_p999_us %llu\n", static_cast<unsigned long long>(m_latency.valueAtPercentile(99.9)));
+    std::printf("latency_max_us %llu\n", static_cast<unsigned long long>(m_latency.max()));
+    for (auto it = m_errors.cbegin(); it != m_errors.cend(); ++it) {
+        std::printf("error %llu %s\n", static_cast<unsigned long long>(it.value()), qPrintable(it.key()));
+    }
+    std::fflush(stdout);
+    emit finished();
+}
+
+void LoadGenerator::spawnBot() {
+    const int index = int(m_bots.size());
+    m_bots.emplace_back();
+    Bot &bot = m_bots.back();
+    bot.socket = new QUdpSocket;
+    const bool v4 = m_config.host.protocol() == QAbstractSocket::IPv4Protocol;
+    if (!bot.socket->bind(v4 ? QHostAddress(QHostAddress::AnyIPv4) : QHostAddress(QHostAddress::AnyIPv6), 0)) {
+        std::fprintf(stderr, "bot %d: bind failed: %s\n", index, qPrintable(bot.socket->errorString()));
+    }
+    connect(bot.socket, &QUdpSocket::readyRead, this, [this, index]() { onDatagram(index); });
+    schedule(index, 0);
+}
+
+void LoadGenerator::onDatagram(int index) {
+    QUdpSocket *socket = m_bots[size_t(index)].socket;
+    while (socket->hasPendingDatagrams()) {
+        const QNetworkDatagram datagram = socket->receiveDatagram();
+        // Потеря по дороге от сервера
+        if (chance(m_config.lossPercent / 100.0)) {
+            ++m_dropped;
+            continue;
+        }
+        ++m_received;
+        Protocol::Message msg;
+        if (!Protocol::decode(datagram.data(), msg)) {
+            ++m_malformed;
+            continue;
+        }
+        handleMessage(index, msg);
+    }
+}
+
+void LoadGenerator::handleMessage(int index, const Protocol::Message &msg) {
+    using Protocol::MessageType;
+    Bot &bot = m_bots[size_t(index)];
+
+    switch (msg.type) {
+    case MessageType::LoginResponse:
+        if (bot.awaiting != MessageType::LoginResponse) break;
+        completeRequest(index);
+        if (!msg.success) {
+            ++m_errors["login rejected"];
+            schedule(index, thinkDelayNs());
+            break;
+        }
+        bot.phase = Phase::Lobby;
+        schedule(index, thinkDelayNs());
+        break;
+    case MessageType::LobbyCreated:
+        if (bot.awaiting != MessageType::LobbyCreated) break;
+        completeRequest(index);
+        bot.phase = Phase::Waiting;
+        schedule(index, qint64(m_config.pingMs) * NS_PER_MS);
+        break;
+    case MessageType::GameStart:
+        // Ответ на ready, если соперник уже ждал, иначе - извещение ожидающему
+        if (bot.awaiting == MessageType::LobbyCreated) {
+            completeRequest(index);
+        } else {
+            bot.awaiting = MessageType::Unknown;
+        }
+        bot.phase = Phase::Playing;
+        bot.fired = CellMask();
+        bot.myTurn = msg.yourTurn;
+        cancelActions(index);
+        if (bot.myTurn) schedule(index, thinkDelayNs());
+        break;
+    case MessageType::ShotResult:
+        if (bot.awaiting != MessageType::ShotResult) break;
+        completeRequest(index);
+        ++m_moves;
+        ++m_intervalMoves;
+        // После попадания ход остается за стреляющим, после промаха
+        // придет turn_change
+        bot.myTurn = msg.hit;
+        if (bot.myTurn) schedule(index, thinkDelayNs());
+        break;
+    case MessageType::TurnChange:
+        if (bot.phase != Phase::Playing) break;
+        bot.myTurn = msg.yourTurn;
+        if (bot.myTurn && bot.awaiting == MessageType::Unknown) schedule(index, thinkDelayNs());
+        break;
+    case MessageType::GameOver:
+        if (msg.win) ++m_games;
+        bot.phase = Phase::Lobby;
+        bot.awaiting = MessageType::Unknown;
+        schedule(index, thinkDelayNs());
+        break;
+    case MessageType::LobbyTimeout:
+        bot.phase = Phase::Lobby;
+        bot.awaiting = MessageType::Unknown;
+        schedule(index, thinkDelayNs());
+        break;
+    case MessageType::Pong:
+        if (bot.awaiting != MessageType::Pong) break;
+        completeRequest(index);
+        if (bot.phase == Phase::Waiting) schedule(index, qint64(m_config.pingMs) * NS_PER_MS);
+        break;
+    case MessageType::Error:
+        ++m_errors[msg.text];
+        if (bot.awaiting != MessageType::Unknown) completeRequest(index);
+        if (bot.phase == Phase::Playing) {
+            // Чаще всего это повтор выстрела, потерянного по дороге назад
+            bot.myTurn = false;
+        } else {
+            schedule(index, thinkDelayNs());
+        }
+        break;
+    default:
+        // Пинги сервера, чужие выстрелы, потопления и чат на поведение не влияют
+        break;
+    }
+}
+
+void LoadGenerator::act(int index) {
+    using Protocol::MessageType;
+    Bot &bot = m_bots[size_t(index)];
+    Protocol::Message msg;
+
+    switch (bot.phase) {
+    case Phase::Offline:
+        msg.type = MessageType::Login;
+        msg.username = QString("bot-%1").arg(index);
+        msg.protocolVersion = Protocol::VERSION;
+        request(index, msg, MessageType::LoginResponse);
+        break;
+    case Phase::Lobby:
+        msg.type = MessageType::Board;
+        msg.board = BitBoard::randomFleet(m_rng);
+        send(index, msg);
+        msg = Protocol::Message();
+        msg.type = MessageType::Ready;
+        request(index, msg, MessageType::LobbyCreated);
+        break;
+    case Phase::Waiting:
+        msg.type = MessageType::Ping;
+        request(index, msg, MessageType::Pong);
+        break;
+    case Phase::Playing:
+        if (bot.myTurn) sendShot(index);
+        break;
+    }
+}
+
+void LoadGenerator::retransmit(int index) {
+    Bot &bot = m_bots[size_t(index)];
+    ++m_timeouts;
+    transmit(index, bot.request);
+    bot.sentNs = m_clock.nsecsElapsed();
+    schedule(index, qint64(m_config.replyTimeoutMs) * NS_PER_MS);
+}
+
+void LoadGenerator::sendShot(int index) {
+    Bot &bot = m_bots[size_t(index)];
+    const int free = BitBoard::CELL_COUNT - bot.fired.count();
+    if (free == 0) return;
+
+    if (chance(m_config.chatChance)) {
+        Protocol::Message chat;
+        chat.type = Protocol::MessageType::ChatMessage;
+        chat.sender = QString("bot-%1").arg(index);
+        chat.text = "gl hf";
+        send(index, chat);
+    }
+
+    // k-я еще не обстрелянная клетка
+    int k = int(m_rng() % unsigned(free));
+    int cell = 0;
+    for (;; ++cell) {
+        if (bot.fired.test(cell)) continue;
+        if (k-- == 0) break;
+    }
+    bot.fired.set(cell);
+
+    Protocol::Message shot;
+    shot.type = Protocol::MessageType::Shot;
+    shot.x = cell % BitBoard::WIDTH;
+    shot.y = cell / BitBoard::WIDTH;
+    request(index, shot, Protocol::MessageType::ShotResult);
+}
+
+void LoadGenerator::schedule(int index, qint64 delayNs) {
+    Bot &bot = m_bots[size_t(index)];
+    ++bot.token;
+    m_events.push({m_clock.nsecsElapsed() + delayNs, index, bot.token});
+}
+
+qint64 LoadGenerator::thinkDelayNs() {
+    // Равномерно от половины до полутора средних
+    const qint64 mean = qint64(m_config.thinkMs) * NS_PER_MS;
+    if (mean == 0) return 0;
+    return mean / 2 + qint64(m_rng() % quint64(mean));
+}
+
+bool LoadGenerator::chance(double probability) {
+    if (probability <= 0.0) return false;
+    return std::uniform_real_distribution<double>(0.0, 1.0)(m_rng) < probability;
+}
+
+void LoadGenerator::transmit(int index, const QByteArray &data) {
+    // Потеря по дороге к серверу
+    if (chance(m_config.lossPercent / 100.0)) {
+        ++m_dropped;
+        return;
+    }
+    m_bots[size_t(index)].socket->writeDatagram(data, m_config.host, m_config.port);
+    ++m_sent;
+}
+
+void LoadGenerator::send(int index, const Protocol::Message &msg) {
+    transmit(index, Protocol::encode(msg, Protocol::WireFormat::Binary));
+}
+
+void LoadGenerator::request(int index, const Protocol::Message &msg, Protocol::MessageType reply) {
+    Bot &bot = m_bots[size_t(index)];
+    bot.awaiting = reply;
+    bot.request = Protocol::encode(msg, Protocol::WireFormat::Binary);
+    bot.sentNs = m_clock.nsecsElapsed();
+    transmit(index, bot.request);
+    schedule(index, qint64(m_config.replyTimeoutMs) * NS_PER_MS);
+}
+
+void LoadGenerator::completeRequest(int index) {
+    Bot &bot = m_bots[size_t(index)];
+    const quint64 micros = quint64(m_clock.nsecsElapsed() - bot.sentNs) / 1000;
+    m_latency.record(micros);
+    m_intervalLatency.record(micros);
+    bot.awaiting = Protocol::MessageType::Unknown;
+    bot.request.clear();
+    cancelActions(index);
+}
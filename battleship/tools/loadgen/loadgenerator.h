@@ -0,0 +1,117 @@
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHostAddress>
+#include <QMap>
+#include <QTimer>
+#include <QUdpSocket>
+#include <queue>
+#include <random>
+#include <vector>
+#include "bitboard.h"
+#include "protocol.h"
+#include "servermetrics.h"
+
+struct LoadConfig {
+    QHostAddress host = QHostAddress::LocalHost;
+    quint16 port = 12345;
+    int bots = 1000;
+    double arrivalRate = 200.0;   // новых игроков в секунду
+    int thinkMs = 200;            // средняя пауза перед ходом
+    double lossPercent = 0.0;     // потеря датаграмм в обе стороны
+    double chatChance = 0.05;     // вероятность сообщения в чат на ход
+    int pingMs = 5000;            // пинг, пока игрок ждет соперника
+    int replyTimeoutMs = 2000;    // повтор запроса без ответа
+    int durationS = 60;
+    quint32 seed = 1;
+};
+
+// Флот ботов, играющих с сервером по его протоколу без GUI. Каждый бот -
+// отдельный UDP-сокет (сервер различает клиентов по адресу и порту) и
+// конечный автомат: вход, расстановка, ready, ожидание, ходы через паузу,
+// новая игра после окончания. Все боты живут в одном потоке событий;
+// отложенные действия лежат в общей очереди с приоритетом по времени.
+class LoadGenerator : public QObject
+{
+    Q_OBJECT
+public:
+    explicit LoadGenerator(const LoadConfig &config, QObject *parent = nullptr);
+    ~LoadGenerator();
+
+    void start();
+
+signals:
+    void finished();
+
+private slots:
+    void onTick();
+    void onReport();
+
+private:
+    enum class Phase { Offline, Lobby, Waiting, Playing };
+
+    struct Bot {
+        QUdpSocket *socket = nullptr;
+        Phase phase = Phase::Offline;
+        bool myTurn = false;
+        CellMask fired;
+        // Запрос, на который бот ждет ответа
+        Protocol::MessageType awaiting = Protocol::MessageType::Unknown;
+        QByteArray request;
+        qint64 sentNs = 0;
+        quint32 token = 0;   // отменяет запланированные ранее действия
+    };
+
+    struct Event {
+        qint64 dueNs;
+        int bot;
+        quint32 token;
+        bool operator>(const Event &other) const { return dueNs > other.dueNs; }
+    };
+
+    void spawnBot();
+    void onDatagram(int index);
+    void handleMessage(int index, const Protocol::Message &msg);
+    void act(int index);
+    void retransmit(int index);
+
+    void schedule(int index, qint64 delayNs);
+    void cancelActions(int index) { ++m_bots[index].token; }
+    qint64 thinkDelayNs();
+    bool chance(double probability);
+
+    void transmit(int index, const QByteArray &data);
+    void send(int index, const Protocol::Message &msg);
+    void request(int index, const Protocol::Message &msg, Protocol::MessageType reply);
+    void completeRequest(int index);
+    void sendShot(int index);
+
+    static constexpr int TICK_MS = 2;
+    static constexpr int REPORT_INTERVAL_MS = 1000;
+
+    LoadConfig m_config;
+    std::vector<Bot> m_bots;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> m_events;
+    std::mt19937 m_rng;
+    QElapsedTimer m_clock;
+    QTimer m_tickTimer;
+    QTimer m_reportTimer;
+    qint64 m_nextSpawnNs = 0;
+
+    // Итог за весь прогон и за последний интервал отчета
+    LatencyHistogram m_latency;
+    LatencyHistogram m_intervalLatency;
+    quint64 m_moves = 0;
+    quint64 m_intervalMoves = 0;
+    quint64 m_games = 0;
+    quint64 m_sent = 0;
+    quint64 m_received = 0;
+    quint64 m_dropped = 0;
+    quint64 m_timeouts = 0;
+    quint64 m_malformed = 0;
+    QMap<QString, quint64> m_errors;
+};
+
+#endif // LOADGENERATOR_H
@@ -0,0 +1,77 @@
+// Нагрузочный генератор для GameServer: флот ботов, играющих по сетевому
+// протоколу без GUI. Каждую секунду печатает строку с ходами в секунду,
+// перцентилями задержки ответа и числом ошибок, в конце - итог "ключ значение".
+//
+// Пример: loadgen --bots 5000 --rate 500 --think-ms 100 --loss 1 --duration 120
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <cstdio>
+#include "loadgenerator.h"
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+void raiseFileLimit() {
+#ifdef Q_OS_UNIX
+    // У каждого бота свой сокет, стандартных 1024 дескрипторов мало
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+#endif
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Load generator for the sea battle UDP server");
+    parser.addHelpOption();
+    QCommandLineOption hostOption("host", "Server address", "address", "127.0.0.1");
+    QCommandLineOption portOption(QStringList() << "p" << "port", "Server port", "port", "12345");
+    QCommandLineOption botsOption(QStringList() << "n" << "bots", "Number of simulated players", "count", "1000");
+    QCommandLineOption rateOption("rate", "New players per second", "per-second", "200");
+    QCommandLineOption thinkOption("think-ms", "Mean pause before each move", "ms", "200");
+    QCommandLineOption lossOption("loss", "Simulated datagram loss in both directions, percent", "percent", "0");
+    QCommandLineOption chatOption("chat", "Chance of a chat message per move", "probability", "0.05");
+    QCommandLineOption pingOption("ping-ms", "Ping interval while waiting for an opponent", "ms", "5000");
+    QCommandLineOption timeoutOption("reply-timeout-ms", "Resend a request after this long without a reply", "ms", "2000");
+    QCommandLineOption durationOption(QStringList() << "d" << "duration", "Test length", "seconds", "60");
+    QCommandLineOption seedOption("seed", "Random seed", "seed", "1");
+    for (const QCommandLineOption &option : {hostOption, portOption, botsOption, rateOption, thinkOption, lossOption,
+                                             chatOption, pingOption, timeoutOption, durationOption, seedOption}) {
+        parser.addOption(option);
+    }
+    parser.process(app);
+
+    LoadConfig config;
+    config.host = QHostAddress(parser.value(hostOption));
+    config.port = parser.value(portOption).toUShort();
+    config.bots = parser.value(botsOption).toInt();
+    config.arrivalRate = parser.value(rateOption).toDouble();
+    config.thinkMs = parser.value(thinkOption).toInt();
+    config.lossPercent = parser.value(lossOption).toDouble();
+    config.chatChance = parser.value(chatOption).toDouble();
+    config.pingMs = parser.value(pingOption).toInt();
+    config.replyTimeoutMs = parser.value(timeoutOption).toInt();
+    config.durationS = parser.value(durationOption).toInt();
+    config.seed = parser.value(seedOption).toUInt();
+
+    if (config.host.isNull() || config.bots <= 0 || config.arrivalRate <= 0.0) {
+        std::fprintf(stderr, "Invalid host, bot count or arrival rate\n");
+        return 1;
+    }
+
+    raiseFileLimit();
+
+    LoadGenerator generator(config);
+    QObject::connect(&generator, &LoadGenerator::finished, &app, &QCoreApplication::quit);
+    generator.start();
+    return app.exec();
+}
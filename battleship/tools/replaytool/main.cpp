@@ -0,0 +1,224 @@
+// Разбор записей партий сервера (--replays): потоковое чтение файлов,
+// повторное проигрывание каждой партии по правилам сервера и итог
+// "ключ значение". С --list печатает строку на каждую партию, с --invalid -
+// только на нарушившие правила. --generate пишет файл случайных партий,
+// например для замера скорости разбора.
+//
+// Пример: replaytool /var/lib/sea-battle/replays/*.replays
+//         replaytool --generate 1000000 sample.replays
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMap>
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <random>
+#include "gamereplay.h"
+
+namespace {
+
+struct Totals {
+    quint64 files = 0;
+    quint64 bytes = 0;
+    quint64 games = 0;
+    quint64 invalid = 0;
+    quint64 damagedFiles = 0;
+    quint64 outcomes[3] = {0, 0, 0};
+    quint64 moves = 0;
+    quint64 shots = 0;
+    quint64 hits = 0;
+    quint64 repeats = 0;
+    quint64 passes = 0;
+    quint64 finishedGames = 0;   // доигранные и прошедшие проверку
+    quint64 finishedMoves = 0;
+    qint64 finishedMs = 0;
+    QMap<QString, quint64> errors;
+};
+
+const char *outcomeName(GameReplay::Outcome outcome) {
+    switch (outcome) {
+    case GameReplay::Outcome::Player1Won: return "player1";
+    case GameReplay::Outcome::Player2Won: return "player2";
+    case GameReplay::Outcome::Abandoned: return "abandoned";
+    }
+    return "?";
+}
+
+bool scanFile(const QString &path, bool list, bool invalidOnly, Totals &totals) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::fprintf(stderr, "%s: %s\n", qPrintable(path), qPrintable(file.errorString()));
+        return false;
+    }
+    ReplayReader reader(&file);
+    if (!reader.readHeader()) {
+        std::fprintf(stderr, "%s: not a replay file\n", qPrintable(path));
+        return false;
+    }
+    ++totals.files;
+    totals.bytes += quint64(file.size());
+
+    GameReplay replay;
+    ReplayReader::Status status;
+    while ((status = reader.next(replay)) == ReplayReader::Status::Ok) {
+        const ReplayVerdict verdict = simulateReplay(replay);
+        ++totals.games;
+        ++totals.outcomes[int(replay.outcome)];
+        totals.moves += quint64(replay.moves.size());
+        for (int player = 0; player < 2; ++player) {
+            totals.shots += quint64(verdict.shots[player]);
+            totals.hits += quint64(verdict.hits[player]);
+            totals.repeats += quint64(verdict.repeats[player]);
+            totals.passes += quint64(verdict.passes[player]);
+        }
+        if (!verdict.valid) {
+            ++totals.invalid;
+            ++totals.errors[QString::fromLatin1(verdict.error)];
+        } else if (replay.outcome != GameReplay::Outcome::Abandoned) {
+            ++totals.finishedGames;
+            totals.finishedMoves += quint64(replay.moves.size());
+            totals.finishedMs += verdict.durationMs;
+        }
+
+        if (list && (!invalidOnly || !verdict.valid)) {
+            std::printf("%s:%lld %s %s moves %d duration_s %.1f %s\n",
+                        qPrintable(path), static_cast<long long>(reader.recordOffset()),
+                        qPrintable(QDateTime::fromMSecsSinceEpoch(replay.startedAt).toString(Qt::ISODate)),
+                        outcomeName(replay.outcome), int(replay.moves.size()), verdict.durationMs / 1000.0,
+                        verdict.valid ? "ok" : verdict.error);
+        }
+    }
+    if (status != ReplayReader::Status::End) {
+        // Дальше конца записи не прочитать: длины следующих записей неизвестны
+        ++totals.damagedFiles;
+        std::fprintf(stderr, "%s: %s record at offset %lld, rest of the file skipped\n", qPrintable(path),
+                     status == ReplayReader::Status::Truncated ? "truncated" : "corrupt",
+                     static_cast<long long>(reader.recordOffset()));
+    }
+    return true;
+}
+
+// Случайные партии по правилам сервера: каждый игрок стреляет по
+// необстрелянным клеткам в случайном порядке, изредка пропуская ход
+int generate(const QString &path, int games, quint32 seed) {
+    ReplayWriter writer;
+    if (!writer.open(path)) return 1;
+    std::mt19937 rng(seed);
+    qint64 startedAt = QDateTime::currentMSecsSinceEpoch();
+
+    for (int game = 0; game < games; ++game) {
+        BitBoard boards[2] = {BitBoard::randomFleet(rng), BitBoard::randomFleet(rng)};
+        GameReplay replay;
+        replay.startedAt = startedAt;
+        replay.player1Ships = boards[0].ships();
+        replay.player2Ships = boards[1].ships();
+        startedAt += 1000;
+
+        int order[2][BitBoard::CELL_COUNT];
+        int next[2] = {0, 0};
+        for (int player = 0; player < 2; ++player) {
+            for (int i = 0; i < BitBoard::CELL_COUNT; ++i) order[player][i] = i;
+            std::shuffle(order[player], order[player] + BitBoard::CELL_COUNT, rng);
+        }
+        // Каждая двадцатая партия бросается на полпути
+        const int limit = rng() % 20 == 0 ? int(rng() % 60) : INT_MAX;
+        replay.outcome = GameReplay::Outcome::Abandoned;
+        bool player1Turn = true;
+        quint32 atMs = 0;
+        while (replay.moves.size() < limit) {
+            const int shooter = player1Turn ? 0 : 1;
+            ReplayMove move;
+            move.player1 = player1Turn;
+            atMs += 500 + rng() % 8000;
+            move.atMs = atMs;
+            if (rng() % 100 == 0) {
+                replay.moves.append(move);
+                player1Turn = !player1Turn;
+                continue;
+            }
+            const int cell = order[shooter][next[shooter]++];
+            move.cell = quint8(cell);
+            replay.moves.append(move);
+            BitBoard &target = boards[1 - shooter];
+            if (!target.shoot(cell % BitBoard::WIDTH, cell / BitBoard::WIDTH)) {
+                player1Turn = !player1Turn;
+            } else if (target.allShipsSunk()) {
+                replay.outcome = player1Turn ? GameReplay::Outcome::Player1Won : GameReplay::Outcome::Player2Won;
+                break;
+            }
+        }
+        writer.append(replay);
+    }
+    writer.close();
+    std::printf("games %d\n", games);
+    std::printf("bytes %llu\n", static_cast<unsigned long long>(writer.bytesWritten()));
+    std::printf("bytes_per_game %.1f\n", double(writer.bytesWritten()) / qMax(games, 1));
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Validates and summarizes game replays recorded by the sea battle server");
+    parser.addHelpOption();
+    QCommandLineOption listOption("list", "Print one line per game");
+    QCommandLineOption invalidOption("invalid", "Print one line per game that breaks the rules");
+    QCommandLineOption generateOption("generate", "Write this many random games to the file instead", "games");
+    QCommandLineOption seedOption("seed", "Random seed for --generate", "seed", "1");
+    for (const QCommandLineOption &option : {listOption, invalidOption, generateOption, seedOption}) {
+        parser.addOption(option);
+    }
+    parser.addPositionalArgument("files", "Replay files");
+    parser.process(app);
+
+    const QStringList files = parser.positionalArguments();
+    if (files.isEmpty()) {
+        parser.showHelp(1);
+    }
+    if (parser.isSet(generateOption)) {
+        return generate(files.first(), parser.value(generateOption).toInt(), parser.value(seedOption).toUInt());
+    }
+
+    const bool invalidOnly = parser.isSet(invalidOption);
+    const bool list = parser.isSet(listOption) || invalidOnly;
+    Totals totals;
+    QElapsedTimer timer;
+    timer.start();
+    bool ok = true;
+    for (const QString &path : files) {
+        ok = scanFile(path, list, invalidOnly, totals) && ok;
+    }
+    const double seconds = qMax(timer.nsecsElapsed() / 1e9, 1e-9);
+    const quint64 finished = totals.outcomes[0] + totals.outcomes[1];
+
+    if (list) std::printf("\n");
+    std::printf("files %llu\n", static_cast<unsigned long long>(totals.files));
+    std::printf("damaged_files %llu\n", static_cast<unsigned long long>(totals.damagedFiles));
+    std::printf("bytes %llu\n", static_cast<unsigned long long>(totals.bytes));
+    std::printf("games %llu\n", static_cast<unsigned long long>(totals.games));
+    std::printf("invalid %llu\n", static_cast<unsigned long long>(totals.invalid));
+    std::printf("player1_won %llu\n", static_cast<unsigned long long>(totals.outcomes[0]));
+    std::printf("player2_won %llu\n", static_cast<unsigned long long>(totals.outcomes[1]));
+    std::printf("abandoned %llu\n", static_cast<unsigned long long>(totals.outcomes[2]));
+    std::printf("bytes_per_game %.1f\n", totals.games ? double(totals.bytes) / totals.games : 0.0);
+    std::printf("moves_per_game %.1f\n", totals.games ? double(totals.moves) / totals.games : 0.0);
+    std::printf("hit_rate %.3f\n", totals.shots ? double(totals.hits) / totals.shots : 0.0);
+    std::printf("repeated_shots %llu\n", static_cast<unsigned long long>(totals.repeats));
+    std::printf("turn_timeouts %llu\n", static_cast<unsigned long long>(totals.passes));
+    std::printf("player1_win_rate %.3f\n", finished ? double(totals.outcomes[0]) / finished : 0.0);
+    std::printf("finished_moves_mean %.1f\n",
+                totals.finishedGames ? double(totals.finishedMoves) / totals.finishedGames : 0.0);
+    std::printf("finished_duration_mean_s %.1f\n",
+                totals.finishedGames ? totals.finishedMs / 1000.0 / totals.finishedGames : 0.0);
+    std::printf("games_per_s %.0f\n", totals.games / seconds);
+    for (auto it = totals.errors.cbegin(); it != totals.errors.cend(); ++it) {
+        std::printf("error %llu %s\n", static_cast<unsigned long long>(it.value()), qPrintable(it.key()));
+    }
+    return ok && totals.invalid == 0 && totals.damagedFiles == 0 ? 0 : 2;
+}
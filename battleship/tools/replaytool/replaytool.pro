@@ -0,0 +1,25 @@
+QT += core
+QT -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# Настройки для временных файлов
+MOC_DIR = build/moc
+OBJECTS_DIR = build/obj
+
+TEMPLATE = app
+
+INCLUDEPATH += ../../server ../../common
+include(../../common/gamecore.pri)
+
+SOURCES += \
+    main.cpp \
+    ../../server/gamereplay.cpp \
+    ../../server/logger.cpp
+
+HEADERS += \
+    ../../server/gamereplay.h \
+    ../../server/logger.h
+
+TARGET = replaytool
@@ -0,0 +1,282 @@
+// Турнир ботов без интерфейса: стратегии из shotstrategy.h играют друг с
+// другом по правилам сервера (попадание оставляет ход за стрелявшим) на
+// случайных расстановках BitBoard::randomFleet. Каждая пара стратегий из
+// списка играет --games партий, первый ход чередуется. Партии делятся на
+// пачки по CHUNK_GAMES, пачки разбирают потоки; генератор пачки зависит
+// только от зерна, пары и номера пачки, так что итог не зависит от числа
+// потоков.
+//
+// Вывод - строки "ключ значение": для каждой пары доля побед, среднее
+// число выстрелов до победы и его перцентили, доля попаданий; в конце -
+// сводка по стратегиям и скорость в партиях в секунду.
+//
+// Пример: tournament --games 1000000 hunt parity
+//         tournament --games 100000            (все стратегии, каждая с каждой)
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QVector>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include "shotstrategy.h"
+
+namespace {
+
+constexpr int CHUNK_GAMES = 1024;
+// Партия обрывается ничьей, если стратегия стреляет по кругу
+constexpr int MAX_SHOTS = 1000;
+constexpr int HISTOGRAM_SIZE = 2 * BitBoard::CELL_COUNT + 1;
+
+struct SideStats {
+    quint64 wins = 0;
+    quint64 winShots = 0;
+    quint64 shots = 0;
+    quint64 hits = 0;
+    quint64 repeats = 0;   // выстрелы по уже обстрелянным клеткам
+    quint64 histogram[HISTOGRAM_SIZE] = {};   // выстрелов до победы
+
+    void merge(const SideStats &other) {
+        wins += other.wins;
+        winShots += other.winShots;
+        shots += other.shots;
+        hits += other.hits;
+        repeats += other.repeats;
+        for (int i = 0; i < HISTOGRAM_SIZE; ++i) histogram[i] += other.histogram[i];
+    }
+
+    int percentile(double p) const {
+        const quint64 rank = quint64(p * wins);
+        quint64 seen = 0;
+        for (int i = 0; i < HISTOGRAM_SIZE; ++i) {
+            seen += histogram[i];
+            if (seen > rank) return i;
+        }
+        return HISTOGRAM_SIZE - 1;
+    }
+};
+
+struct MatchStats {
+    quint64 games = 0;
+    quint64 draws = 0;
+    quint64 firstMoverWins = 0;
+    SideStats sides[2];
+
+    void merge(const MatchStats &other) {
+        games += other.games;
+        draws += other.draws;
+        firstMoverWins += other.firstMoverWins;
+        sides[0].merge(other.sides[0]);
+        sides[1].merge(other.sides[1]);
+    }
+};
+
+struct Match {
+    std::string names[2];
+};
+
+// Одна партия, начинает first. Игрок p стреляет по полю boards[1 - p].
+void playGame(ShotStrategy *players[2], BitBoard boards[2], int first, MatchStats &stats) {
+    FleetIndex fleets[2];
+    fleets[0].build(boards[0].ships());
+    fleets[1].build(boards[1].ships());
+    ShotHistory history[2];
+    int shots[2] = {0, 0};
+    int shooter = first;
+    ++stats.games;
+    while (shots[0] + shots[1] < MAX_SHOTS) {
+        SideStats &side = stats.sides[shooter];
+        const int cell = players[shooter]->nextShot(history[shooter]);
+        ++shots[shooter];
+        ++side.shots;
+        if (cell < 0 || cell >= BitBoard::CELL_COUNT || history[shooter].shots.test(cell)) {
+            // Как на сервере: повторный выстрел - промах
+            ++side.repeats;
+            shooter = 1 - shooter;
+            continue;
+        }
+
+        BitBoard &target = boards[1 - shooter];
+        const int x = cell % BitBoard::WIDTH;
+        const int y = cell / BitBoard::WIDTH;
+        if (!target.shoot(x, y)) {
+            history[shooter].record(cell, false, CellMask());
+            shooter = 1 - shooter;
+            continue;
+        }
+        ++side.hits;
+        FleetIndex &fleet = fleets[1 - shooter];
+        const bool sunk = fleet.hit(cell);
+        history[shooter].record(cell, true, sunk ? fleet.shipCells(fleet.shipAt(cell)) : CellMask());
+        if (sunk && fleet.shipsLeft() == 0) {
+            ++side.wins;
+            side.winShots += quint64(shots[shooter]);
+            ++side.histogram[qMin(shots[shooter], HISTOGRAM_SIZE - 1)];
+            if (shooter == first) ++stats.firstMoverWins;
+            return;
+        }
+    }
+    ++stats.draws;
+}
+
+class Tournament
+{
+public:
+    Tournament(const QVector<Match> &matches, quint64 games, quint32 seed) :
+        m_matches(matches),
+        m_results(matches.size()),
+        m_chunksPerMatch((games + CHUNK_GAMES - 1) / CHUNK_GAMES),
+        m_games(games),
+        m_seed(seed),
+        m_nextChunk(0)
+    {
+    }
+
+    void run(int threads) {
+        std::vector<std::thread> workers;
+        for (int i = 0; i < threads; ++i) {
+            workers.emplace_back(&Tournament::work, this);
+        }
+        for (std::thread &worker : workers) worker.join();
+    }
+
+    const QVector<MatchStats> &results() const { return m_results; }
+
+private:
+    void work() {
+        QVector<MatchStats> local(m_matches.size());
+        const quint64 totalChunks = m_chunksPerMatch * quint64(m_matches.size());
+        for (;;) {
+            const quint64 chunk = m_nextChunk.fetch_add(1, std::memory_order_relaxed);
+            if (chunk >= totalChunks) break;
+            const int matchIndex = int(chunk / m_chunksPerMatch);
+            const quint64 chunkInMatch = chunk % m_chunksPerMatch;
+            playChunk(m_matches[matchIndex], chunkInMatch, matchIndex, local[matchIndex]);
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (int i = 0; i < local.size(); ++i) m_results[i].merge(local[i]);
+    }
+
+    void playChunk(const Match &match, quint64 chunk, int matchIndex, MatchStats &stats) {
+        std::seed_seq seeds{m_seed, quint32(matchIndex), quint32(chunk), quint32(chunk >> 32)};
+        std::mt19937 rng(seeds);
+        std::unique_ptr<ShotStrategy> strategies[2] = {
+            ShotStrategy::create(match.names[0]), ShotStrategy::create(match.names[1])};
+        strategies[0]->seed(rng());
+        strategies[1]->seed(rng());
+        ShotStrategy *players[2] = {strategies[0].get(), strategies[1].get()};
+
+        const quint64 begin = chunk * CHUNK_GAMES;
+        const quint64 end = qMin(begin + CHUNK_GAMES, m_games);
+        for (quint64 game = begin; game < end; ++game) {
+            BitBoard boards[2] = {BitBoard::randomFleet(rng), BitBoard::randomFleet(rng)};
+            players[0]->newGame();
+            players[1]->newGame();
+            playGame(players, boards, int(game & 1), stats);
+        }
+    }
+
+    const QVector<Match> m_matches;
+    QVector<MatchStats> m_results;
+    const quint64 m_chunksPerMatch;
+    const quint64 m_games;
+    const quint32 m_seed;
+    std::atomic<quint64> m_nextChunk;
+    std::mutex m_mutex;
+};
+
+void printSide(const char *prefix, const std::string &name, const SideStats &side, quint64 games) {
+    std::printf("%s %-10s win_rate %.4f shots_to_win %.2f p10 %d p50 %d p90 %d hit_rate %.3f repeats %llu\n",
+                prefix, name.c_str(), games ? double(side.wins) / games : 0.0,
+                side.wins ? double(side.winShots) / side.wins : 0.0,
+                side.percentile(0.1), side.percentile(0.5), side.percentile(0.9),
+                side.shots ? double(side.hits) / side.shots : 0.0,
+                static_cast<unsigned long long>(side.repeats));
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Plays bot strategies against each other without a GUI");
+    parser.addHelpOption();
+    QCommandLineOption gamesOption("games", "Games per pair of strategies", "games", "100000");
+    QCommandLineOption threadsOption("threads", "Worker threads, 0 - one per core", "threads", "0");
+    QCommandLineOption seedOption("seed", "Random seed", "seed", "1");
+    QCommandLineOption listOption("list", "List strategies and exit");
+    for (const QCommandLineOption &option : {gamesOption, threadsOption, seedOption, listOption}) {
+        parser.addOption(option);
+    }
+    parser.addPositionalArgument("strategies", "Strategies to play, each against each; all but slow ones by default");
+    parser.process(app);
+
+    if (parser.isSet(listOption)) {
+        for (const std::string &name : ShotStrategy::names()) {
+            std::printf("%-10s %s%s\n", name.c_str(), ShotStrategy::description(name),
+                        ShotStrategy::isSlow(name) ? " (slow, only when named)" : "");
+        }
+        return 0;
+    }
+
+    std::vector<std::string> names;
+    for (const QString &name : parser.positionalArguments()) {
+        if (!ShotStrategy::create(name.toStdString())) {
+            std::fprintf(stderr, "unknown strategy %s, see --list\n", qPrintable(name));
+            return 1;
+        }
+        names.push_back(name.toStdString());
+    }
+    if (names.empty()) names = ShotStrategy::names(false);
+
+    // Каждая с каждой; единственная стратегия играет сама с собой
+    QVector<Match> matches;
+    for (size_t i = 0; i < names.size(); ++i) {
+        for (size_t j = i + 1; j < names.size(); ++j) matches.append(Match{{names[i], names[j]}});
+    }
+    if (matches.isEmpty()) matches.append(Match{{names[0], names[0]}});
+
+    const quint64 games = parser.value(gamesOption).toULongLong();
+    int threads = parser.value(threadsOption).toInt();
+    if (threads <= 0) threads = qMax(QThread::idealThreadCount(), 1);
+
+    Tournament tournament(matches, games, parser.value(seedOption).toUInt());
+    QElapsedTimer timer;
+    timer.start();
+    tournament.run(threads);
+    const double seconds = qMax(timer.nsecsElapsed() / 1e9, 1e-9);
+
+    quint64 totalGames = 0;
+    std::vector<MatchStats> byStrategy(names.size());
+    for (int i = 0; i < matches.size(); ++i) {
+        const Match &match = matches[i];
+        const MatchStats &stats = tournament.results()[i];
+        totalGames += stats.games;
+        std::printf("match %s %s games %llu draws %llu first_mover_win_rate %.4f\n",
+                    match.names[0].c_str(), match.names[1].c_str(),
+                    static_cast<unsigned long long>(stats.games), static_cast<unsigned long long>(stats.draws),
+                    stats.games ? double(stats.firstMoverWins) / stats.games : 0.0);
+        for (int side = 0; side < 2; ++side) {
+            printSide("  side", match.names[side], stats.sides[side], stats.games);
+            for (size_t s = 0; s < names.size(); ++s) {
+                if (names[s] != match.names[side]) continue;
+                MatchStats &total = byStrategy[s];
+                total.games += stats.games;
+                total.sides[0].merge(stats.sides[side]);
+            }
+        }
+    }
+
+    std::printf("\n");
+    for (size_t s = 0; s < names.size(); ++s) {
+        printSide("strategy", names[s], byStrategy[s].sides[0], byStrategy[s].games);
+    }
+    std::printf("threads %d\n", threads);
+    std::printf("games %llu\n", static_cast<unsigned long long>(totalGames));
+    std::printf("seconds %.2f\n", seconds);
+    std::printf("games_per_s %.0f\n", totalGames / seconds);
+    return 0;
+}
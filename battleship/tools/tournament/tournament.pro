@@ -0,0 +1,25 @@
+QT += core
+QT -= gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+# Настройки для временных файлов
+MOC_DIR = build/moc
+OBJECTS_DIR = build/obj
+
+TEMPLATE = app
+
+INCLUDEPATH += ../../common
+include(../../common/gamecore.pri)
+
+SOURCES += \
+    main.cpp \
+    ../../common/shotstrategy.cpp \
+    ../../common/workstealingpool.cpp
+
+HEADERS += \
+    ../../common/shotstrategy.h \
+    ../../common/workstealingpool.h
+
+TARGET = tournament